@@ -0,0 +1,431 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <list>
+#include <cmath>
+#include <cstring>
+#include "pv_cache.h"
+
+using namespace std;
+
+namespace stringarma{
+
+/// Types of request stored in the cache, the first value of the request in the fingerprint.
+enum CacheRequestType {
+	CACHE_IV_CHARACTERISTIC = 1,
+	CACHE_MAXIMUM_POWER_POINT = 2
+};
+
+/**
+ * Returns the bits of a double value, to store exact values in the fingerprint.
+ * @param value Double value.
+ * @returns An integer with the same bits.
+ */
+static int64_t doubleBits(double value)
+{
+	int64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return(bits);
+}
+
+/**
+ * Returns the hash of a fingerprint.
+ * @param fingerprint Vector with the fingerprint.
+ * @returns The hash.
+ */
+static uint64_t hashFingerprint(const vector<int64_t> &fingerprint)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned int k = 0; k < fingerprint.size(); ++k)
+	{
+		// Every value is mixed with its whole width (FNV-1a over 64 bit words and a final shift)
+		hash ^= (uint64_t)fingerprint[k];
+		hash *= 1099511628211ULL;
+		hash ^= hash >> 29;
+	}
+	return(hash);
+}
+
+CharacteristicCache :: CharacteristicCache(void)
+{
+	irradiance_step = CACHE_IRRADIANCE_STEP_REF;
+	temperature_step = CACHE_TEMPERATURE_STEP_REF;
+	maximum_memory = CACHE_MAX_MEMORY_REF;
+	memory = 0;
+	hits = 0;
+	misses = 0;
+}
+
+void CharacteristicCache :: setQuantization(double _irradiance_step, double _temperature_step)
+{
+	try
+	{
+		if (_irradiance_step < 0 || _temperature_step < 0)
+		{
+			throw std::runtime_error("The steps of the cache can not be negative.");
+		}
+		irradiance_step = _irradiance_step;
+		temperature_step = _temperature_step;
+		clear();
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the quantization of the cache." << endl;
+	}
+}
+
+void CharacteristicCache :: setMaximumMemory(size_t _maximum_memory)
+{
+	maximum_memory = _maximum_memory;
+	removeLeastRecentlyUsed();
+}
+
+uint64_t CharacteristicCache :: findFingerprint(SolarSolver &solver, const vector<double> &request, vector<int64_t> &fingerprint)
+{
+	fingerprint.clear();
+	for (unsigned int k = 0; k < request.size(); ++k)
+	{
+		fingerprint.push_back(doubleBits(request[k]));
+	}
+	// Settings of the solver that change its results
+	fingerprint.push_back(doubleBits(solver.epsilon));
+	fingerprint.push_back(solver.max_iterations);
+	fingerprint.push_back(solver.linear_solver);
+	fingerprint.push_back(solver.solve_method);
+	fingerprint.push_back(solver.continuation);
+	// Technology of the cells, shared by every cell of the panel
+	if (solver.number_strings > 0 && solver.string_array[0].string_size > 0)
+	{
+		const CellTechnology *technology = solver.string_array[0].cells_array[0].getTechnology();
+		fingerprint.push_back(doubleBits(technology->voltage_breakdown));
+		fingerprint.push_back(doubleBits(technology->breakdown_alpha));
+		fingerprint.push_back(doubleBits(technology->soiling_factor));
+		fingerprint.push_back(doubleBits(technology->ideality_factor));
+		fingerprint.push_back(doubleBits(technology->resistance_series));
+		fingerprint.push_back(doubleBits(technology->resistance_shunt));
+		fingerprint.push_back(doubleBits(technology->temperature_coeff));
+		fingerprint.push_back(doubleBits(technology->voltage_temperature_coeff));
+		fingerprint.push_back(doubleBits(technology->breakdown_exponent));
+	}
+	fingerprint.push_back(solver.number_strings);
+	for (int k = 0; k < solver.number_strings; ++k)
+	{
+		solar_string &st = solver.string_array[k];
+		fingerprint.push_back(st.getWithDiode());
+		fingerprint.push_back(doubleBits(st.getVoltageDiode()));
+		fingerprint.push_back(doubleBits(st.diode_bypass.getIdealityFactor()));
+		fingerprint.push_back(doubleBits(st.diode_bypass.getTemperatureDiode()));
+		fingerprint.push_back(doubleBits(st.diode_bypass.getCurrentReverseSaturation()));
+		fingerprint.push_back(st.string_size);
+		for (int j = 0; j < st.string_size; ++j)
+		{
+			double G = st.cells_array[j].getIrradiance();
+			double Tc = st.cells_array[j].getTemperatureCell();
+			fingerprint.push_back(irradiance_step > 0 ? llround(G/irradiance_step) : doubleBits(G));
+			fingerprint.push_back(temperature_step > 0 ? llround(Tc/temperature_step) : doubleBits(Tc));
+		}
+	}
+	return(hashFingerprint(fingerprint));
+}
+
+CacheEntry* CharacteristicCache :: findEntry(uint64_t hash, const vector<int64_t> &fingerprint)
+{
+	unordered_map<uint64_t, list<CacheEntry>::iterator>::iterator it = positions.find(hash);
+	// Different fingerprints with the same hash are a miss
+	if (it == positions.end() || it->second->fingerprint != fingerprint)
+	{
+		misses += 1;
+		return(NULL);
+	}
+	hits += 1;
+	entries.splice(entries.begin(), entries, it->second);
+	return(&entries.front());
+}
+
+void CharacteristicCache :: insertEntry(CacheEntry &entry)
+{
+	unordered_map<uint64_t, list<CacheEntry>::iterator>::iterator it = positions.find(entry.hash);
+	if (it != positions.end())
+	{
+		// Only one result is kept for every hash
+		memory -= calcEntryMemory(*it->second);
+		entries.erase(it->second);
+		positions.erase(it);
+	}
+	memory += calcEntryMemory(entry);
+	entries.push_front(entry);
+	positions[entry.hash] = entries.begin();
+	removeLeastRecentlyUsed();
+}
+
+size_t CharacteristicCache :: calcEntryMemory(const CacheEntry &entry)
+{
+	// The entry, the nodes of the list and the map, and the memory of its vectors
+	return(sizeof(CacheEntry) + 4*sizeof(void*) + sizeof(uint64_t)
+			+ entry.fingerprint.size()*sizeof(int64_t) + entry.curve.n_elem*sizeof(double)
+			+ (entry.mpp.string_voltages.size() + entry.mpp.string_currents.size() + entry.mpp.diode_currents.size())*sizeof(double));
+}
+
+void CharacteristicCache :: removeLeastRecentlyUsed(void)
+{
+	while (memory > maximum_memory && !entries.empty())
+	{
+		memory -= calcEntryMemory(entries.back());
+		positions.erase(entries.back().hash);
+		entries.pop_back();
+	}
+}
+
+arma::mat CharacteristicCache :: calcIVcharacteristic(SolarSolver &solver, double start_v, double end_v, int numb_points)
+{
+	vector<double> request = {CACHE_IV_CHARACTERISTIC, start_v, end_v, (double)numb_points};
+	CacheEntry entry;
+	entry.hash = findFingerprint(solver, request, entry.fingerprint);
+	CacheEntry *found = findEntry(entry.hash, entry.fingerprint);
+	if (found != NULL)
+	{
+		return(found->curve);
+	}
+	entry.curve = solver.calcIVcharacteristic(start_v, end_v, numb_points);
+	insertEntry(entry);
+	return(entry.curve);
+}
+
+MaximumPowerPoint CharacteristicCache :: findMaximumPowerPoint(SolarSolver &solver)
+{
+	vector<double> request = {CACHE_MAXIMUM_POWER_POINT};
+	CacheEntry entry;
+	entry.hash = findFingerprint(solver, request, entry.fingerprint);
+	CacheEntry *found = findEntry(entry.hash, entry.fingerprint);
+	if (found != NULL)
+	{
+		return(found->mpp);
+	}
+	entry.mpp = solver.findMaximumPowerPoint();
+	// A maximum that was not found is searched again in the next request
+	if (entry.mpp.solved)
+	{
+		insertEntry(entry);
+	}
+	return(entry.mpp);
+}
+
+void CharacteristicCache :: clear(void)
+{
+	entries.clear();
+	positions.clear();
+	memory = 0;
+	hits = 0;
+	misses = 0;
+}
+
+/**
+ * Writes a vector of doubles to a binary file, preceded by its length.
+ * @param file Output file.
+ * @param values Vector to write.
+ */
+static void writeVector(ofstream &file, const vector<double> &values)
+{
+	uint32_t length = values.size();
+	file.write((const char*)&length, sizeof(length));
+	file.write((const char*)values.data(), length*sizeof(double));
+}
+
+/**
+ * Checks that a number of values still fits in the rest of a file, before the memory for them is reserved.
+ * @param file Input file.
+ * @param file_size Size of the file [bytes].
+ * @param count Number of values.
+ * @param size Size of every value [bytes].
+ * @returns True if the file is readable and the values fit in it.
+ */
+static bool fitsInFile(ifstream &file, streamoff file_size, uint64_t count, size_t size)
+{
+	if (!file) return(false);
+	streamoff position = file.tellg();
+	return(position >= 0 && position <= file_size && count <= (uint64_t)(file_size - position)/size);
+}
+
+/**
+ * Reads a vector of doubles written by writeVector.
+ * @param file Input file.
+ * @param file_size Size of the file [bytes].
+ * @param values Vector where the values are stored.
+ * @returns False if the length of the vector does not fit in the file.
+ */
+static bool readVector(ifstream &file, streamoff file_size, vector<double> &values)
+{
+	uint32_t length = 0;
+	file.read((char*)&length, sizeof(length));
+	if (!fitsInFile(file, file_size, length, sizeof(double))) return(false);
+	values.resize(length);
+	file.read((char*)values.data(), values.size()*sizeof(double));
+	return(true);
+}
+
+void CharacteristicCache :: save(string output_path)
+{
+	try
+	{
+		ofstream file(output_path, ios::out | ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Unable to open the output file " + output_path + ".");
+		}
+		uint64_t numb_entries = entries.size();
+		file.write("STRCH002", 8);
+		file.write((const char*)&irradiance_step, sizeof(double));
+		file.write((const char*)&temperature_step, sizeof(double));
+		file.write((const char*)&numb_entries, sizeof(numb_entries));
+		for (list<CacheEntry>::reverse_iterator it = entries.rbegin(); it != entries.rend(); ++it)
+		{
+			uint32_t length = it->fingerprint.size();
+			file.write((const char*)&length, sizeof(length));
+			file.write((const char*)it->fingerprint.data(), length*sizeof(int64_t));
+			uint32_t rows = it->curve.n_rows, cols = it->curve.n_cols;
+			file.write((const char*)&rows, sizeof(rows));
+			file.write((const char*)&cols, sizeof(cols));
+			file.write((const char*)it->curve.memptr(), it->curve.n_elem*sizeof(double));
+			double point[3] = {it->mpp.voltage, it->mpp.current, it->mpp.power};
+			int32_t counters[2] = {it->mpp.number_solves, it->mpp.number_cells_reverse};
+			file.write((const char*)point, sizeof(point));
+			file.write((const char*)counters, sizeof(counters));
+			writeVector(file, it->mpp.string_voltages);
+			writeVector(file, it->mpp.string_currents);
+			writeVector(file, it->mpp.diode_currents);
+		}
+		if (!file)
+		{
+			throw std::runtime_error("Unable to write the output file " + output_path + ".");
+		}
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when saving the cache: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when saving the cache." << endl;
+	}
+}
+
+void CharacteristicCache :: load(string input_path)
+{
+	try
+	{
+		ifstream file(input_path, ios::in | ios::binary);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Unable to open the input file " + input_path + ".");
+		}
+		// Every length read is checked against the size of the file
+		file.seekg(0, ios::end);
+		streamoff file_size = file.tellg();
+		file.seekg(0, ios::beg);
+		char magic[8];
+		double steps[2];
+		uint64_t numb_entries = 0;
+		file.read(magic, 8);
+		file.read((char*)steps, sizeof(steps));
+		file.read((char*)&numb_entries, sizeof(numb_entries));
+		if (!file || memcmp(magic, "STRCH002", 8) != 0)
+		{
+			throw std::runtime_error("The file " + input_path + " is not a cache file.");
+		}
+		if (steps[0] != irradiance_step || steps[1] != temperature_step)
+		{
+			throw std::runtime_error("The file " + input_path + " was written with other quantization steps.");
+		}
+		for (uint64_t k = 0; k < numb_entries; ++k)
+		{
+			CacheEntry entry;
+			uint32_t length = 0, rows = 0, cols = 0;
+			file.read((char*)&length, sizeof(length));
+			if (!fitsInFile(file, file_size, length, sizeof(int64_t)))
+			{
+				throw std::runtime_error("The file " + input_path + " is truncated.");
+			}
+			entry.fingerprint.resize(length);
+			file.read((char*)entry.fingerprint.data(), entry.fingerprint.size()*sizeof(int64_t));
+			file.read((char*)&rows, sizeof(rows));
+			file.read((char*)&cols, sizeof(cols));
+			if (!fitsInFile(file, file_size, (uint64_t)rows*cols, sizeof(double)))
+			{
+				throw std::runtime_error("The file " + input_path + " is truncated.");
+			}
+			entry.curve.set_size(rows, cols);
+			file.read((char*)entry.curve.memptr(), entry.curve.n_elem*sizeof(double));
+			double point[3];
+			int32_t counters[2];
+			file.read((char*)point, sizeof(point));
+			file.read((char*)counters, sizeof(counters));
+			entry.mpp.voltage = point[0];
+			entry.mpp.current = point[1];
+			entry.mpp.power = point[2];
+			entry.mpp.number_solves = counters[0];
+			entry.mpp.number_cells_reverse = counters[1];
+			entry.mpp.solved = true;
+			if (!readVector(file, file_size, entry.mpp.string_voltages)
+					|| !readVector(file, file_size, entry.mpp.string_currents)
+					|| !readVector(file, file_size, entry.mpp.diode_currents) || !file)
+			{
+				throw std::runtime_error("The file " + input_path + " is truncated.");
+			}
+			entry.hash = hashFingerprint(entry.fingerprint);
+			insertEntry(entry);
+		}
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when loading the cache: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when loading the cache." << endl;
+	}
+}
+
+long CharacteristicCache :: getHits(void)
+{
+	return(hits);
+}
+
+long CharacteristicCache :: getMisses(void)
+{
+	return(misses);
+}
+
+int CharacteristicCache :: getNumberEntries(void)
+{
+	return(entries.size());
+}
+
+size_t CharacteristicCache :: getMemory(void)
+{
+	return(memory);
+}
+
+}
@@ -0,0 +1,196 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <cstdint>
+#include <armadillo>
+#include "pv_solver.h"
+
+namespace stringarma{
+
+#define CACHE_IRRADIANCE_STEP_REF 1.0
+#define CACHE_TEMPERATURE_STEP_REF 0.1
+#define CACHE_MAX_MEMORY_REF 67108864
+
+/**
+ * Results of a SolarSolver stored in the CharacteristicCache.
+ */
+struct CacheEntry {
+	/// Quantized conditions of the panel and parameters of the request (see CharacteristicCache::findFingerprint).
+	std::vector<int64_t> fingerprint;
+	/// Hash of the fingerprint.
+	uint64_t hash;
+	/// I-V characteristic, with the voltage and the current of every point (empty for a maximum power point).
+	arma::mat curve;
+	/// Maximum power point (only for a maximum power point).
+	MaximumPowerPoint mpp;
+};
+
+/**
+ * Cache of the results of SolarSolver objects, for panels that often repeat the same conditions.
+ *
+ * The results are stored with a fingerprint of the panel: the bypass diode and the number of cells of every string, and
+ * the irradiance and temperature of every cell rounded to a step (see setQuantization), together with the request.
+ * The fingerprint also contains the technology of the cells, the parameters of the bypass diodes (including the knee
+ * voltage) and the settings of the solver that change its results (epsilon, maximum number of iterations, linear solver,
+ * solve method and continuation), so a cache can be shared by different panels and solvers.
+ * A request with the same fingerprint returns the stored result without solving the panel, in a time proportional to
+ * the number of cells. Cells that differ less than the steps share the result, so the steps trade accuracy for hits.
+ *
+ * The least recently used results are removed when the memory exceeds a limit (see setMaximumMemory). The results can
+ * be stored in a file and read again (see save and load).
+ */
+class CharacteristicCache
+{
+protected:
+	/// Step of the irradiance of the fingerprint (0 for the exact value).
+	double irradiance_step;
+	/// Step of the temperature of the fingerprint (0 for the exact value).
+	double temperature_step;
+	/// Maximum memory used by the results [bytes].
+	size_t maximum_memory;
+	/// Memory used by the results [bytes].
+	size_t memory;
+	/// Results, from the most to the least recently used.
+	std::list<CacheEntry> entries;
+	/// Position of every result in the list, by the hash of its fingerprint.
+	std::unordered_map<uint64_t, std::list<CacheEntry>::iterator> positions;
+	/// Number of requests found in the cache.
+	long hits;
+	/// Number of requests not found in the cache.
+	long misses;
+
+public:
+	/**
+	 * Constructor of the class CharacteristicCache.
+	 * By default the irradiance is rounded to CACHE_IRRADIANCE_STEP_REF and the temperature to CACHE_TEMPERATURE_STEP_REF,
+	 * and the memory is limited to CACHE_MAX_MEMORY_REF bytes.
+	 */
+	CharacteristicCache(void);
+	/**
+	 * Sets the steps used to round the conditions of the cells. The stored results are deleted.
+	 * @param irradiance_step Step of the irradiance. With 0 the exact value is used.
+	 * @param temperature_step Step of the temperature. With 0 the exact value is used.
+	 */
+	void setQuantization(double, double);
+	/**
+	 * Sets the maximum memory used by the results. The least recently used results are removed to fit in it.
+	 * @param maximum_memory Maximum memory [bytes].
+	 */
+	void setMaximumMemory(size_t);
+	/**
+	 * Returns the I-V characteristic of the panel of the solver in a given range, solving it only if it is not stored.
+	 * On a hit the solver is not used, so the working point of its cells is not updated.
+	 * @param solver SolarSolver object with the panel, in its current conditions.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @returns A matrix with a row for every point of the characteristic (see SolarSolver::calcIVcharacteristic).
+	 */
+	arma::mat calcIVcharacteristic(SolarSolver &, double, double, int);
+	/**
+	 * Returns the maximum power point of the panel of the solver, solving it only if it is not stored.
+	 * On a hit the solver is not used, so the working point of its cells is not updated: unlike after
+	 * SolarSolver::findMaximumPowerPoint, the panel is not left at the maximum power point (calcState with its voltage
+	 * does it). The number_solves of the result is the one of the search that stored it, not zero.
+	 * A result that is not solved (see MaximumPowerPoint) is returned but not stored.
+	 * @param solver SolarSolver object with the panel, in its current conditions.
+	 * @returns A MaximumPowerPoint struct (see SolarSolver::findMaximumPowerPoint).
+	 */
+	MaximumPowerPoint findMaximumPowerPoint(SolarSolver &);
+	/**
+	 * Deletes the stored results and the counters.
+	 */
+	void clear(void);
+	/**
+	 * Writes the stored results to a binary file, from the least to the most recently used.
+	 * @param output_path Full path of the file. If the file exists it will be replaced.
+	 */
+	void save(std::string);
+	/**
+	 * Reads the results of a file written by save and adds them to the cache.
+	 * The file must have been written with the same quantization steps. Every length read is checked against the size
+	 * of the file before any memory is reserved, so a damaged file is reported as truncated.
+	 * @param input_path Full path of the file.
+	 */
+	void load(std::string);
+	/**
+	 * Returns the number of requests found in the cache.
+	 * @returns The number of hits.
+	 */
+	long getHits(void);
+	/**
+	 * Returns the number of requests not found in the cache.
+	 * @returns The number of misses.
+	 */
+	long getMisses(void);
+	/**
+	 * Returns the number of stored results.
+	 * @returns The number of results.
+	 */
+	int getNumberEntries(void);
+	/**
+	 * Returns the memory used by the stored results.
+	 * @returns The memory [bytes].
+	 */
+	size_t getMemory(void);
+
+protected:
+	/**
+	 * Finds the fingerprint of the conditions of the panel of a solver and a request.
+	 * @param solver SolarSolver object with the panel.
+	 * @param request Parameters of the request (its type and its arguments).
+	 * @param fingerprint Vector where the fingerprint is stored.
+	 * @returns The hash of the fingerprint.
+	 */
+	uint64_t findFingerprint(SolarSolver &solver, const std::vector<double> &request, std::vector<int64_t> &fingerprint);
+	/**
+	 * Finds a result and moves it to the front of the list.
+	 * @param hash Hash of the fingerprint.
+	 * @param fingerprint Fingerprint of the request.
+	 * @returns A pointer to the result, or NULL if it is not stored.
+	 */
+	CacheEntry* findEntry(uint64_t hash, const std::vector<int64_t> &fingerprint);
+	/**
+	 * Stores a result at the front of the list and removes the least recently used results if the memory is exceeded.
+	 * @param entry Result to store.
+	 */
+	void insertEntry(CacheEntry &entry);
+	/**
+	 * Estimates the memory used by a result.
+	 * @param entry Result.
+	 * @returns The memory [bytes].
+	 */
+	size_t calcEntryMemory(const CacheEntry &entry);
+	/**
+	 * Removes the least recently used results until the memory is not exceeded.
+	 */
+	void removeLeastRecentlyUsed(void);
+};
+
+}
@@ -25,21 +25,180 @@
 #include <cmath>
 #include <fstream>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
 using namespace std;
 
+// Versions of the vectorized cell kernel, selected at run time by the processor (GCC function multi-versioning).
+// The kernel and its inlined functions share the optimization options, floating point exceptions are not used.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define CELL_KERNEL_OPTIONS __attribute__((optimize("tree-vectorize", "no-trapping-math")))
+#define CELL_KERNEL_VERSIONS __attribute__((target_clones("avx512f","avx2","default"))) CELL_KERNEL_OPTIONS
+#else
+#define CELL_KERNEL_OPTIONS
+#define CELL_KERNEL_VERSIONS
+#endif
+
 namespace stringarma{
 
-SolarCell::SolarCell(void)
+/*
+ * Exponential without branches, so it can be vectorized.
+ * exp(x) = 2^k*exp(r), with r = x - k*ln(2) in [-ln(2)/2, ln(2)/2] and exp(r) by its Taylor series.
+ * The argument is limited to [-746, 710]: beyond these values the result is already 0 or infinite, and 2^k
+ * is applied in two factors so the overflow, the underflow and the subnormal results are reached by the product.
+ */
+CELL_KERNEL_OPTIONS
+static inline double kernelExp(double x)
+{
+	const double SHIFT = 6755399441055744.0; // 1.5*2^52, rounds to the nearest integer
+	double xc = x < -746.0 ? -746.0 : x;
+	xc = xc > 710.0 ? 710.0 : xc;
+	double kd = xc*1.4426950408889634 + SHIFT;
+	double k = kd - SHIFT;
+	double r = (xc - k*6.93147180369123816490e-01) - k*1.90821492927058770002e-10;
+
+	double p = 1.0/479001600;
+	p = p*r + 1.0/39916800;
+	p = p*r + 1.0/3628800;
+	p = p*r + 1.0/362880;
+	p = p*r + 1.0/40320;
+	p = p*r + 1.0/5040;
+	p = p*r + 1.0/720;
+	p = p*r + 1.0/120;
+	p = p*r + 1.0/24;
+	p = p*r + 1.0/6;
+	p = p*r + 0.5;
+	p = p*r + 1.0;
+	p = p*r + 1.0;
+
+	// The integer k is in the lowest bits of kd
+	uint64_t kb;
+	memcpy(&kb, &kd, sizeof(kb));
+	int64_t k1 = (int64_t)(kb - 0x4338000000000000ULL) >> 1;
+	int64_t k2 = (int64_t)(kb - 0x4338000000000000ULL) - k1;
+	uint64_t sb1 = (uint64_t)(k1 + 1023) << 52;
+	uint64_t sb2 = (uint64_t)(k2 + 1023) << 52;
+	double scale1, scale2;
+	memcpy(&scale1, &sb1, sizeof(scale1));
+	memcpy(&scale2, &sb2, sizeof(scale2));
+
+	// A NaN argument is propagated by the polynomial
+	return((p*scale1)*scale2);
+}
+
+/*
+ * Natural logarithm without branches, so it can be vectorized.
+ * log(y) = e*ln(2) + log(m), with m in [sqrt(2)/2, sqrt(2)] and log(m) = 2*atanh(s), s = (m-1)/(m+1).
+ * Negative and NaN arguments give NaN. Zero and subnormal arguments give a large negative value instead of
+ * -inf, which makes pow(y,-m) overflow the same way.
+ */
+CELL_KERNEL_OPTIONS
+static inline double kernelLog(double y)
+{
+	uint64_t yb;
+	memcpy(&yb, &y, sizeof(yb));
+	// Exponent and mantissa in [sqrt(2)/2, sqrt(2)]: mantissas above sqrt(2) are halved in their exponent bits
+	int64_t frac = (int64_t)(yb & 0x000fffffffffffffULL);
+	int64_t big = frac > 0x6a09e667f3bcdLL;
+	int64_t e = (int64_t)((yb >> 52) & 0x7ff) - 1023 + big;
+	uint64_t mb = ((uint64_t)frac | 0x3ff0000000000000ULL) - ((uint64_t)big << 52);
+	double m;
+	memcpy(&m, &mb, sizeof(m));
+	// Conversion of the exponent to double, adding it to the bits of 1.5*2^52
+	uint64_t eb = 0x4338000000000000ULL + (uint64_t)e;
+	double ed;
+	memcpy(&ed, &eb, sizeof(ed));
+	ed -= 6755399441055744.0;
+
+	double s = (m - 1.0)/(m + 1.0);
+	double s2 = s*s;
+	double p = 1.0/21;
+	p = p*s2 + 1.0/19;
+	p = p*s2 + 1.0/17;
+	p = p*s2 + 1.0/15;
+	p = p*s2 + 1.0/13;
+	p = p*s2 + 1.0/11;
+	p = p*s2 + 1.0/9;
+	p = p*s2 + 1.0/7;
+	p = p*s2 + 1.0/5;
+	p = p*s2 + 1.0/3;
+	p = p*s2 + 1.0;
+
+	// y - y is NaN for NaN (and infinite) arguments, zero otherwise
+	double l = ed*6.93147180369123816490e-01 + (ed*1.90821492927058770002e-10 + 2.0*s*p) + (y - y);
+
+	// Negative arguments: the bits of NaN are set with the sign bit as a mask
+	uint64_t lb;
+	memcpy(&lb, &l, sizeof(lb));
+	lb |= (uint64_t)((int64_t)yb >> 63) & 0x7ff8000000000000ULL;
+	memcpy(&l, &lb, sizeof(l));
+	return(l);
+}
+
+/*
+ * Vectorized loop of CellArrays::calcFunctionCAndDerivatives.
+ */
+CELL_KERNEL_VERSIONS
+static void calcCellFunctions(int count, const double *V, const double *I, const double *Iph, const double *I0,
+		const double *nVt, double Rs, double Rsh, double Vbr, double alpha, double expo,
+		double *__restrict f, double *__restrict dfdV, double *__restrict dfdI)
+{
+	for (int k = 0; k < count; ++k){
+		double Vd = V[k] + I[k]*Rs;
+		double ex = kernelExp(Vd/nVt[k]);
+		double y = 1-Vd/Vbr;
+		// pow(y,-m) = exp(-m*log(y))
+		double py = kernelExp(-expo*kernelLog(y));
+		double multi = 1+alpha*py;
+
+		f[k] = I[k] - Iph[k] + I0[k]*(ex-1) + Vd*multi/Rsh;
+		dfdV[k] = I0[k]*ex/nVt[k] + multi/Rsh + expo*alpha*Vd*(py/y)/(Vbr*Rsh);
+		dfdI[k] = 1 + Rs*dfdV[k];
+	}
+}
+
+void CellArrays::resize(int count)
+{
+	voltage.resize(count);
+	current.resize(count);
+	current_photogenerated.resize(count);
+	current_reverse_saturation.resize(count);
+	thermal_voltage.resize(count);
+	technology = NULL;
+}
+
+void CellArrays::setCell(int k, SolarCell &cell)
+{
+	if (technology == NULL){
+		technology = cell.getTechnology();
+	}else if (technology != cell.getTechnology()){
+		throw std::runtime_error("The cells of a set must share the same technology.");
+	}
+	voltage[k] = cell.getVoltageCell();
+	current[k] = cell.getCurrentCell();
+	current_photogenerated[k] = cell.getCurrentPhotogenerated();
+	current_reverse_saturation[k] = cell.getCurrentReverseSaturation();
+	thermal_voltage[k] = cell.getIdealityFactor()*(BOLTZMANN_CONST*cell.getTemperatureCell()/ELECTRONS_CHARGE);
+}
+
+void CellArrays::calcFunctionCAndDerivatives(double *f, double *dfdV, double *dfdI) const
+{
+	if (voltage.empty()){
+		return;
+	}
+	calcCellFunctions(voltage.size(), voltage.data(), current.data(), current_photogenerated.data(),
+			current_reverse_saturation.data(), thermal_voltage.data(), technology->resistance_series,
+			technology->resistance_shunt, technology->voltage_breakdown, technology->breakdown_alpha,
+			technology->breakdown_exponent, f, dfdV, dfdI);
+}
+
+CellTechnology::CellTechnology(void)
 {
-	current_photogenerated = CURRENT_PHOTOGENERATED_REF;
-	current_shortcut = CURRENT_SHORTCUT_REF;
-	voltage_open_circuit = VOLTAGE_OPEN_CIRCUIT_REF;
-	temperature_cell = 273+TEMPERATURE_CELL_REF;
-	irradiance = IRRADIANCE_REF;
-	current_cell = CURRENT_SHORTCUT_REF;
-	voltage_cell = VOLTAGE_OPEN_CIRCUIT_REF;
 	voltage_breakdown = VOLTAGE_BREAKDOWN_REF;
-	current_reverse_saturation = CURRENT_REVERSE_SATURATION_REF;
 	breakdown_alpha = BREAKDOWN_ALPHA_REF;
 	soiling_factor = SOILING_FACTOR_REF;
 	ideality_factor = IDEALITY_FACTOR_REF;
@@ -50,6 +209,58 @@ SolarCell::SolarCell(void)
 	breakdown_exponent = BREAKDOWN_EXPONENT_REF;
 }
 
+bool CellTechnology::operator==(const CellTechnology &other) const
+{
+	return(voltage_breakdown == other.voltage_breakdown && breakdown_alpha == other.breakdown_alpha
+			&& soiling_factor == other.soiling_factor && ideality_factor == other.ideality_factor
+			&& resistance_series == other.resistance_series && resistance_shunt == other.resistance_shunt
+			&& temperature_coeff == other.temperature_coeff && voltage_temperature_coeff == other.voltage_temperature_coeff
+			&& breakdown_exponent == other.breakdown_exponent);
+}
+
+size_t CellTechnology::Hash::operator()(const CellTechnology &technology) const
+{
+	const double parameters[] = {technology.voltage_breakdown, technology.breakdown_alpha, technology.soiling_factor,
+			technology.ideality_factor, technology.resistance_series, technology.resistance_shunt,
+			technology.temperature_coeff, technology.voltage_temperature_coeff, technology.breakdown_exponent};
+	hash<double> hash_double;
+	size_t seed = 0;
+	for (double parameter : parameters){
+		seed ^= hash_double(parameter) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+	return(seed);
+}
+
+const CellTechnology *CellTechnology::intern(const CellTechnology &technology)
+{
+	// The descriptors are never released, and the elements of an unordered_set do not move when it is rehashed
+	static mutex pool_mutex;
+	static unordered_set<CellTechnology, CellTechnology::Hash> pool;
+
+	lock_guard<mutex> lock(pool_mutex);
+	return(&*pool.insert(technology).first);
+}
+
+const CellTechnology *CellTechnology::reference(void)
+{
+	static const CellTechnology *technology = intern(CellTechnology());
+	return(technology);
+}
+
+SolarCell::SolarCell(void)
+{
+	current_photogenerated = CURRENT_PHOTOGENERATED_REF;
+	current_shortcut = CURRENT_SHORTCUT_REF;
+	voltage_open_circuit = VOLTAGE_OPEN_CIRCUIT_REF;
+	temperature_cell = 273+TEMPERATURE_CELL_REF;
+	irradiance = IRRADIANCE_REF;
+	current_cell = CURRENT_SHORTCUT_REF;
+	voltage_cell = VOLTAGE_OPEN_CIRCUIT_REF;
+	current_reverse_saturation = CURRENT_REVERSE_SATURATION_REF;
+	technology = CellTechnology::reference();
+	index = 0;
+}
+
 SolarCell::SolarCell(const SolarCell &cell)
 {
 	current_photogenerated = cell.current_photogenerated;
@@ -59,16 +270,9 @@ SolarCell::SolarCell(const SolarCell &cell)
 	irradiance = cell.irradiance;
 	current_cell = cell.current_cell;
 	voltage_cell = cell.voltage_cell;
-	voltage_breakdown = cell.voltage_breakdown;
 	current_reverse_saturation = cell.current_reverse_saturation;
-	breakdown_alpha = cell.breakdown_alpha;
-	soiling_factor = cell.soiling_factor;
-	ideality_factor = cell.ideality_factor;
-	resistance_series = cell.resistance_series;
-	resistance_shunt = cell.resistance_shunt;
-	temperature_coeff = cell.temperature_coeff;
-	voltage_temperature_coeff = cell.voltage_temperature_coeff;
-	breakdown_exponent = cell.breakdown_exponent;
+	technology = cell.technology;
+	index = cell.index;
 }
 int SolarCell::getIndex(void)
 {
@@ -108,39 +312,43 @@ double SolarCell::getVoltageCell(void)
 }
 double SolarCell::getVoltageBreakdown(void)
 {
-	return (voltage_breakdown);
+	return (technology->voltage_breakdown);
 }
 double SolarCell::getBreakdownAlpha(void)
 {
-	return(breakdown_alpha);
+	return(technology->breakdown_alpha);
 }
 double SolarCell::getSoilingFactor(void)
 {
-	return(soiling_factor);
+	return(technology->soiling_factor);
 }
 double SolarCell::getIdealityFactor(void)
 {
-	return(ideality_factor);
+	return(technology->ideality_factor);
 }
 double SolarCell::getResistanceSeries(void)
 {
-	return(resistance_series);
+	return(technology->resistance_series);
 }
 double SolarCell::getResistanceShunt(void)
 {
-	return(resistance_shunt);
+	return(technology->resistance_shunt);
 }
 double SolarCell::getTemperatureCoeff(void)
 {
-	return(temperature_coeff);
+	return(technology->temperature_coeff);
 }
 double SolarCell::getVoltageTemperatureCoeff(void)
 {
-	return(voltage_temperature_coeff);
+	return(technology->voltage_temperature_coeff);
 }
 double SolarCell::getBreakdownExponent(void)
 {
-	return(breakdown_exponent);
+	return(technology->breakdown_exponent);
+}
+const CellTechnology *SolarCell::getTechnology(void)
+{
+	return(technology);
 }
 void SolarCell::setIrradiance(double _G)
 {
@@ -156,7 +364,7 @@ void SolarCell::setCurrentReverseSaturation(void)
 	double x, y;
 	double Tcrefo = TEMPERATURE_CELL_REF+273;
 	Eg = 1,16 - 7.02e-4*pow(temperature_cell,2)/(temperature_cell+1108);
-	x = ((ELECTRONS_CHARGE*Eg)/(ideality_factor*BOLTZMANN_CONST))*(1/Tcrefo-1/temperature_cell);
+	x = ((ELECTRONS_CHARGE*Eg)/(technology->ideality_factor*BOLTZMANN_CONST))*(1/Tcrefo-1/temperature_cell);
 	y = temperature_cell/Tcrefo;
 	current_reverse_saturation = CURRENT_REVERSE_SATURATION_REF*pow(y,3)*exp(x);
 }
@@ -166,19 +374,19 @@ void SolarCell::setIndex(int _index)
 }
 void SolarCell::setCurrentShortcut(void)
 {
-	current_shortcut = CURRENT_SHORTCUT_REF*(1 + temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273))*soiling_factor*irradiance/IRRADIANCE_REF;
+	current_shortcut = CURRENT_SHORTCUT_REF*(1 + technology->temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273))*technology->soiling_factor*irradiance/IRRADIANCE_REF;
 	current_shortcut = floor(current_shortcut*100 + 0.5)/100;
 }
 void SolarCell::setCurrentPhotogenerated(void)
 {
-	current_photogenerated = CURRENT_PHOTOGENERATED_REF*(1 + temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273))*soiling_factor*irradiance/IRRADIANCE_REF;
+	current_photogenerated = CURRENT_PHOTOGENERATED_REF*(1 + technology->temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273))*technology->soiling_factor*irradiance/IRRADIANCE_REF;
 	current_photogenerated = floor(current_shortcut*100 + 0.5)/100;
 }
 void SolarCell::setVoltageOpenCircuit(void)
 {
 	double lratio = log(irradiance/IRRADIANCE_REF);
 	double Vt = BOLTZMANN_CONST*temperature_cell/ELECTRONS_CHARGE;
-	voltage_open_circuit = VOLTAGE_OPEN_CIRCUIT_REF + voltage_temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273) + ideality_factor*Vt*lratio; // d'acord amb Sandia 2004
+	voltage_open_circuit = VOLTAGE_OPEN_CIRCUIT_REF + technology->voltage_temperature_coeff*(temperature_cell - TEMPERATURE_CELL_REF-273) + technology->ideality_factor*Vt*lratio; // d'acord amb Sandia 2004
 	voltage_open_circuit = floor(voltage_open_circuit*100 + 0.5)/100;
 }
 void SolarCell::setCurrentCell(double _Icell)
@@ -191,49 +399,89 @@ void SolarCell::setVoltageCell(double _Vcell)
 }
 void SolarCell::setVoltageBreakdown(double _Vbreak)
 {
-	voltage_breakdown =_Vbreak;
+	if (technology->voltage_breakdown != _Vbreak){
+		CellTechnology changed = *technology;
+		changed.voltage_breakdown = _Vbreak;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setBreakdownAlpha(double _alpha)
 {
-	breakdown_alpha = _alpha;
+	if (technology->breakdown_alpha != _alpha){
+		CellTechnology changed = *technology;
+		changed.breakdown_alpha = _alpha;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setSoilingFactor(double _SF)
 {
-	soiling_factor = _SF;
+	if (technology->soiling_factor != _SF){
+		CellTechnology changed = *technology;
+		changed.soiling_factor = _SF;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setIdealityFactor(double _n)
 {
-	ideality_factor = _n;
+	if (technology->ideality_factor != _n){
+		CellTechnology changed = *technology;
+		changed.ideality_factor = _n;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setResistanceSeries(double _Rs)
 {
-	resistance_series = _Rs;
+	if (technology->resistance_series != _Rs){
+		CellTechnology changed = *technology;
+		changed.resistance_series = _Rs;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setResistanceShunt(double _Rsh)
 {
-	resistance_shunt = _Rsh;
+	if (technology->resistance_shunt != _Rsh){
+		CellTechnology changed = *technology;
+		changed.resistance_shunt = _Rsh;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setTemperatureCoeff(double _a)
 {
-	temperature_coeff = _a;
+	if (technology->temperature_coeff != _a){
+		CellTechnology changed = *technology;
+		changed.temperature_coeff = _a;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setVoltageTemperatureCoeff(double _B)
 {
-	voltage_temperature_coeff = _B;
+	if (technology->voltage_temperature_coeff != _B){
+		CellTechnology changed = *technology;
+		changed.voltage_temperature_coeff = _B;
+		technology = CellTechnology::intern(changed);
+	}
 }
 void SolarCell::setBreakdownExponent(double _breakdown_exponent)
 {
-	breakdown_exponent = _breakdown_exponent;
+	if (technology->breakdown_exponent != _breakdown_exponent){
+		CellTechnology changed = *technology;
+		changed.breakdown_exponent = _breakdown_exponent;
+		technology = CellTechnology::intern(changed);
+	}
+}
+void SolarCell::setTechnology(const CellTechnology *_technology)
+{
+	technology = _technology;
 }
 double SolarCell::calcFunctionC(void)
 {
 	double x,y,z,multi, f;
 	double Vt = BOLTZMANN_CONST*temperature_cell/ELECTRONS_CHARGE;
 
-	x = (voltage_cell + current_cell*resistance_series)/(ideality_factor*Vt);
-	y = 1-(voltage_cell + current_cell*resistance_series)/voltage_breakdown;
-	multi = 1+breakdown_alpha*pow(y,-breakdown_exponent); //
-	z = (voltage_cell + current_cell*resistance_series)*multi/resistance_shunt;
+	x = (voltage_cell + current_cell*technology->resistance_series)/(technology->ideality_factor*Vt);
+	y = 1-(voltage_cell + current_cell*technology->resistance_series)/technology->voltage_breakdown;
+	multi = 1+technology->breakdown_alpha*pow(y,-technology->breakdown_exponent); //
+	z = (voltage_cell + current_cell*technology->resistance_series)*multi/technology->resistance_shunt;
 	f = current_cell - current_photogenerated + current_reverse_saturation*(exp(x)-1) + z;
 
 	return(f);
@@ -243,12 +491,12 @@ double SolarCell::calcFunctionCellDerivativeRespectCurrent(void)
 	double x,fp, w, y, z, multi, rupt;
 	double Vt = BOLTZMANN_CONST*temperature_cell/ELECTRONS_CHARGE;
 
-	x = (voltage_cell + current_cell*resistance_series)/(ideality_factor*Vt);
-	w = (current_reverse_saturation*resistance_series)/(ideality_factor*Vt);
-	y = 1-(voltage_cell + current_cell*resistance_series)/voltage_breakdown;
-	multi = 1+breakdown_alpha*pow(y,-breakdown_exponent);
-	z = resistance_series*multi/resistance_shunt;
-	rupt = breakdown_exponent*breakdown_alpha*(voltage_cell + current_cell*resistance_series)*pow(y,-breakdown_exponent-1)*resistance_series/(voltage_breakdown*resistance_shunt);
+	x = (voltage_cell + current_cell*technology->resistance_series)/(technology->ideality_factor*Vt);
+	w = (current_reverse_saturation*technology->resistance_series)/(technology->ideality_factor*Vt);
+	y = 1-(voltage_cell + current_cell*technology->resistance_series)/technology->voltage_breakdown;
+	multi = 1+technology->breakdown_alpha*pow(y,-technology->breakdown_exponent);
+	z = technology->resistance_series*multi/technology->resistance_shunt;
+	rupt = technology->breakdown_exponent*technology->breakdown_alpha*(voltage_cell + current_cell*technology->resistance_series)*pow(y,-technology->breakdown_exponent-1)*technology->resistance_series/(technology->voltage_breakdown*technology->resistance_shunt);
 
 	fp = 1 + w*exp(x) + z + rupt;
 
@@ -259,15 +507,84 @@ double SolarCell::calcFunctionCellDerivativeRespectVoltage(void)
 	double x,fp, w, y, z, multi, rupt;
 	double Vt = BOLTZMANN_CONST*temperature_cell/ELECTRONS_CHARGE;
 
-	x = (voltage_cell + current_cell*resistance_series)/(ideality_factor*Vt);
-	w = current_reverse_saturation/(ideality_factor*Vt);
-	y = 1-(voltage_cell + current_cell*resistance_series)/voltage_breakdown;
-	multi = 1+breakdown_alpha*pow(y,-breakdown_exponent);
-	z = multi/resistance_shunt;
-	rupt = breakdown_exponent*breakdown_alpha*(voltage_cell + current_cell*resistance_series)*pow(y,-breakdown_exponent-1)/(voltage_breakdown*resistance_shunt);
+	x = (voltage_cell + current_cell*technology->resistance_series)/(technology->ideality_factor*Vt);
+	w = current_reverse_saturation/(technology->ideality_factor*Vt);
+	y = 1-(voltage_cell + current_cell*technology->resistance_series)/technology->voltage_breakdown;
+	multi = 1+technology->breakdown_alpha*pow(y,-technology->breakdown_exponent);
+	z = multi/technology->resistance_shunt;
+	rupt = technology->breakdown_exponent*technology->breakdown_alpha*(voltage_cell + current_cell*technology->resistance_series)*pow(y,-technology->breakdown_exponent-1)/(technology->voltage_breakdown*technology->resistance_shunt);
 	fp = w*exp(x) + z + rupt;
 
 	return(fp);
 }
 
+void SolarCell::calcFunctionCAndDerivatives(double &f, double &dfdV, double &dfdI)
+{
+	double Vt = BOLTZMANN_CONST*temperature_cell/ELECTRONS_CHARGE;
+	double nVt = technology->ideality_factor*Vt;
+
+	// Voltage of the diode, shared by every term
+	double Vd = voltage_cell + current_cell*technology->resistance_series;
+	double ex = exp(Vd/nVt);
+	double y = 1-Vd/technology->voltage_breakdown;
+	double py = pow(y,-technology->breakdown_exponent);
+	double multi = 1+technology->breakdown_alpha*py;
+
+	f = current_cell - current_photogenerated + current_reverse_saturation*(ex-1) + Vd*multi/technology->resistance_shunt;
+	// pow(y,-breakdown_exponent-1) = py/y
+	dfdV = current_reverse_saturation*ex/nVt + multi/technology->resistance_shunt
+			+ technology->breakdown_exponent*technology->breakdown_alpha*Vd*(py/y)/(technology->voltage_breakdown*technology->resistance_shunt);
+	// The current only appears through Vd (and the term of the current itself)
+	dfdI = 1 + technology->resistance_series*dfdV;
+}
+
+void SolarCell::calcFunctionCAndDerivatives(SolarCell *cells, const int *index, int count, double *f, double *dfdV, double *dfdI)
+{
+	for (int k = 0; k < count; ++k){
+		SolarCell &cell = (index != NULL) ? cells[index[k]] : cells[k];
+		cell.calcFunctionCAndDerivatives(f[k], dfdV[k], dfdI[k]);
+	}
+}
+
+double SolarCell::calcVoltageForCurrent(double _Icell)
+{
+	double f, fp, fpI, Vnext;
+	current_cell = _Icell;
+
+	// Below this voltage the breakdown term is not defined
+	double lower = technology->voltage_breakdown - current_cell*technology->resistance_series;
+	// The present voltage of the cell is the initial estimate
+	double estimate = voltage_cell;
+	// Looks for a voltage where the function is positive
+	double upper = VOLTAGE_OPEN_CIRCUIT_REF;
+	if (estimate > upper) upper = estimate;
+	voltage_cell = upper;
+	for (int i = 0; i < CELL_MAX_ITERATIONS_REF && calcFunctionC() < 0; ++i){
+		upper += 0.5;
+		voltage_cell = upper;
+	}
+
+	// The initial estimate must be inside the bracket
+	voltage_cell = (estimate > lower && estimate < upper) ? estimate : 0.5*(lower+upper);
+
+	for (int i = 0; i < CELL_MAX_ITERATIONS_REF; ++i){
+		calcFunctionCAndDerivatives(f, fp, fpI);
+		if (fabs(f) <= CELL_FUNCTION_TOLERANCE_REF) break;
+		if (f < 0){
+			lower = voltage_cell;
+		}else{
+			upper = voltage_cell;
+		}
+		Vnext = voltage_cell - f/fp;
+		// Bisection when the Newton step leaves the bracket
+		if (!(Vnext > lower && Vnext < upper)){
+			Vnext = 0.5*(lower+upper);
+		}
+		if (Vnext == voltage_cell) break;
+		voltage_cell = Vnext;
+	}
+
+	return(voltage_cell);
+}
+
 }
@@ -23,6 +23,9 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 namespace stringarma{
 
 // Constants definitions
@@ -60,6 +63,77 @@ constexpr double TEMPERATURE_COEFF_REF {0.0004};
 constexpr double VOLTAGE_TEMPERATURE_COEFF_REF {-0.0023};
 /// Breakdown exponent.
 constexpr double BREAKDOWN_EXPONENT_REF {3.0};
+/// Tolerance of the function fc when the voltage of a single cell is solved for a given current [A].
+constexpr double CELL_FUNCTION_TOLERANCE_REF {1e-10};
+/// Maximum number of iterations when the voltage of a single cell is solved for a given current.
+constexpr int CELL_MAX_ITERATIONS_REF {100};
+
+/**
+ * Technology parameters of a PV cell, shared by the cells that are built the same way (flyweight).
+ *
+ * SolarPanel forces these parameters to be equal for every cell of the panel, so a SolarCell only stores its own
+ * state (irradiance, temperature, currents and voltages) and points to a descriptor of this class.
+ * The descriptors are unique and never change: they are obtained with intern(), and when a parameter of a cell is
+ * set the cell points to another descriptor. The descriptors are kept in a pool, hashed by their parameters.
+ *
+ * The pool is never released: a descriptor is valid from the moment it is interned until the end of the program, so
+ * the pointers can be copied freely between cells without counting references. The pool holds one descriptor for every
+ * different set of parameters ever used (the setters of a panel intern a single descriptor for all of its cells), so it
+ * only grows when a program keeps creating new technologies, e.g. when it sweeps a parameter.
+ */
+struct CellTechnology {
+	/// Breakdown voltage [V].
+	double voltage_breakdown;
+	/// Breakdown alpha
+	double breakdown_alpha;
+	/// Soiling factor
+	double soiling_factor;
+	/// Ideality factor
+	double ideality_factor;
+	/// Total resistance of the cell in series.
+	double resistance_series;
+	/// Total shunt resistance of the cell.
+	double resistance_shunt;
+	/// Temperature coefficient.
+	double temperature_coeff;
+	/// Voltage temperature coefficient.
+	double voltage_temperature_coeff;
+	/// Breakdown exponent.
+	double breakdown_exponent;
+
+	/**
+	 * Constructor of the class CellTechnology.
+	 * Uses all the reference values of the parameters (see SolarCell).
+	 */
+	CellTechnology(void);
+	/**
+	 * Compares every parameter of two descriptors.
+	 * @param other Descriptor to compare.
+	 * @returns True if every parameter is equal.
+	 */
+	bool operator==(const CellTechnology &) const;
+	/**
+	 * Hash of every parameter of a descriptor, consistent with operator==. Used by the pool of intern().
+	 */
+	struct Hash {
+		/**
+		 * @param technology Descriptor to hash.
+		 * @returns The combined hash of the parameters.
+		 */
+		size_t operator()(const CellTechnology &) const;
+	};
+	/**
+	 * Finds the shared descriptor with the same parameters, and creates it if there is none. It can be called from several threads.
+	 * @param technology Parameters of the descriptor.
+	 * @returns A pointer to the shared descriptor.
+	 */
+	static const CellTechnology *intern(const CellTechnology &);
+	/**
+	 * Gets the shared descriptor with the reference values, used by the cells when they are created.
+	 * @returns A pointer to the shared descriptor.
+	 */
+	static const CellTechnology *reference(void);
+};
 
 /** Represents a PV cell, the most basic element of a solar generator.
  *
@@ -90,7 +164,8 @@ constexpr double BREAKDOWN_EXPONENT_REF {3.0};
  * - **Tcref** The temperature of the cell of reference is 25.0 ºC.
  * - **Gref** The irradiance of reference is 1000 W/m2.
  *
- * The mathematical models of this library use some constants or approximations. These parameters can be set by the user.
+ * The mathematical models of this library use some constants or approximations. These parameters can be set by the user,
+ * and they are shared by the cells of a panel in a CellTechnology descriptor.
  * The values of reference used related to this class are:
  * - \f$ \alpha \f$ Breakdown alpha parameter: 0.002
  * - **Vbr** Breakdown voltage: -15.0 V
@@ -128,24 +203,8 @@ protected:
 	double current_cell;
 	/// Voltage between the terminals of the cell [V].
 	double voltage_cell;
-	/// Breakdown voltage [V].
-	double voltage_breakdown;
-	/// Breakdown alpha
-	double breakdown_alpha;
-	/// Soiling factor
-	double soiling_factor;
-	/// Ideality factor
-	double ideality_factor;
-	/// Total resistance of the cell in series.
-	double resistance_series;
-	/// Total shunt resistance of the cell.
-	double resistance_shunt;
-	/// Temperature coefficient.
-	double temperature_coeff;
-	/// Voltage temperature coefficient.
-	double voltage_temperature_coeff;
-	/// Breakdown exponent.
-	double breakdown_exponent;
+	/// Technology parameters, shared with the other cells of the panel.
+	const CellTechnology *technology;
 
 public:
 	/**
@@ -156,10 +215,18 @@ public:
 	/**
 	 * Constructor of the class solar_cell.
 	 *
-	 * Uses the same attributes as the solar_cell object introduced as a parameter.
+	 * Uses the same attributes as the solar_cell object introduced as a parameter, including its index,
+	 * the same as the assignment operator.
 	 * @param solar_cell object to copy the attributes from.
 	 */
 	SolarCell(const SolarCell&);
+	/**
+	 * Assignment operator of the class solar_cell.
+	 *
+	 * Copies every attribute of the solar_cell object introduced as a parameter, including its index.
+	 * @param solar_cell object to copy the attributes from.
+	 */
+	SolarCell& operator=(const SolarCell&) = default;
 	/**
 	 * Set an integer value for the index.
 	 * @param Integer number of the index.
@@ -330,6 +397,16 @@ public:
 	 * @returns A double type with the value of breakdown exponent.
 	 */
 	double getBreakdownExponent(void);
+	/**
+	 * Gets the technology parameters of the cell.
+	 * @returns A pointer to the shared descriptor (see CellTechnology).
+	 */
+	const CellTechnology *getTechnology(void);
+	/**
+	 * Sets the technology parameters of the cell.
+	 * @param technology Pointer to a shared descriptor, obtained with CellTechnology::intern().
+	 */
+	void setTechnology(const CellTechnology *);
 	/**
 	 * Calculates the fc function described in the @ref math part of the @ref mainPage.
 	 *
@@ -359,6 +436,87 @@ public:
 	 * @see @ref math
 	 */
 	double calcFunctionCellDerivativeRespectVoltage(void);
+	/**
+	 * Calculates the fc function and its partial derivatives respect the voltage and the current of the cell at once.
+	 *
+	 * It gives the same values as calcFunctionC(), calcFunctionCellDerivativeRespectVoltage() and
+	 * calcFunctionCellDerivativeRespectCurrent(), but the exponential and the power of the breakdown term are only
+	 * calculated once. The current values of Vcell and Icell are used.
+	 *
+	 * @param f Value of the function fc.
+	 * @param dfdV Partial derivative of fc respect the voltage of the cell.
+	 * @param dfdI Partial derivative of fc respect the current of the cell.
+	 * @see @ref math
+	 */
+	void calcFunctionCAndDerivatives(double &f, double &dfdV, double &dfdI);
+	/**
+	 * Calculates the fc function and its partial derivatives for a batch of cells (see calcFunctionCAndDerivatives).
+	 *
+	 * @param cells Array of cells.
+	 * @param index Position in the array of every cell of the batch. If it is NULL, the first count cells of the array are used.
+	 * @param count Number of cells in the batch.
+	 * @param f Array where the value of the function fc of every cell of the batch is stored.
+	 * @param dfdV Array where the partial derivative respect the voltage of every cell of the batch is stored.
+	 * @param dfdI Array where the partial derivative respect the current of every cell of the batch is stored.
+	 */
+	static void calcFunctionCAndDerivatives(SolarCell *cells, const int *index, int count, double *f, double *dfdV, double *dfdI);
+	/**
+	 * Finds the voltage of the cell that makes the fc function zero for a given current through the cell.
+	 *
+	 * The fc function increases monotonically with the voltage above the breakdown asymptote, so the root is bracketed
+	 * and found by the Newton-Raphson method, safeguarded by bisection. The present voltage of the cell is the initial estimate.
+	 * The current and voltage of the cell are updated with the solution.
+	 *
+	 * @param Icell Current through the cell [A].
+	 * @returns A double type with the voltage of the cell [V].
+	 * @see @ref math
+	 */
+	double calcVoltageForCurrent(double);
 	};
 
+/**
+ * Parameters and working point of a set of cells, stored field by field (structure of arrays).
+ *
+ * Every field is a contiguous array with one element for every cell, and the technology parameters are shared by
+ * the whole set, so the fc function of the whole set is evaluated by a single loop that the compiler can vectorize.
+ * The exponential and the logarithm of this loop are computed without the math library, and on x86-64 Linux with
+ * GCC the loop is compiled for AVX-512, AVX2 and the baseline instruction set, selected at run time by the processor
+ * (scalar code elsewhere).
+ * @see SolarCell::calcFunctionCAndDerivatives
+ */
+struct CellArrays {
+	/// Voltage of every cell [V].
+	std::vector<double> voltage;
+	/// Current through every cell [A].
+	std::vector<double> current;
+	/// Photogenerated current of every cell [A].
+	std::vector<double> current_photogenerated;
+	/// Reverse saturation current of every cell [A].
+	std::vector<double> current_reverse_saturation;
+	/// Ideality factor by the thermal voltage of every cell [V].
+	std::vector<double> thermal_voltage;
+	/// Technology parameters, shared by every cell of the set.
+	const CellTechnology *technology;
+
+	/**
+	 * Sizes every field for a number of cells.
+	 * @param count Number of cells.
+	 */
+	void resize(int count);
+	/**
+	 * Copies the parameters and the working point of a cell.
+	 * Every cell of the set must have the same technology (see CellTechnology), which is the case in a SolarPanel.
+	 * @param k Position of the cell in the arrays.
+	 * @param cell SolarCell object to copy.
+	 */
+	void setCell(int k, SolarCell &cell);
+	/**
+	 * Calculates the fc function and its partial derivatives of every cell, with its present voltage and current.
+	 * @param f Array where the value of the function fc of every cell is stored.
+	 * @param dfdV Array where the partial derivative respect the voltage of every cell is stored.
+	 * @param dfdI Array where the partial derivative respect the current of every cell is stored.
+	 */
+	void calcFunctionCAndDerivatives(double *f, double *dfdV, double *dfdI) const;
+};
+
 }
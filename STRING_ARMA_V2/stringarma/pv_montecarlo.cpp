@@ -0,0 +1,431 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <exception>
+#include "pv_montecarlo.h"
+
+using namespace std;
+
+namespace stringarma{
+
+RunningStatistics :: RunningStatistics(double _lower_limit, double _upper_limit, int numb_bins)
+{
+	count = 0;
+	mean = 0.0;
+	sum_squares = 0.0;
+	minimum = NAN;
+	maximum = NAN;
+	lower_limit = _lower_limit;
+	upper_limit = _upper_limit;
+	histogram.assign(numb_bins, 0);
+}
+
+void RunningStatistics :: add(double value)
+{
+	count += 1;
+	double delta = value - mean;
+	mean += delta/count;
+	sum_squares += delta*(value - mean);
+	if (count == 1 || value < minimum){
+		minimum = value;
+	}
+	if (count == 1 || value > maximum){
+		maximum = value;
+	}
+
+	int numb_bins = histogram.size();
+	int bin = (int)floor((value - lower_limit)/(upper_limit - lower_limit)*numb_bins);
+	bin = bin < 0 ? 0 : (bin >= numb_bins ? numb_bins - 1 : bin);
+	histogram[bin] += 1;
+}
+
+void RunningStatistics :: merge(const RunningStatistics &other)
+{
+	if (other.histogram.size() != histogram.size() || other.lower_limit != lower_limit || other.upper_limit != upper_limit)
+	{
+		throw std::runtime_error("Only statistics with the same histogram can be merged.");
+	}
+	if (other.count == 0){
+		return;
+	}
+	if (count == 0){
+		*this = other;
+		return;
+	}
+
+	// Combination of the means and variances of both series (Chan et al.)
+	long total = count + other.count;
+	double delta = other.mean - mean;
+	mean += delta*other.count/total;
+	sum_squares += other.sum_squares + delta*delta*((double)count*other.count/total);
+	count = total;
+	minimum = other.minimum < minimum ? other.minimum : minimum;
+	maximum = other.maximum > maximum ? other.maximum : maximum;
+	for (unsigned int k = 0; k < histogram.size(); ++k)
+	{
+		histogram[k] += other.histogram[k];
+	}
+}
+
+long RunningStatistics :: getCount(void)
+{
+	return(count);
+}
+
+double RunningStatistics :: getMean(void)
+{
+	return(count > 0 ? mean : NAN);
+}
+
+double RunningStatistics :: getVariance(void)
+{
+	return(count > 1 ? sum_squares/(count - 1) : NAN);
+}
+
+double RunningStatistics :: getStandardDeviation(void)
+{
+	return(sqrt(getVariance()));
+}
+
+double RunningStatistics :: getMinimum(void)
+{
+	return(minimum);
+}
+
+double RunningStatistics :: getMaximum(void)
+{
+	return(maximum);
+}
+
+double RunningStatistics :: getQuantile(double p)
+{
+	if (count == 0){
+		return(NAN);
+	}
+	int numb_bins = histogram.size();
+	double width = (upper_limit - lower_limit)/numb_bins;
+	double target = p*count;
+	double accumulated = 0.0;
+	double quantile = maximum;
+	for (int k = 0; k < numb_bins; ++k)
+	{
+		if (histogram[k] > 0 && accumulated + histogram[k] >= target)
+		{
+			// Linear interpolation inside the bin
+			quantile = lower_limit + width*(k + (target - accumulated)/histogram[k]);
+			break;
+		}
+		accumulated += histogram[k];
+	}
+	// The first and the last bin also contain the values out of the limits
+	quantile = quantile < minimum ? minimum : quantile;
+	quantile = quantile > maximum ? maximum : quantile;
+	return(quantile);
+}
+
+const vector<long>& RunningStatistics :: getHistogram(void)
+{
+	return(histogram);
+}
+
+double RunningStatistics :: getLowerLimit(void)
+{
+	return(lower_limit);
+}
+
+double RunningStatistics :: getUpperLimit(void)
+{
+	return(upper_limit);
+}
+
+MonteCarloSimulator :: MonteCarloSimulator(SolarPanel &_panel) : panel(_panel),
+		power_statistics(0.0, 1.0, MONTECARLO_HISTOGRAM_BINS_REF), reverse_statistics(0.0, 1.0, MONTECARLO_HISTOGRAM_BINS_REF)
+{
+	mismatch.soiling_minimum = 1.0;
+	mismatch.current_spread = 0.0;
+	mismatch.temperature_spread = 0.0;
+	mismatch.shading_probability = 0.0;
+	mismatch.shading_minimum = 1.0;
+	mismatch.shading_maximum = 1.0;
+	seed = MONTECARLO_SEED_REF;
+	number_threads = NUMBER_THREADS_REF;
+	solve_method = NESTED_NEWTON_METHOD;
+	number_bins = MONTECARLO_HISTOGRAM_BINS_REF;
+	number_scenarios = 0;
+	number_failed = 0;
+	base_power = 0.0;
+	try
+	{
+		findBasePower();
+	}
+	catch(...)
+	{
+		std::cout << "Error when solving the panel without mismatch." << endl;
+	}
+}
+
+void MonteCarloSimulator :: setMismatch(const MismatchDistribution &_mismatch)
+{
+	try
+	{
+		if (_mismatch.soiling_minimum < 0 || _mismatch.soiling_minimum > 1 || _mismatch.current_spread < 0
+				|| _mismatch.temperature_spread < 0 || _mismatch.shading_probability < 0 || _mismatch.shading_probability > 1
+				|| _mismatch.shading_minimum < 0 || _mismatch.shading_minimum > _mismatch.shading_maximum)
+		{
+			throw std::runtime_error("Wrong distribution of the mismatch.");
+		}
+		mismatch = _mismatch;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the mismatch of the cells." << endl;
+	}
+}
+
+void MonteCarloSimulator :: setSeed(unsigned long _seed)
+{
+	seed = _seed;
+}
+
+void MonteCarloSimulator :: setNumberThreads(int _number_threads)
+{
+	try
+	{
+		if (_number_threads < 1)
+		{
+			throw std::runtime_error("The number of threads must be at least 1.");
+		}
+		number_threads = _number_threads;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the number of threads." << endl;
+	}
+}
+
+void MonteCarloSimulator :: setSolveMethod(SolveMethodType _solve_method)
+{
+	solve_method = _solve_method;
+}
+
+void MonteCarloSimulator :: setHistogramBins(int numb_bins)
+{
+	try
+	{
+		if (numb_bins < 1)
+		{
+			throw std::runtime_error("The histograms need at least one bin.");
+		}
+		number_bins = numb_bins;
+		clearResults();
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the bins of the histograms." << endl;
+	}
+}
+
+void MonteCarloSimulator :: findBasePower(void)
+{
+	SolarSolver solver(panel);
+	solver.setSolveMethod(solve_method);
+	MaximumPowerPoint mpp = solver.findMaximumPowerPoint();
+	base_power = mpp.solved ? mpp.power : 0.0;
+	clearResults();
+	if (!mpp.solved)
+	{
+		throw std::runtime_error("The maximum power point of the panel without mismatch was not found.");
+	}
+}
+
+void MonteCarloSimulator :: clearResults(void)
+{
+	number_scenarios = 0;
+	number_failed = 0;
+	power_statistics = RunningStatistics(0.0, base_power > 0 ? 2*base_power : 1.0, number_bins);
+	reverse_statistics = RunningStatistics(0.0, 1.0, number_bins);
+}
+
+void MonteCarloSimulator :: generateScenario(long scenario, vector<CellConditions> &changes)
+{
+	// Every scenario has its own sequence of random numbers
+	seed_seq sequence = {(unsigned int)(seed & 0xffffffffUL), (unsigned int)((unsigned long long)seed >> 32),
+			(unsigned int)(scenario & 0xffffffffL), (unsigned int)((unsigned long long)scenario >> 32)};
+	mt19937_64 generator(sequence);
+	uniform_real_distribution<double> uniform(0.0, 1.0);
+	normal_distribution<double> normal(0.0, 1.0);
+
+	changes.clear();
+	int number_strings = panel.getPanelSize();
+	for (int s = 0; s < number_strings; ++s)
+	{
+		int string_size = panel.getStringSize(s);
+		for (int c = 0; c < string_size; ++c)
+		{
+			double soiling = mismatch.soiling_minimum + (1.0 - mismatch.soiling_minimum)*uniform(generator);
+			double spread = 1.0 + mismatch.current_spread*normal(generator);
+			double shading = 1.0;
+			if (uniform(generator) < mismatch.shading_probability)
+			{
+				shading = mismatch.shading_minimum + (mismatch.shading_maximum - mismatch.shading_minimum)*uniform(generator);
+			}
+			double temperature = panel.getCellTemperature(s, c) + mismatch.temperature_spread*normal(generator);
+			double irradiance = panel.getCellIrradiance(s, c)*soiling*spread*shading;
+
+			CellConditions cell = {s, c, irradiance < MONTECARLO_MINIMUM_IRRADIANCE_REF ? MONTECARLO_MINIMUM_IRRADIANCE_REF : irradiance,
+					temperature};
+			changes.push_back(cell);
+		}
+	}
+}
+
+void MonteCarloSimulator :: run(long numb_scenarios)
+{
+	try
+	{
+		int number_cells = 0;
+		for (int s = 0; s < panel.getPanelSize(); ++s)
+		{
+			number_cells += panel.getStringSize(s);
+		}
+
+		int numb_parts = number_threads < numb_scenarios ? number_threads : numb_scenarios;
+		if (numb_parts < 1){
+			return;
+		}
+		long first_scenario = number_scenarios;
+
+		// Every thread keeps its own solver and statistics, which are merged in order at the end
+		list <SolarSolver> solvers;
+		vector <RunningStatistics> powers(numb_parts, RunningStatistics(power_statistics.getLowerLimit(),
+				power_statistics.getUpperLimit(), number_bins));
+		vector <RunningStatistics> reverses(numb_parts, RunningStatistics(0.0, 1.0, number_bins));
+		vector <long> failed(numb_parts, 0);
+		vector <std::exception_ptr> errors(numb_parts);
+		for (int t = 0; t < numb_parts; ++t)
+		{
+			solvers.emplace_back(panel);
+			solvers.back().setSolveMethod(solve_method);
+		}
+
+		auto solveScenarios = [this, &powers, &reverses, &failed, &errors, number_cells, first_scenario](SolarSolver *solver, int t, long first, long last)
+		{
+			try
+			{
+				vector <CellConditions> changes;
+				for (long k = first; k < last; ++k)
+				{
+					generateScenario(first_scenario + k, changes);
+					solver->setCellConditions(changes);
+					MaximumPowerPoint mpp = solver->findMaximumPowerPoint();
+					// A failed scenario is not a panel without power
+					if (!mpp.solved)
+					{
+						failed[t] += 1;
+						continue;
+					}
+					powers[t].add(mpp.power);
+					reverses[t].add((double)mpp.number_cells_reverse/number_cells);
+				}
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+			}
+		};
+
+		vector <std::thread> threads;
+		list <SolarSolver>::iterator it = solvers.begin();
+		for (int t = 0; t < numb_parts; ++t, ++it)
+		{
+			// Consecutive scenarios are solved by the same thread
+			long first = numb_scenarios*t/numb_parts;
+			long last = numb_scenarios*(t+1)/numb_parts;
+			if (numb_parts == 1){
+				solveScenarios(&*it, t, first, last);
+			}
+			else{
+				threads.push_back(std::thread(solveScenarios, &*it, t, first, last));
+			}
+		}
+		for (unsigned int t = 0; t < threads.size(); ++t)
+		{
+			threads[t].join();
+		}
+		for (int t = 0; t < numb_parts; ++t)
+		{
+			if (errors[t]){
+				std::rethrow_exception(errors[t]);
+			}
+		}
+
+		for (int t = 0; t < numb_parts; ++t)
+		{
+			power_statistics.merge(powers[t]);
+			reverse_statistics.merge(reverses[t]);
+			number_failed += failed[t];
+		}
+		number_scenarios += numb_scenarios;
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when solving the Monte Carlo scenarios: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when solving the Monte Carlo scenarios." << endl;
+	}
+}
+
+long MonteCarloSimulator :: getNumberScenarios(void)
+{
+	return(number_scenarios);
+}
+
+long MonteCarloSimulator :: getNumberFailedScenarios(void)
+{
+	return(number_failed);
+}
+
+double MonteCarloSimulator :: getBasePower(void)
+{
+	return(base_power);
+}
+
+RunningStatistics MonteCarloSimulator :: getPowerStatistics(void)
+{
+	return(power_statistics);
+}
+
+RunningStatistics MonteCarloSimulator :: getReverseCellsStatistics(void)
+{
+	return(reverse_statistics);
+}
+
+}
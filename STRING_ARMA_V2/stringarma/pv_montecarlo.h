@@ -0,0 +1,279 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include "pv_solver.h"
+
+namespace stringarma{
+
+#define MONTECARLO_HISTOGRAM_BINS_REF 100
+#define MONTECARLO_SEED_REF 1
+#define MONTECARLO_MINIMUM_IRRADIANCE_REF 1.0
+
+/**
+ * Statistics of a series of values, updated value by value without storing them.
+ *
+ * The mean and the variance are updated with the method of Welford. The quantiles are estimated from a histogram with
+ * bins of the same width between a lower and an upper limit. The values out of the limits are counted in the first
+ * and in the last bin.
+ */
+class RunningStatistics
+{
+private:
+	/// Number of values added.
+	long count;
+	/// Mean of the values.
+	double mean;
+	/// Sum of the squared differences respect the mean.
+	double sum_squares;
+	/// Minimum value.
+	double minimum;
+	/// Maximum value.
+	double maximum;
+	/// Lower limit of the histogram.
+	double lower_limit;
+	/// Upper limit of the histogram.
+	double upper_limit;
+	/// Number of values in every bin of the histogram.
+	std::vector<long> histogram;
+
+public:
+	/**
+	 * Constructor of the class RunningStatistics.
+	 * @param lower_limit Lower limit of the histogram.
+	 * @param upper_limit Upper limit of the histogram.
+	 * @param numb_bins Number of bins of the histogram.
+	 */
+	RunningStatistics(double, double, int);
+	/**
+	 * Adds a value to the statistics.
+	 * @param value New value.
+	 */
+	void add(double);
+	/**
+	 * Adds the values of other statistics with the same histogram limits and number of bins.
+	 * @param other RunningStatistics object to add.
+	 */
+	void merge(const RunningStatistics &);
+	/**
+	 * Returns the number of values added.
+	 * @returns The number of values.
+	 */
+	long getCount(void);
+	/**
+	 * Returns the mean of the values.
+	 * @returns The mean, or NAN without values.
+	 */
+	double getMean(void);
+	/**
+	 * Returns the sample variance of the values.
+	 * @returns The variance, or NAN with less than two values.
+	 */
+	double getVariance(void);
+	/**
+	 * Returns the sample standard deviation of the values.
+	 * @returns The standard deviation, or NAN with less than two values.
+	 */
+	double getStandardDeviation(void);
+	/**
+	 * Returns the minimum of the values.
+	 * @returns The minimum, or NAN without values.
+	 */
+	double getMinimum(void);
+	/**
+	 * Returns the maximum of the values.
+	 * @returns The maximum, or NAN without values.
+	 */
+	double getMaximum(void);
+	/**
+	 * Estimates a quantile of the values from the histogram, interpolating inside the bin.
+	 * The precision is the width of a bin.
+	 * @param p Probability of the quantile, between 0 and 1.
+	 * @returns The estimated quantile, or NAN without values.
+	 */
+	double getQuantile(double);
+	/**
+	 * Returns the histogram of the values.
+	 * @returns A vector with the number of values in every bin.
+	 */
+	const std::vector<long>& getHistogram(void);
+	/**
+	 * Returns the lower limit of the histogram.
+	 * @returns The lower limit of the first bin.
+	 */
+	double getLowerLimit(void);
+	/**
+	 * Returns the upper limit of the histogram.
+	 * @returns The upper limit of the last bin.
+	 */
+	double getUpperLimit(void);
+};
+
+/**
+ * Random mismatch applied to every cell of the panel in every scenario of a Monte Carlo analysis.
+ *
+ * The cells of a panel share the same properties (see SolarPanel), so the mismatch is applied to the conditions of
+ * every cell. The soiling, the spread of the shortcut current and the shading scale the irradiance of the cell,
+ * since its photogenerated current is proportional to it. The spread of temperature is added to its temperature.
+ * The irradiance of a cell is never below MONTECARLO_MINIMUM_IRRADIANCE_REF.
+ */
+struct MismatchDistribution {
+	/// Minimum soiling factor of a cell. The factor of every cell is uniform between this value and 1.
+	double soiling_minimum;
+	/// Relative standard deviation of the shortcut current of the cells (normal distribution).
+	double current_spread;
+	/// Standard deviation of the temperature of the cells (normal distribution).
+	double temperature_spread;
+	/// Probability that a cell is shaded.
+	double shading_probability;
+	/// Minimum fraction of the irradiance that reaches a shaded cell.
+	double shading_minimum;
+	/// Maximum fraction of the irradiance that reaches a shaded cell. The fraction is uniform between both values.
+	double shading_maximum;
+};
+
+/**
+ * Monte Carlo analysis of the mismatch between the cells of a SolarPanel.
+ *
+ * Every scenario applies a random mismatch (see MismatchDistribution) to the conditions of every cell of the panel
+ * and finds its global maximum power point. Every thread builds its SolarSolver object once and only updates the
+ * conditions of the cells in every scenario (see SolarSolver::setCellConditions).
+ *
+ * The random numbers of every scenario come from its own generator, seeded with the seed of the analysis and the number
+ * of the scenario, so the scenarios are the same whatever the number of threads. Only the statistics of the results
+ * are kept: the power of the maximum power point and the fraction of cells in reverse bias at that point.
+ * A scenario whose maximum power point is not found (see MaximumPowerPoint) is not added to the statistics, but it
+ * is counted (see getNumberFailedScenarios).
+ */
+class MonteCarloSimulator
+{
+protected:
+	/// Panel with the topology and the conditions of the cells without mismatch.
+	SolarPanel &panel;
+	/// Distribution of the mismatch of the cells.
+	MismatchDistribution mismatch;
+	/// Seed of the random numbers.
+	unsigned long seed;
+	/// Number of threads used to solve the scenarios.
+	int number_threads;
+	/// Iterative method used by the solver of every thread.
+	SolveMethodType solve_method;
+	/// Number of bins of the histograms.
+	int number_bins;
+	/// Number of scenarios run, including the failed ones.
+	long number_scenarios;
+	/// Number of scenarios whose maximum power point was not found.
+	long number_failed;
+	/// Power of the maximum power point of the panel without mismatch [W].
+	double base_power;
+	/// Statistics of the power of the maximum power point [W].
+	RunningStatistics power_statistics;
+	/// Statistics of the fraction of cells in reverse bias at the maximum power point.
+	RunningStatistics reverse_statistics;
+
+public:
+	/**
+	 * Constructor of the class MonteCarloSimulator.
+	 * By default there is no mismatch, and the scenarios are solved in the calling thread with the NESTED_NEWTON_METHOD.
+	 * @param panel SolarPanel object with the panel to analyze. It must exist while the simulator is in use.
+	 */
+	MonteCarloSimulator(SolarPanel &);
+	/**
+	 * Sets the distribution of the mismatch of the cells.
+	 * @param mismatch MismatchDistribution struct with the distribution.
+	 */
+	void setMismatch(const MismatchDistribution &);
+	/**
+	 * Sets the seed of the random numbers. The same seed gives the same scenarios.
+	 * @param seed Seed of the random numbers.
+	 */
+	void setSeed(unsigned long);
+	/**
+	 * Sets the number of threads used to solve the scenarios. Every thread has its own SolarSolver object.
+	 * @param Integer value with the number of threads.
+	 */
+	void setNumberThreads(int);
+	/**
+	 * Sets the iterative method used to solve the scenarios (see SolarSolver::setSolveMethod).
+	 * @param SolveMethodType value with the method to use.
+	 */
+	void setSolveMethod(SolveMethodType);
+	/**
+	 * Sets the number of bins of the histograms. The statistics are deleted.
+	 * The power is binned between 0 and twice the power of the panel without mismatch, and the fraction of cells
+	 * between 0 and 1.
+	 * @param numb_bins Number of bins.
+	 */
+	void setHistogramBins(int);
+	/**
+	 * Solves new scenarios and adds them to the statistics. The scenarios continue the numbering of the previous calls.
+	 * @param numb_scenarios Number of scenarios to solve.
+	 */
+	void run(long);
+	/**
+	 * Deletes the statistics. The numbering of the scenarios starts again.
+	 */
+	void clearResults(void);
+	/**
+	 * Returns the number of scenarios run, including the failed ones.
+	 * @returns The number of scenarios. The statistics contain the ones that did not fail.
+	 */
+	long getNumberScenarios(void);
+	/**
+	 * Returns the number of scenarios whose maximum power point was not found. They are not in the statistics.
+	 * @returns The number of failed scenarios.
+	 */
+	long getNumberFailedScenarios(void);
+	/**
+	 * Returns the power of the maximum power point of the panel without mismatch.
+	 * @returns The power [W].
+	 */
+	double getBasePower(void);
+	/**
+	 * Returns the statistics of the power of the maximum power point of the scenarios.
+	 * @returns A RunningStatistics object with the statistics of the power [W].
+	 */
+	RunningStatistics getPowerStatistics(void);
+	/**
+	 * Returns the statistics of the fraction of cells in reverse bias at the maximum power point of the scenarios.
+	 * @returns A RunningStatistics object with the statistics of the fraction, between 0 and 1.
+	 */
+	RunningStatistics getReverseCellsStatistics(void);
+
+protected:
+	/**
+	 * Solves the maximum power point of the panel without mismatch, to set the limits of the histogram of power.
+	 * If it is not found, the base power is 0 and an exception is thrown.
+	 */
+	void findBasePower(void);
+	/**
+	 * Finds the conditions of every cell in a scenario.
+	 * @param scenario Number of the scenario.
+	 * @param changes Vector where the conditions of every cell are stored.
+	 */
+	void generateScenario(long scenario, std::vector<CellConditions> &changes);
+};
+
+}
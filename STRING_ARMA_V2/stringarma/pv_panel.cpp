@@ -23,8 +23,18 @@
 
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "pv_panel.h"
 
 using namespace std;
@@ -182,11 +192,191 @@ namespace stringarma{
 		return(voltage_knee_diode);
 	}
 
+	/**
+	 * Input file mapped in memory (or read at once where the system can not map it). It is unmapped when destroyed.
+	 */
+	class InputFileView
+	{
+	public:
+		/// First character of the file.
+		const char *begin;
+		/// End of the file.
+		const char *end;
+
+		/**
+		 * Maps the input file in memory.
+		 * @param filepath String with the absolute path of the input file.
+		 */
+		InputFileView(const std::string &filepath)
+		{
+			begin = end = "";
+			mapped = NULL;
+			length = 0;
+#if defined(__unix__) || defined(__APPLE__)
+			int fd = open(filepath.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				throw std::runtime_error("Could not open input file. (File \'" + filepath + "\'.)");
+			}
+			struct stat info;
+			if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+			{
+				length = info.st_size;
+				if (length > 0)
+				{
+					mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (mapped == MAP_FAILED)
+					{
+						mapped = NULL;
+					}
+				}
+			}
+			close(fd);
+			if (mapped != NULL)
+			{
+				madvise(mapped, length, MADV_SEQUENTIAL);
+				begin = (const char*)mapped;
+				end = begin + length;
+				return;
+			}
+#endif
+			// Without memory mapping the whole file is read at once
+			ifstream file(filepath, ios::in | ios::binary);
+			if (!file.is_open())
+			{
+				throw std::runtime_error("Could not open input file. (File \'" + filepath + "\'.)");
+			}
+			buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+			begin = buffer.data();
+			end = begin + buffer.size();
+		}
+
+		~InputFileView()
+		{
+#if defined(__unix__) || defined(__APPLE__)
+			if (mapped != NULL)
+			{
+				munmap(mapped, length);
+			}
+#endif
+		}
+
+	private:
+		/// Memory where the file is mapped, or NULL.
+		void *mapped;
+		/// Length of the mapped file.
+		size_t length;
+		/// Content of the file when it is not mapped.
+		std::string buffer;
+
+		InputFileView(const InputFileView&);
+		InputFileView& operator=(const InputFileView&);
+	};
+
+	/**
+	 * Checks whether a character is a blank of the input file.
+	 */
+	static inline bool isBlank(char c)
+	{
+		return(c == ' ' || c == '\t' || c == '\r' || c == '\n');
+	}
+
+	/**
+	 * Parses a floating-point value at the start of a range of characters, with the same result as strtod.
+	 *
+	 * Plain decimal values with up to 19 significant digits and a small exponent are converted exactly with a single
+	 * multiplication or division, since both the mantissa and the power of ten are exact doubles. Anything else is
+	 * copied and converted by strtod.
+	 * The library is built as C++11, so std::from_chars (C++17) is not available.
+	 * @param p First character of the value.
+	 * @param end End of the range. The value does not continue beyond it.
+	 * @param next Pointer where the first character after the value is stored (p if there is no value).
+	 * @returns The value, or 0 if there is no value.
+	 */
+	static double parseDouble(const char *p, const char *end, const char *&next)
+	{
+		static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+				1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+		const char *q = p;
+		bool negative = false;
+		if (q < end && (*q == '-' || *q == '+'))
+		{
+			negative = (*q == '-');
+			++q;
+		}
+		unsigned long long mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any_digit = false;
+		for (; q < end && *q >= '0' && *q <= '9'; ++q)
+		{
+			any_digit = true;
+			if (mantissa != 0 || *q != '0') ++digits;
+			if (digits <= 19) mantissa = 10*mantissa + (*q - '0');
+			else ++exponent;
+		}
+		if (q < end && *q == '.')
+		{
+			for (++q; q < end && *q >= '0' && *q <= '9'; ++q)
+			{
+				any_digit = true;
+				if (mantissa != 0 || *q != '0') ++digits;
+				if (digits <= 19)
+				{
+					mantissa = 10*mantissa + (*q - '0');
+					--exponent;
+				}
+			}
+		}
+		if (any_digit && q < end && (*q == 'e' || *q == 'E'))
+		{
+			const char *r = q + 1;
+			bool negative_exp = false;
+			if (r < end && (*r == '-' || *r == '+'))
+			{
+				negative_exp = (*r == '-');
+				++r;
+			}
+			if (r < end && *r >= '0' && *r <= '9')
+			{
+				int e = 0;
+				for (; r < end && *r >= '0' && *r <= '9'; ++r)
+				{
+					if (e < 100000) e = 10*e + (*r - '0');
+				}
+				exponent += negative_exp ? -e : e;
+				q = r;
+			}
+		}
+
+		// Fast path: the mantissa and the power of ten are exact, so the result is correctly rounded
+		bool hexadecimal = (q < end && (*q == 'x' || *q == 'X'));
+		if (any_digit && !hexadecimal && digits <= 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+		{
+			double value = (double)mantissa;
+			value = exponent < 0 ? value/powers[-exponent] : value*powers[exponent];
+			next = q;
+			return(negative ? -value : value);
+		}
+
+		// Any other value (hexadecimal, infinity, nan, long or extreme values) is converted by strtod
+		char token[128];
+		int n = 0;
+		for (const char *r = p; r < end && n < (int)sizeof(token) - 1 && *r != ';' && *r != '\n'; ++r)
+		{
+			token[n++] = *r;
+		}
+		token[n] = '\0';
+		char *stop;
+		double value = strtod(token, &stop);
+		next = p + (stop - token);
+		return(value);
+	}
+
 	vector<pair<bool,vector<pair<double,double>>>>
 	SolarPanel :: readInput(std::string filepath)
 	{
-	  ifstream myfile;
-	  myfile.open(filepath, ios::in);
+	  InputFileView file(filepath);
 
 	  vector<pair<bool,vector<pair<double,double>>>> string_info;
 	  /*
@@ -195,192 +385,353 @@ namespace stringarma{
 	   * 1000;25	cell line
 	   * 1000;25
 	   */
-	  if (myfile.is_open())
+	  const char delimiter = ';';
+	  bool ok = true;
+	  int nline = 0;
+	  int intBool = 0;
+
+	  // Every line holds at most a cell: the cells are stored once, sized by the number of lines
+	  size_t numb_lines = 0;
+	  for (const char *p = file.begin; p < file.end; ++numb_lines)
 	    {
-	      bool isDiode;
-	      bool ok;
-	      char delimiter = ';';
-	      char endline = '\n';
-	      char c;
-	      char *s;
-	      char *s2;
-	      double T;
-	      double G;
-	      int nline = 0;
-	      int count_string = -1;
-	      int count_cell = 0;
-	      int pos [2];
-	      int i;
-	      int intBool;
-	      std::string line;
-	      vector<pair<double,double>> opValues;
-	      // Iterate over the whole file
-	      ok = true;
-	      while (std::getline(myfile, line))
-		{
-		  ++nline;
-		  pos [0] = line.find (delimiter);
-		  if (pos [0] == std::string::npos)
-		    {
-		      ok = false;
-		      break;
-		    }
-		  isDiode = true;
-		  for (i = pos [0] + 1; i < line.size () && isDiode; ++i)
-		    {
-		      /* Check whether this is a diode line: there are no
-			 non-blanks after the delimiter.  */
-		      c = line.c_str () [i];
-		      if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
-			{
-			  pos [1] = i;
-			  isDiode = false;
-			}
-		    }
-		  if (isDiode)
+	      const char *eol = (const char*)memchr(p, '\n', file.end - p);
+	      p = eol ? eol + 1 : file.end;
+	    }
+	  vector<pair<double,double>> cells;
+	  cells.reserve(numb_lines);
+	  // Diode and first cell of every string
+	  vector<pair<int,size_t>> strings;
+	  size_t first_cell = 0;
+
+	  // Iterate over the whole file
+	  for (const char *line = file.begin; line < file.end; )
+	    {
+	      const char *eol = (const char*)memchr(line, '\n', file.end - line);
+	      if (eol == NULL)
+		{
+		  eol = file.end;
+		}
+	      ++nline;
+	      const char *delim = (const char*)memchr(line, delimiter, eol - line);
+	      if (delim == NULL)
+		{
+		  ok = false;
+		  break;
+		}
+	      /* Check whether this is a diode line: there are no
+		 non-blanks after the delimiter.  */
+	      const char *second = delim + 1;
+	      while (second < eol && isBlank(*second))
+		{
+		  ++second;
+		}
+	      /* Skip leading blanks.  */
+	      const char *first = line;
+	      while (first < delim && (*first == ' ' || *first == '\t'))
+		{
+		  ++first;
+		}
+
+	      if (second == eol)
+		{
+		  /* Diode line: it must contain zero or more blanks,
+		     a "0" or a "1", and zero or more blanks, a ";",
+		     and zero or more blanks.  */
+		  if (first < delim)
 		    {
-		      /* Diode line: it must contain zero or more blanks,
-			 a "0" or a "1", and zero or more blanks, a ";",
-			 and zero or more blanks.  */
-		      for (i = 0; i < pos [0]; ++i)
+		      const char *q = first;
+		      bool negative = false;
+		      if (*q == '-' || *q == '+')
 			{
-			  /* Skip leading blanks.  */
-			  c = line.c_str () [i];
-			  if (c != ' ' && c != '\t')
-			    {
-			      break;
-			    }
+			  negative = (*q == '-');
+			  ++q;
 			}
-		      if (i < pos [0])
-			{
-			  intBool =  std::stoi (line.c_str () + i);
-			  if (intBool != 0 && intBool != 1)
-			    {
-			      /* Neither "0" nor "1": error.  */
-			      ok = false;
-			      break;
-			    }
-			  if (!opValues.empty())
-			    {
-			      string_info.push_back(make_pair(intBool,opValues));
-			      opValues.clear();
-			    }
-			  count_string++;
-			  count_cell=0;
-			}
-		    }
-		  else
-		    {
-		      /* Cell line: it must contain zero or more blanks, a
-			 valid floating-point value, zero or more blanks,
-			 a ";", zero or more blanks, a valid
-			 floating-point value, and zero or more
-			 blanks.  */
-		      for (i = 0; i < pos [0]; ++i)
+		      if (q == delim || *q < '0' || *q > '9')
 			{
-			  /* Skip leading blanks.  */
-			  c = line.c_str () [i];
-			  if (c != ' ' && c != '\t')
-			    {
-			      break;
-			    }
+			  ok = false;
+			  break;
 			}
-		      if (i < pos [0])
+		      long value = 0;
+		      for (; q < delim && *q >= '0' && *q <= '9' && value < 10; ++q)
 			{
-			  G = strtod (line.c_str () + i, &s);
-			  if (G == HUGE_VAL
-			      || (G == 0.0 && s == line.c_str () + i))
-			    {
-			      /* Not a valid floating-point value:
-				 error.  */
-			      ok = false;
-			      break;
-			    }
-			  for (; s && *s; ++s)
-			    {
-			      /* Check that what is left up to the
-				 delimiter consists of blanks.  */
-			      if (*s != ' ' && *s != '\t' && *s != '\r'
-				  && *s != '\n')
-				{
-				  break;
-				}
-			    }
-			  if (*s != delimiter)
-			    {
-			      /* Something spurious has been found:
-				 error.  */
-			      ok = false;
-			      break;
-			    }
-			  s = (char *) line.c_str () + pos [1];
-			  T = strtod (s, &s2);
-			  if (T == HUGE_VAL
-			      || (T == 0.0 && s2 == s))
-			    {
-			      ok = false;
-			      break;
-			    }
-			  s = s2;
-			  for (; s && *s && ok; ++s)
-			    {
-			      if (*s != ' ' && *s != '\t' && *s != '\r'
-				  && *s != '\n')
-				{
-				  /* Something spurious has been found:
-				     error.  */
-				  ok = false;
-				}
-			    }
-			  if (!ok)
-			    {
-			      break;
-			    }
-				opValues.push_back(make_pair(G,T));
-				count_cell++;
+			  value = 10*value + (*q - '0');
 			}
-		      else
+		      intBool = negative ? -value : value;
+		      if (intBool != 0 && intBool != 1)
 			{
-			  /* First floating-point value not found.  */
+			  /* Neither "0" nor "1": error.  */
 			  ok = false;
 			  break;
 			}
-		    }
-
-		}
-	      myfile.close ();
-			if(!opValues.empty())
+		      if (cells.size() > first_cell)
 			{
-				string_info.push_back(make_pair(intBool,opValues));
+			  strings.push_back(make_pair(intBool, first_cell));
+			  first_cell = cells.size();
 			}
-
-	  if (!ok)
+		    }
+		}
+	      else
 		{
-		  std::string msg ("Error when mapping the input file. "
-			      "Check the input file format. (File \'");
-		  msg += filepath;
-		  msg += "\', line no. ";
-		  msg += std::to_string (nline);
-		  msg += ".)";
-		  throw std::runtime_error(msg);
+		  /* Cell line: it must contain zero or more blanks, a
+		     valid floating-point value, zero or more blanks,
+		     a ";", zero or more blanks, a valid
+		     floating-point value, and zero or more
+		     blanks.  */
+		  if (first == delim)
+		    {
+		      /* First floating-point value not found.  */
+		      ok = false;
+		      break;
+		    }
+		  const char *s;
+		  double G = parseDouble(first, delim, s);
+		  if (G == HUGE_VAL || s == first)
+		    {
+		      /* Not a valid floating-point value:
+			 error.  */
+		      ok = false;
+		      break;
+		    }
+		  /* Check that what is left up to the
+		     delimiter consists of blanks.  */
+		  while (s < delim && isBlank(*s))
+		    {
+		      ++s;
+		    }
+		  if (s != delim)
+		    {
+		      /* Something spurious has been found:
+			 error.  */
+		      ok = false;
+		      break;
+		    }
+		  double T = parseDouble(second, eol, s);
+		  if (T == HUGE_VAL || s == second)
+		    {
+		      ok = false;
+		      break;
+		    }
+		  while (s < eol && isBlank(*s))
+		    {
+		      ++s;
+		    }
+		  if (s != eol)
+		    {
+		      /* Something spurious has been found:
+			 error.  */
+		      ok = false;
+		      break;
+		    }
+		  cells.push_back(make_pair(G,T));
 		}
-	      return string_info;
+	      line = eol + 1;
 	    }
-	  else
+
+	  if (!ok)
 	    {
-	      std::string msg ("Could not open input file. (File \'");
-	      msg += filepath + "\'.)";
+	      std::string msg ("Error when mapping the input file. "
+			  "Check the input file format. (File \'");
+	      msg += filepath;
+	      msg += "\', line no. ";
+	      msg += std::to_string (nline);
+	      msg += ".)";
 	      throw std::runtime_error(msg);
 	    }
+	  if (cells.size() > first_cell)
+	    {
+	      strings.push_back(make_pair(intBool, first_cell));
+	    }
 
+	  // Every string is built with its final size
+	  string_info.resize(strings.size());
+	  for (size_t k = 0; k < strings.size(); ++k)
+	    {
+	      size_t last = (k + 1 < strings.size()) ? strings[k+1].second : cells.size();
+	      string_info[k].first = strings[k].first;
+	      string_info[k].second.assign(cells.begin() + strings[k].second, cells.begin() + last);
+	    }
 	  return string_info;
 	}
 
+	/**
+	 * Number of properties stored in a binary file: the nine properties of the cells and the knee voltage of the
+	 * bypass diodes.
+	 */
+	static const int numb_binary_properties = 10;
+
+	vector<pair<bool,vector<pair<double,double>>>>
+	SolarPanel :: readBinary(std::string filepath)
+	{
+		InputFileView file(filepath);
+		const std::string msg = "Error when mapping the binary file. Check the binary file format. (File \'" + filepath + "\'.)";
+
+		// Header: magic, number of strings, flags and number of cells
+		size_t length = file.end - file.begin;
+		if (length < 24 || memcmp(file.begin, "STRPB001", 8) != 0)
+		{
+			throw std::runtime_error(msg);
+		}
+		uint32_t numb_strings, flags;
+		uint64_t numb_cells;
+		memcpy(&numb_strings, file.begin + 8, sizeof(numb_strings));
+		memcpy(&flags, file.begin + 12, sizeof(flags));
+		memcpy(&numb_cells, file.begin + 16, sizeof(numb_cells));
+		size_t numb_properties = (flags & 1) ? numb_binary_properties : 0;
+		size_t offset_first = 24 + numb_properties*sizeof(double);
+		size_t offset_diode = offset_first + ((size_t)numb_strings + 1)*sizeof(uint64_t);
+		size_t offset_cells = offset_diode + ((numb_strings + 7)/8)*8;
+		if (numb_cells > length/(2*sizeof(double)) || offset_cells + numb_cells*2*sizeof(double) != length)
+		{
+			throw std::runtime_error(msg);
+		}
+
+		vector<uint64_t> first_cell(numb_strings + 1);
+		memcpy(first_cell.data(), file.begin + offset_first, first_cell.size()*sizeof(uint64_t));
+		if (first_cell[0] != 0 || first_cell[numb_strings] != numb_cells)
+		{
+			throw std::runtime_error(msg);
+		}
+		vector<pair<bool,vector<pair<double,double>>>> string_info(numb_strings);
+		// The values are copied like the header, since the view of the file is not always aligned to 8 bytes
+		vector<double> values;
+		for (uint32_t k = 0; k < numb_strings; ++k)
+		{
+			if (first_cell[k+1] < first_cell[k] || first_cell[k+1] > numb_cells)
+			{
+				throw std::runtime_error(msg);
+			}
+			string_info[k].first = (file.begin[offset_diode + k] != 0);
+			vector<pair<double,double>> &string_cells = string_info[k].second;
+			string_cells.resize(first_cell[k+1] - first_cell[k]);
+			values.resize(2*string_cells.size());
+			memcpy(values.data(), file.begin + offset_cells + 2*first_cell[k]*sizeof(double), values.size()*sizeof(double));
+			for (size_t j = 0; j < string_cells.size(); ++j)
+			{
+				string_cells[j] = make_pair(values[2*j], values[2*j+1]);
+			}
+		}
+		checkInput(string_info);
+
+		if (numb_properties > 0)
+		{
+			double properties[numb_binary_properties];
+			memcpy(properties, file.begin + 24, sizeof(properties));
+			setCellVoltageBreakdown(properties[0]);
+			setCellBreakdownAlpha(properties[1]);
+			setCellSoilingFactor(properties[2]);
+			setCellIdealityFactor(properties[3]);
+			setCellResistanceSeries(properties[4]);
+			setCellResistanceShunt(properties[5]);
+			setCellTemperatureCoeff(properties[6]);
+			setCellVoltageTemperatureCoeff(properties[7]);
+			setCellBreakdownExponent(properties[8]);
+			setVoltageKneeDiode(properties[9]);
+		}
+		return string_info;
+	}
+
+	void SolarPanel :: writeBinary(std::string filepath, bool with_properties)
+	{
+		// Errors are not caught, so they reach the caller
+		ofstream file(filepath, ios::out | ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Unable to open the output file " + filepath + ".");
+		}
+		uint32_t numb_strings = string_info.size();
+		uint32_t flags = with_properties ? 1 : 0;
+		vector<uint64_t> first_cell(numb_strings + 1, 0);
+		for (uint32_t k = 0; k < numb_strings; ++k)
+		{
+			first_cell[k+1] = first_cell[k] + string_info[k].second.size();
+		}
+		uint64_t numb_cells = first_cell[numb_strings];
+		file.write("STRPB001", 8);
+		file.write((const char*)&numb_strings, sizeof(numb_strings));
+		file.write((const char*)&flags, sizeof(flags));
+		file.write((const char*)&numb_cells, sizeof(numb_cells));
+		if (with_properties)
+		{
+			double properties[numb_binary_properties] = {getCellVoltageBreakdown(), getCellBreakdownAlpha(),
+					getCellSoilingFactor(), getCellIdealityFactor(), getCellResistanceSeries(), getCellResistanceShunt(),
+					getCellTemperatureCoeff(), getCellVoltageTemperatureCoeff(), getCellBreakdownExponent(),
+					getVoltageKneeDiode()};
+			file.write((const char*)properties, sizeof(properties));
+		}
+		file.write((const char*)first_cell.data(), first_cell.size()*sizeof(uint64_t));
+		// The diodes are padded so that the cells start aligned to 8 bytes
+		vector<char> diodes(((numb_strings + 7)/8)*8, 0);
+		for (uint32_t k = 0; k < numb_strings; ++k)
+		{
+			diodes[k] = string_info[k].first ? 1 : 0;
+		}
+		file.write(diodes.data(), diodes.size());
+		vector<double> values;
+		for (uint32_t k = 0; k < numb_strings; ++k)
+		{
+			values.resize(2*string_info[k].second.size());
+			for (size_t j = 0; j < string_info[k].second.size(); ++j)
+			{
+				values[2*j] = string_info[k].second[j].first;
+				values[2*j+1] = string_info[k].second[j].second;
+			}
+			file.write((const char*)values.data(), values.size()*sizeof(double));
+		}
+		file.close();
+		if (!file)
+		{
+			throw std::runtime_error("Unable to write the output file " + filepath + ".");
+		}
+	}
+
+	void SolarPanel :: convertInput(std::string input_path, std::string output_path)
+	{
+		// Errors are not caught, so they reach the caller
+		SolarPanel panel;
+		panel.string_info = panel.readInput(input_path);
+		panel.panel_size = panel.string_info.size();
+		panel.writeBinary(output_path, false);
+	}
+
 	int SolarPanel :: getPanelSize()
 	{
 		return panel_size;
 	}
 
+	int SolarPanel :: getStringSize(int k)
+	{
+		return string_info[k].second.size();
+	}
+
+	bool SolarPanel :: getStringDiode(int k)
+	{
+		return string_info[k].first;
+	}
+
+	double SolarPanel :: getCellIrradiance(int k, int j)
+	{
+		return string_info[k].second[j].first;
+	}
+
+	double SolarPanel :: getCellTemperature(int k, int j)
+	{
+		return string_info[k].second[j].second;
+	}
+
+	void SolarPanel :: checkInput(const vector<pair<bool,vector<pair<double,double>>>> &input)
+	{
+		for (size_t k = 0; k < input.size(); ++k)
+		{
+			if (input[k].second.empty())
+			{
+				std::string msg ("Error in the operational data. The string no. ");
+				msg += std::to_string (k);
+				msg += " has no cells.";
+				throw std::runtime_error(msg);
+			}
+		}
+	}
+
 	SolarPanel :: SolarPanel()
 	{
 		panel_size = 0;
@@ -398,7 +749,19 @@ namespace stringarma{
 		// Read the input file and stores the info
 		try
 		{
-			string_info = readInput(filepath);
+			// Binary files are recognized by their first bytes
+			char magic[8] = {0};
+			ifstream file(filepath, ios::in | ios::binary);
+			file.read(magic, 8);
+			file.close();
+			if (memcmp(magic, "STRPB001", 8) == 0)
+			{
+				string_info = readBinary(filepath);
+			}
+			else
+			{
+				string_info = readInput(filepath);
+			}
 		}
 		catch(std::runtime_error& err)
 		{
@@ -413,4 +776,43 @@ namespace stringarma{
 		panel_size = string_info.size();
 	}
 
+	SolarPanel :: SolarPanel(const vector<pair<bool,vector<pair<double,double>>>> &input)
+	{
+		voltage_knee_diode = 0;
+
+		// The info is stored as it is, once checked. Errors are not caught, so they reach the caller
+		checkInput(input);
+		string_info = input;
+
+		panel_size = string_info.size();
+	}
+
+	SolarPanel :: SolarPanel(const vector<bool> &with_diode, const arma::mat &irradiance, const arma::mat &temperature)
+	{
+		voltage_knee_diode = 0;
+
+		// Every row of both matrices is a string. Errors are not caught, so they reach the caller
+		if (irradiance.n_rows != with_diode.size() || temperature.n_rows != irradiance.n_rows
+				|| temperature.n_cols != irradiance.n_cols)
+		{
+			throw std::runtime_error("Error in the operational data. "
+					"The size of the irradiance and temperature matrices does not match the number of strings.");
+		}
+
+		vector<pair<bool,vector<pair<double,double>>>> input(with_diode.size());
+		for (size_t k = 0; k < input.size(); ++k)
+		{
+			input[k].first = with_diode[k];
+			input[k].second.resize(irradiance.n_cols);
+			for (arma::uword j = 0; j < irradiance.n_cols; ++j)
+			{
+				input[k].second[j] = make_pair(irradiance(k,j), temperature(k,j));
+			}
+		}
+		checkInput(input);
+		string_info.swap(input);
+
+		panel_size = string_info.size();
+	}
+
 }
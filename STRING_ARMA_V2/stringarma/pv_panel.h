@@ -25,6 +25,7 @@
 
 #include <iostream>
 #include <vector>
+#include <armadillo>
 #include "pv_string.h"
 
 namespace stringarma{
@@ -72,10 +73,28 @@ public:
 	 * Constructor of the class solar_panel.
 	 *
 	 * @param *filepath Absolute path of the input file with the operational data.
-	 * Its format should follow the one described in [the User's Guide](@ref input_file).
+	 * Its format should follow the one described in [the User's Guide](@ref input_file), or be a binary file written by
+	 * writeBinary (see readBinary).
  	 * @see [Input file format](@ref input_file)
 	 */
 	SolarPanel(std::string);
+	/**
+	 * Constructor of the class solar_panel from the operational data in memory, without an input file.
+	 *
+	 * @param string_info Vector with an element for every string. Every element contains a bool value, the bypass diode of
+	 * the string, and a vector of pairs of double values, the G and Tc of every cell in the string (same as readInput).
+	 * The data is checked (every string must have cells). Errors are not caught, so they reach the caller as exceptions.
+	 */
+	SolarPanel(const std::vector<std::pair<bool,std::vector<std::pair<double,double>>>> &);
+	/**
+	 * Constructor of the class solar_panel from the operational data in memory, for strings with the same number of cells.
+	 *
+	 * @param with_diode Vector with the bypass diode of every string (true if the string has a bypass diode).
+	 * @param irradiance Matrix with the irradiance G of every cell. Every row is a string and every column a position in the strings.
+	 * @param temperature Matrix with the temperature Tc of every cell, with the same size as the irradiance matrix.
+	 * The sizes of the matrices are checked. Errors are not caught, so they reach the caller as exceptions.
+	 */
+	SolarPanel(const std::vector<bool> &, const arma::mat &, const arma::mat &);
 
 	SolarPanel();
 
@@ -185,15 +204,77 @@ public:
 	 * @return Integer with the number of strings in the panel.
 	 */
 	int getPanelSize();
+	/**
+	 * Returns the number of cells in a string of the panel.
+	 * @param k Number of the string.
+	 * @return Integer with the number of cells in the string.
+	 */
+	int getStringSize(int);
+	/**
+	 * Returns whether a string of the panel has a bypass diode.
+	 * @param k Number of the string.
+	 * @return True if the string has a bypass diode.
+	 */
+	bool getStringDiode(int);
+	/**
+	 * Returns the irradiance of a cell of the panel.
+	 * @param k Number of the string.
+	 * @param j Position of the cell in the string.
+	 * @return Irradiance of the cell.
+	 */
+	double getCellIrradiance(int, int);
+	/**
+	 * Returns the temperature of a cell of the panel.
+	 * @param k Number of the string.
+	 * @param j Position of the cell in the string.
+	 * @return Temperature of the cell, as in the operational data.
+	 */
+	double getCellTemperature(int, int);
 
 	/**
 	 * Reads the input file with the operational data described in [the User's Guide](@ref input_file).
 	 *
 	 * Reads the information and generates the panel according to it.
+	 * The file is mapped in memory and parsed in place, without copying its lines, and the strings are built with
+	 * their final size.
 	 * @param filepath String with the absolute path of the input file.
 	 * @returns A vector of pairs. Every element represents a string. Every pair contains a bool value, representing the state of the diode, and a vector of pairs of double values, the G and Tc correspondingly, representing every cell in the string.
 	 */
 	std::vector<std::pair<bool,std::vector<std::pair<double,double>>>> readInput(std::string);
+	/**
+	 * Reads a binary file with the operational data, written by writeBinary.
+	 *
+	 * The file is mapped in memory and copied without any parsing. If the file contains the properties of the cells
+	 * and the knee voltage of the bypass diodes, they are set in this panel.
+	 * @param filepath String with the absolute path of the binary file.
+	 * @returns A vector of pairs, the same as readInput.
+	 */
+	std::vector<std::pair<bool,std::vector<std::pair<double,double>>>> readBinary(std::string);
+	/**
+	 * Writes the operational data of the panel to a binary file, which is read by readBinary or by the constructor.
+	 *
+	 * The file (format STRPB001, in the byte order of the machine) contains a header with the number of strings and
+	 * cells, the properties of the cells if they are included, the first cell of every string, the bypass diode of
+	 * every string and the G and Tc of every cell, aligned to 8 bytes.
+	 * @param filepath String with the absolute path of the binary file.
+	 * @param with_properties True to include the properties of the cells and the knee voltage of the bypass diodes.
+	 * Errors when opening or writing the file are not caught, so they reach the caller as exceptions.
+	 */
+	void writeBinary(std::string, bool = true);
+	/**
+	 * Converts an input file in the text format of readInput to the binary format of writeBinary.
+	 * The binary file does not contain the properties of the cells, since the text format has none.
+	 * @param input_path String with the absolute path of the text input file.
+	 * @param output_path String with the absolute path of the binary file.
+	 * Errors when reading the text file or writing the binary file are not caught, so they reach the caller as exceptions.
+	 */
+	static void convertInput(std::string, std::string);
+	/**
+	 * Checks the operational data of the panel, wherever it comes from.
+	 * Every string must contain at least one cell.
+	 * @param string_info Vector with the bypass diode and the G and Tc of every cell of every string (see readInput).
+	 */
+	void checkInput(const std::vector<std::pair<bool,std::vector<std::pair<double,double>>>> &);
 
 };
 
@@ -0,0 +1,587 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include "pv_plant.h"
+
+using namespace std;
+using namespace arma;
+
+namespace stringarma{
+
+void PanelChain :: addPanel(SolarPanel &panel)
+{
+	panels.push_back(&panel);
+}
+
+int PanelChain :: getNumberPanels(void)
+{
+	return(panels.size());
+}
+
+SolarPanel& PanelChain :: getPanel(int k)
+{
+	return(*panels.at(k));
+}
+
+void ParallelCombiner :: addChain(const PanelChain &chain)
+{
+	chains.push_back(chain);
+}
+
+void ParallelCombiner :: addCombiner(const ParallelCombiner &combiner)
+{
+	chains.insert(chains.end(), combiner.chains.begin(), combiner.chains.end());
+}
+
+int ParallelCombiner :: getNumberChains(void)
+{
+	return(chains.size());
+}
+
+PanelChain& ParallelCombiner :: getChain(int k)
+{
+	return(chains.at(k));
+}
+
+InverterInput :: InverterInput(void)
+{
+	minimum_voltage = 0.0;
+	maximum_voltage = 0.0;
+}
+
+void InverterInput :: setVoltageWindow(double _minimum_voltage, double _maximum_voltage)
+{
+	try
+	{
+		if (_minimum_voltage < 0 || (_maximum_voltage != 0 && _maximum_voltage < _minimum_voltage))
+		{
+			throw std::runtime_error("Wrong voltage window of the inverter.");
+		}
+		minimum_voltage = _minimum_voltage;
+		maximum_voltage = _maximum_voltage;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the voltage window of the inverter." << endl;
+	}
+}
+
+double InverterInput :: getMinimumVoltage(void)
+{
+	return(minimum_voltage);
+}
+
+double InverterInput :: getMaximumVoltage(void)
+{
+	return(maximum_voltage);
+}
+
+void SolarPlant :: addInverter(const InverterInput &inverter)
+{
+	inverters.push_back(inverter);
+}
+
+int SolarPlant :: getNumberInverters(void)
+{
+	return(inverters.size());
+}
+
+InverterInput& SolarPlant :: getInverter(int k)
+{
+	return(inverters.at(k));
+}
+
+PlantSolver :: PlantSolver(SolarPlant &_plant) : plant(_plant)
+{
+	number_threads = NUMBER_THREADS_REF;
+	number_current_points = PLANT_CURRENT_POINTS_REF;
+	solved = false;
+}
+
+void PlantSolver :: setNumberThreads(int _number_threads)
+{
+	try
+	{
+		if (_number_threads < 1)
+		{
+			throw std::runtime_error("The number of threads must be at least 1.");
+		}
+		number_threads = _number_threads;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the number of threads." << endl;
+	}
+}
+
+void PlantSolver :: setCurrentPoints(int numb_points)
+{
+	try
+	{
+		if (numb_points < 2)
+		{
+			throw std::runtime_error("The grid of currents needs at least two points.");
+		}
+		number_current_points = numb_points;
+		solved = false;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the points of the grid of currents." << endl;
+	}
+}
+
+void PlantSolver :: findPanelKey(SolarPanel &panel, vector<double> &key)
+{
+	key.clear();
+	key.push_back(panel.getCellVoltageBreakdown());
+	key.push_back(panel.getCellBreakdownAlpha());
+	key.push_back(panel.getCellSoilingFactor());
+	key.push_back(panel.getCellIdealityFactor());
+	key.push_back(panel.getCellResistanceSeries());
+	key.push_back(panel.getCellResistanceShunt());
+	key.push_back(panel.getCellTemperatureCoeff());
+	key.push_back(panel.getCellVoltageTemperatureCoeff());
+	key.push_back(panel.getCellBreakdownExponent());
+	key.push_back(panel.getVoltageKneeDiode());
+	for (int s = 0; s < panel.getPanelSize(); ++s)
+	{
+		key.push_back(panel.getStringDiode(s));
+		key.push_back(panel.getStringSize(s));
+		for (int c = 0; c < panel.getStringSize(s); ++c)
+		{
+			key.push_back(panel.getCellIrradiance(s, c));
+			key.push_back(panel.getCellTemperature(s, c));
+		}
+	}
+}
+
+void PlantSolver :: solve(void)
+{
+	try
+	{
+		solved = false;
+		panels.clear();
+		chain_panels.clear();
+		inverter_chains.assign(plant.getNumberInverters(), vector<int>());
+
+		// Every different panel and every different chain is found once
+		map <vector<double>, int> panel_keys;
+		map <vector<int>, int> chain_keys;
+		vector <double> key;
+		for (int i = 0; i < plant.getNumberInverters(); ++i)
+		{
+			InverterInput &inverter = plant.getInverter(i);
+			for (int c = 0; c < inverter.getNumberChains(); ++c)
+			{
+				PanelChain &chain = inverter.getChain(c);
+				vector <int> members;
+				for (int p = 0; p < chain.getNumberPanels(); ++p)
+				{
+					findPanelKey(chain.getPanel(p), key);
+					map<vector<double>, int>::iterator it = panel_keys.find(key);
+					if (it == panel_keys.end())
+					{
+						it = panel_keys.insert(make_pair(key, (int)panels.size())).first;
+						panels.push_back(&chain.getPanel(p));
+					}
+					members.push_back(it->second);
+				}
+				// The order of the panels in series does not change the characteristic of the chain
+				sort(members.begin(), members.end());
+				map<vector<int>, int>::iterator itC = chain_keys.find(members);
+				if (itC == chain_keys.end())
+				{
+					itC = chain_keys.insert(make_pair(members, (int)chain_panels.size())).first;
+					chain_panels.push_back(members);
+				}
+				inverter_chains[i].push_back(itC->second);
+			}
+		}
+
+		int numb_panels = panels.size();
+		list <SolarSolver> solvers;
+		vector <SolarSolver*> panel_solvers;
+		for (int p = 0; p < numb_panels; ++p)
+		{
+			solvers.emplace_back(*panels[p]);
+			panel_solvers.push_back(&solvers.back());
+		}
+
+		// Grid of currents: uniform between minus and plus the greatest shortcut current, where every panel is from
+		// reverse to bypassed, plus the knee of every zone of every panel
+		vector <double> knees;
+		double Imax = 0.0;
+		for (int p = 0; p < numb_panels; ++p)
+		{
+			vector <double> Isc = panel_solvers[p]->getShortcutCurrents();
+			for (size_t k = 0; k < Isc.size(); ++k)
+			{
+				Imax = max(Imax, Isc[k]);
+				knees.push_back(Isc[k]);
+			}
+		}
+		Imax = Imax > 0 ? 1.05*Imax : 1.0;
+		double step = 2*Imax/(number_current_points - 1);
+		vector <double> new_currents;
+		for (int k = 0; k < number_current_points; ++k)
+		{
+			new_currents.push_back(-Imax + step*k);
+		}
+		new_currents.push_back(0.0);
+		for (size_t k = 0; k < knees.size(); ++k)
+		{
+			new_currents.push_back(knees[k] - 0.01*step);
+			new_currents.push_back(knees[k]);
+			new_currents.push_back(knees[k] + 0.01*step);
+		}
+
+		// The grid is refined where the characteristic of a chain with positive voltage is not linear between its points
+		map <double, vec> table;
+		int numb_chains = chain_panels.size();
+		while (!new_currents.empty())
+		{
+			sort(new_currents.begin(), new_currents.end());
+			new_currents.erase(unique(new_currents.begin(), new_currents.end()), new_currents.end());
+			mat panel_voltages;
+			calcPanelVoltages(panel_solvers, new_currents, panel_voltages);
+			for (size_t k = 0; k < new_currents.size(); ++k)
+			{
+				table[new_currents[k]] = panel_voltages.row(k).t();
+			}
+			buildChainTables(table);
+			new_currents.clear();
+			if (table.size() >= PLANT_MAX_POINTS_REF)
+			{
+				break;
+			}
+
+			int numb_rows = table.size();
+			const vector <double> &I = currents;
+			vector <bool> split(numb_rows, false);
+			for (int c = 0; c < numb_chains; ++c)
+			{
+				for (int k = 1; k + 1 < numb_rows; ++k)
+				{
+					// The voltage decreases with the current
+					double V0 = chain_voltages(k-1,c), V1 = chain_voltages(k,c), V2 = chain_voltages(k+1,c);
+					if (V0 < 0 || !(V0 > V2)) continue;
+					double Iline = I[k-1] + (I[k+1] - I[k-1])*(V1 - V0)/(V2 - V0);
+					if (fabs(I[k] - Iline) > COMPOSITION_TOLERANCE_REF)
+					{
+						split[k-1] = true;
+						split[k] = true;
+					}
+				}
+			}
+			for (int k = 0; k + 1 < numb_rows && numb_rows + new_currents.size() < PLANT_MAX_POINTS_REF; ++k)
+			{
+				double Imid = 0.5*(I[k] + I[k+1]);
+				if (split[k] && Imid > I[k] && Imid < I[k+1])
+				{
+					new_currents.push_back(Imid);
+				}
+			}
+		}
+		solved = true;
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when solving the plant: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when solving the plant." << endl;
+	}
+}
+
+void PlantSolver :: calcPanelVoltages(vector<SolarSolver*> &solvers, const vector<double> &_currents, mat &voltages)
+{
+	// Every different panel is solved for every current (in parallel if more than one thread is used)
+	int numb_panels = solvers.size();
+	voltages.set_size(_currents.size(), numb_panels);
+	int numb_parts = number_threads < numb_panels ? number_threads : numb_panels;
+	vector <std::thread> threads;
+	vector <std::exception_ptr> errors(numb_parts);
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		int first = (long)numb_panels*t/numb_parts;
+		int last = (long)numb_panels*(t+1)/numb_parts;
+		auto solvePanels = [&solvers, &_currents, &voltages, &errors, t, first, last]()
+		{
+			try
+			{
+				for (int p = first; p < last; ++p)
+				{
+					voltages.col(p) = solvers[p]->calcCharacteristicForCurrents(_currents).col(0);
+				}
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+			}
+		};
+		if (numb_parts == 1){
+			solvePanels();
+		}
+		else{
+			threads.push_back(std::thread(solvePanels));
+		}
+	}
+	for (size_t t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		if (errors[t]){
+			std::rethrow_exception(errors[t]);
+		}
+	}
+}
+
+void PlantSolver :: buildChainTables(const map<double, vec> &table)
+{
+	// The voltage of every chain is the sum of the voltages of its panels
+	int numb_chains = chain_panels.size();
+	currents.clear();
+	chain_voltages.zeros(table.size(), numb_chains);
+	for (map<double,vec>::const_iterator it = table.begin(); it != table.end(); ++it)
+	{
+		for (int c = 0; c < numb_chains; ++c)
+		{
+			for (size_t p = 0; p < chain_panels[c].size(); ++p)
+			{
+				chain_voltages(currents.size(), c) += it->second[chain_panels[c][p]];
+			}
+		}
+		currents.push_back(it->first);
+	}
+
+	table_voltages.assign(numb_chains, vec());
+	table_currents.assign(numb_chains, vec());
+	for (int c = 0; c < numb_chains; ++c)
+	{
+		// Sorted by increasing voltage. Points that are not decreasing in voltage (numerical noise) are skipped
+		vector <double> V;
+		vector <double> I;
+		for (int k = currents.size() - 1; k >= 0; --k)
+		{
+			if (V.empty() || chain_voltages(k,c) > V.back())
+			{
+				V.push_back(chain_voltages(k,c));
+				I.push_back(currents[k]);
+			}
+		}
+		table_voltages[c] = vec(V);
+		table_currents[c] = vec(I);
+	}
+}
+
+int PlantSolver :: getNumberDifferentPanels(void)
+{
+	return(panels.size());
+}
+
+double PlantSolver :: calcChainCurrent(int chain, double Vchain)
+{
+	const vec &V = table_voltages[chain];
+	const vec &I = table_currents[chain];
+	if (V.n_elem == 0 || !(Vchain >= V[0] && Vchain <= V[V.n_elem-1]))
+	{
+		return(NAN);
+	}
+	uword k = upper_bound(V.begin(), V.end(), Vchain) - V.begin();
+	if (k >= V.n_elem)
+	{
+		return(I[V.n_elem-1]);
+	}
+	return(I[k-1] + (I[k] - I[k-1])*(Vchain - V[k-1])/(V[k] - V[k-1]));
+}
+
+double PlantSolver :: calcInverterCurrent(int inverter, double Vinv)
+{
+	double Iinv = 0.0;
+	for (size_t c = 0; c < inverter_chains[inverter].size(); ++c)
+	{
+		Iinv += calcChainCurrent(inverter_chains[inverter][c], Vinv);
+	}
+	return(Iinv);
+}
+
+mat PlantSolver :: calcIVcharacteristic(int inverter, const vector<double> &voltages)
+{
+	if (!solved)
+	{
+		solve();
+	}
+	if (inverter < 0 || inverter >= (int)inverter_chains.size())
+	{
+		throw std::runtime_error("The inverter does not exist in the plant.");
+	}
+	mat curve(voltages.size(), 2);
+	for (size_t k = 0; k < voltages.size(); ++k)
+	{
+		curve(k,0) = voltages[k];
+		curve(k,1) = calcInverterCurrent(inverter, voltages[k]);
+	}
+	return(curve);
+}
+
+InverterPoint PlantSolver :: calcWorkingPoint(int inverter, double Vinv)
+{
+	if (!solved)
+	{
+		solve();
+	}
+	if (inverter < 0 || inverter >= (int)inverter_chains.size())
+	{
+		throw std::runtime_error("The inverter does not exist in the plant.");
+	}
+	InverterPoint point;
+	point.voltage = Vinv;
+	point.current = 0.0;
+	for (size_t c = 0; c < inverter_chains[inverter].size(); ++c)
+	{
+		point.chain_currents.push_back(calcChainCurrent(inverter_chains[inverter][c], Vinv));
+		point.current += point.chain_currents.back();
+	}
+	point.power = Vinv*point.current;
+	return(point);
+}
+
+InverterPoint PlantSolver :: findMaximumPowerPoint(int inverter)
+{
+	InverterPoint mpp;
+	mpp.voltage = 0.0;
+	mpp.current = 0.0;
+	mpp.power = 0.0;
+	try
+	{
+		if (!solved)
+		{
+			solve();
+		}
+		if (inverter < 0 || inverter >= (int)inverter_chains.size())
+		{
+			throw std::runtime_error("The inverter does not exist in the plant.");
+		}
+
+		// Voltage window: from the minimum of the tracker to the highest open circuit voltage of the chains (or the
+		// maximum of the tracker). Beyond it every chain would absorb current.
+		InverterInput &input = plant.getInverter(inverter);
+		int zero = lower_bound(currents.begin(), currents.end(), 0.0) - currents.begin();
+		double lower = input.getMinimumVoltage();
+		double upper = 0.0;
+		for (size_t c = 0; c < inverter_chains[inverter].size(); ++c)
+		{
+			upper = max(upper, chain_voltages(zero, inverter_chains[inverter][c]));
+		}
+		if (input.getMaximumVoltage() > 0 && input.getMaximumVoltage() < upper)
+		{
+			upper = input.getMaximumVoltage();
+		}
+		if (upper <= lower)
+		{
+			return(mpp);
+		}
+
+		// Sampling of the window
+		double step = (upper - lower)/(PLANT_MPP_POINTS_REF - 1);
+		double Vbest = lower;
+		double Pbest = -1.0;
+		for (int k = 0; k < PLANT_MPP_POINTS_REF; ++k)
+		{
+			double V = lower + step*k;
+			double P = V*calcInverterCurrent(inverter, V);
+			if (P > Pbest)
+			{
+				Pbest = P;
+				Vbest = V;
+			}
+		}
+
+		// Golden section search around the best sample
+		double a = max(lower, Vbest - step);
+		double b = min(upper, Vbest + step);
+		const double ratio = 0.5*(sqrt(5.0) - 1.0);
+		double x1 = b - ratio*(b - a);
+		double x2 = a + ratio*(b - a);
+		double P1 = x1*calcInverterCurrent(inverter, x1);
+		double P2 = x2*calcInverterCurrent(inverter, x2);
+		while (b - a > PLANT_MPP_VOLTAGE_TOLERANCE_REF)
+		{
+			if (P1 > P2)
+			{
+				b = x2;
+				x2 = x1;
+				P2 = P1;
+				x1 = b - ratio*(b - a);
+				P1 = x1*calcInverterCurrent(inverter, x1);
+			}
+			else
+			{
+				a = x1;
+				x1 = x2;
+				P1 = P2;
+				x2 = a + ratio*(b - a);
+				P2 = x2*calcInverterCurrent(inverter, x2);
+			}
+		}
+		double V = P1 > P2 ? x1 : x2;
+		if (max(P1, P2) < Pbest)
+		{
+			V = Vbest;
+		}
+		mpp = calcWorkingPoint(inverter, V);
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when finding the maximum power point of the inverter: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when finding the maximum power point of the inverter." << endl;
+	}
+	return(mpp);
+}
+
+double PlantSolver :: calcTotalPower(void)
+{
+	double power = 0.0;
+	for (int i = 0; i < plant.getNumberInverters(); ++i)
+	{
+		power += findMaximumPowerPoint(i).power;
+	}
+	return(power);
+}
+
+}
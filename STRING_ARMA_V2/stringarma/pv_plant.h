@@ -0,0 +1,305 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <armadillo>
+#include "pv_solver.h"
+
+namespace stringarma{
+
+#define PLANT_CURRENT_POINTS_REF 1024
+#define PLANT_MAX_POINTS_REF 16384
+#define PLANT_MPP_POINTS_REF 256
+#define PLANT_MPP_VOLTAGE_TOLERANCE_REF 0.001
+
+/**
+ * Panels connected in series. They share the current and their voltages are added.
+ * The panels are not copied, so they must exist while the chain is in use.
+ */
+class PanelChain
+{
+private:
+	/// Panels of the chain, in order.
+	std::vector<SolarPanel*> panels;
+
+public:
+	/**
+	 * Adds a panel at the end of the chain.
+	 * @param panel SolarPanel object to add.
+	 */
+	void addPanel(SolarPanel &);
+	/**
+	 * Returns the number of panels in the chain.
+	 * @returns The number of panels.
+	 */
+	int getNumberPanels(void);
+	/**
+	 * Returns a panel of the chain.
+	 * @param k Position of the panel in the chain.
+	 * @returns The SolarPanel object.
+	 */
+	SolarPanel& getPanel(int);
+};
+
+/**
+ * Chains of panels connected in parallel, as in a combiner box. They share the voltage and their currents are added.
+ */
+class ParallelCombiner
+{
+private:
+	/// Chains of the combiner, in order.
+	std::vector<PanelChain> chains;
+
+public:
+	/**
+	 * Adds a chain of panels to the combiner.
+	 * @param chain PanelChain object to add.
+	 */
+	void addChain(const PanelChain &);
+	/**
+	 * Adds every chain of another combiner, connected in parallel to this one.
+	 * @param combiner ParallelCombiner object to add.
+	 */
+	void addCombiner(const ParallelCombiner &);
+	/**
+	 * Returns the number of chains in the combiner.
+	 * @returns The number of chains.
+	 */
+	int getNumberChains(void);
+	/**
+	 * Returns a chain of the combiner.
+	 * @param k Position of the chain in the combiner.
+	 * @returns The PanelChain object.
+	 */
+	PanelChain& getChain(int);
+};
+
+/**
+ * Input of an inverter: the chains of panels connected to it in parallel, and the voltage window of its tracker of
+ * maximum power point.
+ */
+class InverterInput : public ParallelCombiner
+{
+private:
+	/// Minimum voltage of the tracker [V].
+	double minimum_voltage;
+	/// Maximum voltage of the tracker [V]. With 0 there is no maximum.
+	double maximum_voltage;
+
+public:
+	/**
+	 * Constructor of the class InverterInput. By default the voltage window has no limits.
+	 */
+	InverterInput(void);
+	/**
+	 * Sets the voltage window of the tracker of maximum power point.
+	 * @param minimum_voltage Minimum voltage [V].
+	 * @param maximum_voltage Maximum voltage [V]. With 0 there is no maximum.
+	 */
+	void setVoltageWindow(double, double);
+	/**
+	 * Returns the minimum voltage of the tracker.
+	 * @returns The minimum voltage [V].
+	 */
+	double getMinimumVoltage(void);
+	/**
+	 * Returns the maximum voltage of the tracker.
+	 * @returns The maximum voltage [V], or 0 if there is no maximum.
+	 */
+	double getMaximumVoltage(void);
+};
+
+/**
+ * Photovoltaic plant: a list of inverters, every one with its chains of panels.
+ */
+class SolarPlant
+{
+private:
+	/// Inputs of the inverters of the plant.
+	std::vector<InverterInput> inverters;
+
+public:
+	/**
+	 * Adds an inverter to the plant.
+	 * @param inverter InverterInput object with the chains of the inverter.
+	 */
+	void addInverter(const InverterInput &);
+	/**
+	 * Returns the number of inverters in the plant.
+	 * @returns The number of inverters.
+	 */
+	int getNumberInverters(void);
+	/**
+	 * Returns an inverter of the plant.
+	 * @param k Number of the inverter.
+	 * @returns The InverterInput object.
+	 */
+	InverterInput& getInverter(int);
+};
+
+/**
+ * Working point of an inverter input.
+ */
+struct InverterPoint {
+	/// Voltage of the input [V].
+	double voltage;
+	/// Current through the input [A].
+	double current;
+	/// Power of the input [W].
+	double power;
+	/// Current through every chain of the input, in the order of the inverter [A].
+	std::vector<double> chain_currents;
+};
+
+/**
+ * Solves the inverters of a SolarPlant by composing the characteristics of its panels.
+ *
+ * Panels with the same properties, bypass diodes and conditions of their cells are solved only once. The voltage of
+ * every different panel is found for a common grid of currents (see SolarSolver::calcCharacteristicForCurrents), in
+ * parallel. The voltage of a chain is the sum of the voltages of its panels for every current of the grid, and the
+ * current of an inverter for a voltage is the sum of the currents of its chains, interpolated in the table of every chain.
+ * Chains with the same panels, in any order, share their table. The grid is refined where the characteristic of a
+ * chain is not linear (see COMPOSITION_TOLERANCE_REF).
+ */
+class PlantSolver
+{
+protected:
+	/// Plant to solve. Its panels must not change until it is solved again.
+	SolarPlant &plant;
+	/// Number of threads used to solve the panels.
+	int number_threads;
+	/// Number of points of the uniform part of the grid of currents.
+	int number_current_points;
+	/// Different panels of the plant.
+	std::vector<SolarPanel*> panels;
+	/// Different panels of every different chain, sorted.
+	std::vector<std::vector<int>> chain_panels;
+	/// Different chain of every chain of every inverter, in the order of the inverter.
+	std::vector<std::vector<int>> inverter_chains;
+	/// Grid of currents, sorted in increasing order [A].
+	std::vector<double> currents;
+	/// Voltage of every different chain for every current of the grid (a column for every chain) [V].
+	arma::mat chain_voltages;
+	/// Voltage of every different chain sorted in increasing order, without repetitions [V].
+	std::vector<arma::vec> table_voltages;
+	/// Current of every different chain for the voltages of table_voltages [A].
+	std::vector<arma::vec> table_currents;
+	/// True once the plant has been solved.
+	bool solved;
+
+public:
+	/**
+	 * Constructor of the class PlantSolver.
+	 * @param plant SolarPlant object with the plant to solve. It must exist while the solver is in use.
+	 */
+	PlantSolver(SolarPlant &);
+	/**
+	 * Sets the number of threads used to solve the different panels of the plant.
+	 * @param Integer value with the number of threads.
+	 */
+	void setNumberThreads(int);
+	/**
+	 * Sets the number of points of the uniform part of the grid of currents, between minus and plus the greatest
+	 * shortcut current of the panels. The knees of every panel are always added, and the grid is refined up to
+	 * PLANT_MAX_POINTS_REF points.
+	 * @param numb_points Number of points.
+	 */
+	void setCurrentPoints(int);
+	/**
+	 * Solves every different panel and builds the table of every chain. It must be called again when the plant changes.
+	 */
+	void solve(void);
+	/**
+	 * Returns the number of different panels in the plant, which are the panels actually solved.
+	 * @returns The number of different panels.
+	 */
+	int getNumberDifferentPanels(void);
+	/**
+	 * Calculates the I-V characteristic of an inverter input.
+	 * The voltages beyond the table of a chain (see setCurrentPoints) have a NAN current.
+	 * @param inverter Number of the inverter.
+	 * @param voltages Vector with the voltage of every point.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcIVcharacteristic(int, const std::vector<double> &);
+	/**
+	 * Calculates the working point of an inverter input for a given voltage.
+	 * @param inverter Number of the inverter.
+	 * @param Vinv Voltage of the input [V].
+	 * @returns An InverterPoint struct with the current of the input and of every chain.
+	 */
+	InverterPoint calcWorkingPoint(int, double);
+	/**
+	 * Finds the global maximum power point of an inverter input inside the voltage window of its tracker.
+	 * The power is sampled at PLANT_MPP_POINTS_REF voltages, and the best one is refined with a golden section search.
+	 * @param inverter Number of the inverter.
+	 * @returns An InverterPoint struct with the maximum power point.
+	 */
+	InverterPoint findMaximumPowerPoint(int);
+	/**
+	 * Returns the total power of the plant, with every inverter at its maximum power point.
+	 * @returns The power of the plant [W].
+	 */
+	double calcTotalPower(void);
+
+protected:
+	/**
+	 * Calculates the current of a different chain for a given voltage, interpolated in its table.
+	 * @param chain Number of the different chain.
+	 * @param Vchain Voltage of the chain [V].
+	 * @returns The current of the chain [A], or NAN beyond its table.
+	 */
+	double calcChainCurrent(int chain, double Vchain);
+	/**
+	 * Calculates the current of an inverter input for a given voltage.
+	 * @param inverter Number of the inverter.
+	 * @param Vinv Voltage of the input [V].
+	 * @returns The current of the input [A].
+	 */
+	double calcInverterCurrent(int inverter, double Vinv);
+	/**
+	 * Finds the fingerprint of a panel: the properties of its cells and diodes, and the bypass diode and the conditions
+	 * of the cells of every string.
+	 * @param panel SolarPanel object.
+	 * @param key Vector where the fingerprint is stored.
+	 */
+	void findPanelKey(SolarPanel &panel, std::vector<double> &key);
+	/**
+	 * Calculates the voltage of every different panel for some currents.
+	 * The panels are solved in parallel if more than one thread is used.
+	 * @param solvers SolarSolver object of every different panel.
+	 * @param currents Currents through the panels, sorted in increasing order.
+	 * @param voltages Matrix where the voltages are stored, with a row for every current and a column for every panel.
+	 */
+	void calcPanelVoltages(std::vector<SolarSolver*> &solvers, const std::vector<double> &currents, arma::mat &voltages);
+	/**
+	 * Builds the grid of currents, the voltage of every different chain and its table sorted by voltage.
+	 * @param table Map with the voltage of every different panel for every current.
+	 */
+	void buildChainTables(const std::map<double, arma::vec> &table);
+};
+
+}
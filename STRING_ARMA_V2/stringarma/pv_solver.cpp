@@ -48,6 +48,11 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <cmath>
+#include <cfloat>
+#include <thread>
+#include <exception>
+#include <algorithm>
 #include "pv_solver.h"
 #include <armadillo>
 
@@ -56,28 +61,97 @@ using namespace arma;
 
 namespace stringarma{
 
-bool equalIsc (const SameIshortcutGroup &iVC1, const SameIshortcutGroup &iVC2 )
-{
-	return iVC1.sum_same_i_shortcut_group.current_shortcut == iVC2.sum_same_i_shortcut_group.current_shortcut;
-}
-
-Col<double> loadInitialValues(solar_string *st, int n, int nS)
+/*
+ * Derivatives stored in the sparse jacobian matrix
+ */
+enum SparseTermType {
+	// Derivative of the function of a cell respect its voltage
+	TERM_CELL_VOLTAGE,
+	// Derivative of the function of the last cell respect the voltage of any other cell
+	TERM_LAST_CELL_VOLTAGE,
+	// Derivative of the function of a cell respect the current of its string
+	TERM_CELL_CURRENT,
+	// Derivative of the function of a string respect the voltage of its cells
+	TERM_DIODE_VOLTAGE,
+	// Derivative of the function of the last string respect the voltage of the cells of other strings
+	TERM_LAST_DIODE_VOLTAGE,
+	// Derivative of the function of a string respect the total current
+	TERM_TOTAL_CURRENT,
+	// Derivative of the function of a string respect its current
+	TERM_STRING_CURRENT
+};
+
+void loadInitialValues(solar_string *st, int nS, double *Z)
 {
-	// Fills the column with the voltage of the cells, the total current and the currents in every string
-	Col<double> Z = zeros(n);
+	// Fills the column with the voltage of the (representative) cells, the total current and the currents in every string
 	int relatiu = 0;
 	for (int i=0; i<nS; i++){
-		for (int j=0; j<st[i].string_size; j++){
-			Z(relatiu+j) = st[i].cells_array[j].getVoltageCell();
+		for (size_t j=0; j<st[i].equivalent_cells_index.size(); j++){
+			Z[relatiu+j] = st[i].cells_array[st[i].equivalent_cells_index[j]].getVoltageCell();
 			}
-			relatiu += st[i].string_size;
+			relatiu += st[i].equivalent_cells_index.size();
 		}
-	Z(relatiu) = st[0].cells_array[0].getCurrentCell() + st[0].diode_bypass.getCurrentDiode();
+	Z[relatiu] = st[0].cells_array[0].getCurrentCell() + st[0].diode_bypass.getCurrentDiode();
 	relatiu += 1;
 	for (int i=0; i<nS; i++){
-		Z(relatiu+i) = st[i].cells_array[0].getCurrentCell();
+		Z[relatiu+i] = st[i].cells_array[0].getCurrentCell();
+		}
+}
+
+/*
+ * Samples the characteristic of a cell from its junction voltage, where the current is explicit, and stores it as
+ * pairs of current and voltage sorted by increasing current. The samples are uniform in the junction voltage and in the
+ * current of the diode in forward bias, dense near 0 V in reverse bias and geometric towards the breakdown voltage.
+ */
+void sampleCellCharacteristic(SolarCell &cell, double Imax, vector<pair<double,double>> &table)
+{
+	double Vt = cell.getIdealityFactor()*BOLTZMANN_CONST*cell.getTemperatureCell()/ELECTRONS_CHARGE;
+	double Iph = cell.getCurrentPhotogenerated();
+	double I0 = cell.getCurrentReverseSaturation();
+	double Rs = cell.getResistanceSeries();
+	double Rsh = cell.getResistanceShunt();
+	double Vbr = cell.getVoltageBreakdown();
+	double alpha = cell.getBreakdownAlpha();
+	double m = cell.getBreakdownExponent();
+	int N = APPROXIMATION_CELL_POINTS_REF;
+
+	table.clear();
+	auto addPoint = [&](double Vj)
+	{
+		double I = Iph - I0*(exp(Vj/Vt) - 1) - Vj*(1 + alpha*pow(1 - Vj/Vbr, -m))/Rsh;
+		table.push_back(make_pair(I, Vj - I*Rs));
+	};
+	double Vtop = Vt*log((Iph + Imax)/I0 + 1);
+	for (int k = 0; k <= N; ++k)
+	{
+		addPoint(Vtop*k/N);
+		addPoint(Vt*log((Iph + Imax)*k/(N*I0) + 1));
+		addPoint(-APPROXIMATION_REVERSE_VOLTAGE_REF*k/N);
+		addPoint(Vbr*(1 - pow(APPROXIMATION_BREAKDOWN_MARGIN_REF, (double)k/N)));
+	}
+	sort(table.begin(), table.end());
+	table.erase(unique(table.begin(), table.end(), [](const pair<double,double> &a, const pair<double,double> &b){ return a.first == b.first; }), table.end());
+}
+
+/*
+ * Adds the values of a table sorted by increasing abscissa, linearly interpolated (or extrapolated from the segments
+ * at both ends) and multiplied by a weight, for the given abscissae, also sorted.
+ */
+void addInterpolatedValues(const vector<pair<double,double>> &table, double weight, const vector<double> &x, vector<double> &y)
+{
+	size_t j = 0;
+	for (size_t k = 0; k < x.size(); ++k)
+	{
+		while (j + 2 < table.size() && table[j+1].first < x[k]) ++j;
+		const pair<double,double> &p0 = table[j];
+		const pair<double,double> &p1 = table[j + 1 < table.size() ? j + 1 : j];
+		double value = p0.second;
+		if (p1.first > p0.first)
+		{
+			value += (p1.second - p0.second)*(x[k] - p0.first)/(p1.first - p0.first);
 		}
-	return Z;
+		y[k] += weight*value;
+	}
 }
 
 void SolarSolver :: setMaxIterations(int maxIt)
@@ -104,6 +178,63 @@ void SolarSolver :: setEpsilon(double _epsilon)
 	}
 }
 
+void SolarSolver :: setLinearSolver(LinearSolverType _linear_solver)
+{
+	try
+	{
+		linear_solver = _linear_solver;
+		initWorkspace(workspace);
+		// The state of the workspace is lost
+		last_solved = false;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the linear solver." << endl;
+	}
+}
+
+void SolarSolver :: setSolveMethod(SolveMethodType _solve_method)
+{
+	try
+	{
+		solve_method = _solve_method;
+		// Each method keeps its state in different vectors of the workspace
+		last_solved = false;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the solve method." << endl;
+	}
+}
+
+void SolarSolver :: setContinuation(ContinuationType _continuation)
+{
+	try
+	{
+		continuation = _continuation;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the continuation." << endl;
+	}
+}
+
+void SolarSolver :: setNumberThreads(int _number_threads)
+{
+	try
+	{
+		if (_number_threads < 1)
+		{
+			throw std::runtime_error("The number of threads must be at least 1.");
+		}
+		number_threads = _number_threads;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the number of threads." << endl;
+	}
+}
+
 int SolarSolver :: getMaxIterations(void)
 {
 	return(max_iterations);
@@ -114,58 +245,58 @@ double SolarSolver :: getEpsilon(void)
 	return(epsilon);
 }
 
+LinearSolverType SolarSolver :: getLinearSolver(void)
+{
+	return(linear_solver);
+}
+
+SolveMethodType SolarSolver :: getSolveMethod(void)
+{
+	return(solve_method);
+}
+
+ContinuationType SolarSolver :: getContinuation(void)
+{
+	return(continuation);
+}
+
+int SolarSolver :: getNumberThreads(void)
+{
+	return(number_threads);
+}
+
+/*
+ * Order of the groups of cells in panel_details: by Isc, then by Vbrx and then by number of string and of group.
+ */
+struct PanelOrderComp
+{
+	const vector<vector<pair<pair<double,double>,CellsGroup>>> &string_groups;
+
+	PanelOrderComp(const vector<vector<pair<pair<double,double>,CellsGroup>>> &_string_groups) : string_groups(_string_groups) {}
+
+	bool operator()(const pair<int,int> &o1, const pair<int,int> &o2) const
+	{
+		const pair<double,double> &k1 = string_groups[o1.first][o1.second].first;
+		const pair<double,double> &k2 = string_groups[o2.first][o2.second].first;
+		if (k1.first < k2.first) return true;
+		if (k2.first < k1.first) return false;
+		if (k1.second < k2.second) return true;
+		if (k2.second < k1.second) return false;
+		return (o1 < o2);
+	}
+};
+
 void SolarSolver::generatePanelVector (){
-	multimap <pair<double,double>, SameIshortcutAndVbreakdownGroup, Classcomp> MMPanel;
-	SameIshortcutGroup iVC;
+	// The vectors are built again when the cells change, reusing their memory
+	panel_vector.clear();
+	panel_groups.clear();
+	panel_details.clear();
 	/*
-	 * Fills the MMPanel multimap with the info in the solar_string objects in panel and orders it
-	 * by groups of cells with the same breakdown current and voltage
+	 * Sorts the groups of cells of every string by breakdown current and voltage, so that the groups with the same
+	 * Isc and Vbrx are consecutive
 	 */
-	retrieveDataFromStringArray(MMPanel);
-	// Iterates the multimap to update the Isc and initialize the rest of the values.
-	// Every group is a new entry in the vector of inVectorCell
-	for (multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator
-			itmap = MMPanel.begin(); itmap != MMPanel.end(); ++itmap)
-	{
-		iVC.sum_same_i_shortcut_group.current_shortcut = itmap->first.first;
-		iVC.sum_same_i_shortcut_group.group_size = 0;
-		iVC.sum_same_i_shortcut_group.sum_voltage_breakdown_in_group = 0;
-		iVC.sum_same_i_shortcut_group.sum_voltage_open_circuit_all_cells = 0;
-		iVC.sum_same_i_shortcut_group.sum_voltage_open_circuit_non_active_cells = 0;
-		panel_vector.push_back(iVC);
-	}
-	vector <SameIshortcutGroup>::iterator it;
-	// If there is any group with the same Isc, all but the first one are removed
-	it = unique(panel_vector.begin(),panel_vector.end(), equalIsc);
-	panel_vector.resize(distance(panel_vector.begin(),it));
-	// The information in the multimap object is migrated to the panel_vector
-	multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator itmap = MMPanel.begin();
-	for (int k=0; k<panel_vector.size(); ++k){
-		// Fulfills the inVectorDetail structs with a pair composed by a double type with the Vbrx of the group
-		// and the corresponding inMapCell struct
-		while(itmap->first.first == panel_vector[k].sum_same_i_shortcut_group.current_shortcut){
-			panel_vector[k].detailed_same_i_shortcut_group.insert(make_pair(itmap->first.second,itmap->second));
-			advance(itmap,1);
-			if (itmap == MMPanel.end()) break;
-		}
-		// Fulfills the inVectorSum struct
-		for(map <double, SameIshortcutAndVbreakdownGroup>::iterator itMap
-				= panel_vector[k].detailed_same_i_shortcut_group.begin();
-				itMap != panel_vector[k].detailed_same_i_shortcut_group.end(); ++itMap)
-		{
-			panel_vector[k].sum_same_i_shortcut_group.group_size
-				+= itMap->second.sum_same_i_shortcut_and_v_breakdown_group.group_size;
-
-			panel_vector[k].sum_same_i_shortcut_group.sum_voltage_breakdown_in_group
-				+= itMap->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_breakdown_in_group;
-
-			panel_vector[k].sum_same_i_shortcut_group.sum_voltage_open_circuit_all_cells
-				+= itMap->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_all_cells;
-
-			panel_vector[k].sum_same_i_shortcut_group.sum_voltage_open_circuit_non_active_cells
-				+= itMap->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_non_active_cells;
-		}
-	}
+	retrieveDataFromStringArray();
+	buildPanelZones(0);
 	// Finds the voltage limits where changes in the current or voltage distribution takes place
 	// First check the upper limit of voltage where the cells are generating
 	double LTO = findMaxVoltageLimit();
@@ -173,95 +304,243 @@ void SolarSolver::generatePanelVector (){
 	findVoltageLimitsForChangesInCurrent(LTO);
 	// The diodes can enter conducting state without changing the active group.
 	// Here the voltage where that happens is find
-	findVoltageLimitsForChangesInVoltage();
+	findVoltageLimitsForChangesInVoltage(0);
+	// The contributions of the zones before and after every working zone are added once
+	buildZoneTables(0);
 }
 
-void SolarSolver::retrieveDataFromStringArray (multimap <pair<double,double>,
-		SameIshortcutAndVbreakdownGroup, Classcomp>&MultiMapElDets)
-{
+void SolarSolver::updatePanelVector (const vector<bool> &modified){
+	// Position of the first group of a modified string, before and after the change
+	size_t first_changed = panel_order.size();
+	for (size_t d = 0; d < panel_order.size(); ++d)
+	{
+		if (modified[panel_order[d].first]){
+			first_changed = d;
+			break;
+		}
+	}
+	// The groups of the other strings keep their order, so only the new groups of the modified strings are sorted
+	// and merged with them
+	PanelOrderComp comp(string_groups);
+	vector <pair<int,int>> kept, added;
+	kept.reserve(panel_order.size());
+	for (size_t d = 0; d < panel_order.size(); ++d)
+	{
+		if (!modified[panel_order[d].first]) kept.push_back(panel_order[d]);
+	}
+	for (int j = 0; j < number_strings; ++j)
+	{
+		if (!modified[j]) continue;
+		for (size_t g = 0; g < string_groups[j].size(); ++g)
+		{
+			added.push_back(make_pair(j, (int)g));
+		}
+	}
+	sort(added.begin(), added.end(), comp);
+	panel_order.resize(kept.size() + added.size());
+	merge(kept.begin(), kept.end(), added.begin(), added.end(), panel_order.begin(), comp);
+	for (size_t d = 0; d < first_changed && d < panel_order.size(); ++d)
+	{
+		if (modified[panel_order[d].first]){
+			first_changed = d;
+			break;
+		}
+	}
+
+	// The groups before first_changed are the same. The zone of the last of them is built again, since the next
+	// group can now have its Isc, and so is every zone after it
+	size_t first_zone = 0;
+	if (first_changed > 0)
+	{
+		while (first_zone + 1 < panel_vector.size() && (size_t)panel_vector[first_zone+1].first_detail < first_changed)
+		{
+			++first_zone;
+		}
+	}
+	if (first_zone < panel_vector.size())
+	{
+		panel_groups.resize(panel_vector[first_zone].first_group);
+		panel_details.resize(panel_vector[first_zone].first_detail);
+		panel_vector.resize(first_zone);
+	}
+	buildPanelZones(panel_details.size());
+
+	// Every limit depends on the open circuit voltage of the whole panel
+	findVoltageLimitsForChangesInCurrent(findMaxVoltageLimit());
+	findVoltageLimitsForChangesInVoltage(first_zone);
+	buildZoneTables(first_zone);
+}
+
+void SolarSolver::buildPanelZones (int first_detail){
+	size_t first_zone = panel_vector.size();
+	// Every run of groups with the same Isc is a new entry in panel_vector, and every run with the same Isc and Vbrx
+	// is a new entry in panel_groups
+	for (size_t d = first_detail; d < panel_order.size(); ++d)
+	{
+		const pair<pair<double,double>,CellsGroup> &group = string_groups[panel_order[d].first][panel_order[d].second];
+		double Iscx = group.first.first;
+		double Vbrx = group.first.second;
+		bool new_zone = panel_vector.empty() || Iscx != panel_vector.back().sum_same_i_shortcut_group.current_shortcut;
+		if (new_zone)
+		{
+			SameIshortcutGroup iVC;
+			iVC.sum_same_i_shortcut_group.current_shortcut = Iscx;
+			iVC.sum_same_i_shortcut_group.group_size = 0;
+			iVC.sum_same_i_shortcut_group.sum_voltage_breakdown_in_group = 0;
+			iVC.sum_same_i_shortcut_group.sum_voltage_open_circuit_all_cells = 0;
+			iVC.sum_same_i_shortcut_group.sum_voltage_open_circuit_non_active_cells = 0;
+			iVC.first_group = panel_groups.size();
+			iVC.number_groups = 0;
+			iVC.first_detail = d;
+			iVC.number_details = 0;
+			panel_vector.push_back(iVC);
+		}
+		SameIshortcutGroup &zone = panel_vector.back();
+		if (new_zone || Vbrx != panel_groups.back().voltage_breakdown_in_group)
+		{
+			SameIshortcutAndVbreakdownGroup iMC;
+			iMC.sum_same_i_shortcut_and_v_breakdown_group = group.second;
+			iMC.voltage_breakdown_in_group = Vbrx;
+			iMC.first_detail = d;
+			iMC.number_details = 0;
+			panel_groups.push_back(iMC);
+			zone.number_groups += 1;
+		}
+		else
+		{
+			// Unifies the groups with the same Isc and Vbr of different strings
+			CellsGroup &sum = panel_groups.back().sum_same_i_shortcut_and_v_breakdown_group;
+			sum.sum_voltage_breakdown_in_group += group.second.sum_voltage_breakdown_in_group;
+			sum.sum_voltage_open_circuit_all_cells += group.second.sum_voltage_open_circuit_all_cells;
+			sum.sum_voltage_open_circuit_non_active_cells += group.second.sum_voltage_open_circuit_non_active_cells;
+			sum.group_size += group.second.group_size;
+		}
+		panel_groups.back().number_details += 1;
+		zone.number_details += 1;
+		panel_details.push_back(make_pair(panel_order[d].first, group.second));
+	}
+	// Fulfills the sum_same_i_shortcut_group struct of every new zone
+	for (size_t k = first_zone; k < panel_vector.size(); ++k){
+		CellsGroup &sum = panel_vector[k].sum_same_i_shortcut_group;
+		for (int g = panel_vector[k].first_group; g < panel_vector[k].first_group + panel_vector[k].number_groups; ++g)
+		{
+			const CellsGroup &group = panel_groups[g].sum_same_i_shortcut_and_v_breakdown_group;
+			sum.group_size += group.group_size;
+			sum.sum_voltage_breakdown_in_group += group.sum_voltage_breakdown_in_group;
+			sum.sum_voltage_open_circuit_all_cells += group.sum_voltage_open_circuit_all_cells;
+			sum.sum_voltage_open_circuit_non_active_cells += group.sum_voltage_open_circuit_non_active_cells;
+		}
+	}
+}
+
+void SolarSolver::buildZoneTables (int first_zone){
+	int Z = panel_vector.size();
+	int n = number_strings;
+
+	zone_limits_decreasing = true;
+	for (int k = 1; k < Z; ++k){
+		if (!(panel_vector[k].sum_same_i_shortcut_group.limit_voltage < panel_vector[k-1].sum_same_i_shortcut_group.limit_voltage)){
+			zone_limits_decreasing = false;
+		}
+	}
+
+	if ((size_t)(Z + 1)*n > ZONE_TABLE_MAX_VALUES_REF){
+		zone_upper_voltages.clear();
+		zone_lower_voltages.clear();
+		return;
+	}
+
+	// Prefix sums: row m+1 adds the breakdown voltages of the zone m to row m. The rows up to first_zone only depend
+	// on the zones before it, so they are kept if the table was built
+	if (zone_upper_voltages.empty()) first_zone = 0;
+	zone_upper_voltages.resize((size_t)(Z + 1)*n);
+	if (first_zone == 0){
+		std::fill(zone_upper_voltages.begin(), zone_upper_voltages.begin() + n, 0.0);
+	}
+	for (int m = first_zone; m < Z; ++m){
+		double *row = &zone_upper_voltages[(size_t)(m + 1)*n];
+		std::copy(row - n, row, row);
+		int end = panel_vector[m].first_detail + panel_vector[m].number_details;
+		for (int d = panel_vector[m].first_detail; d < end; ++d){
+			const CellsGroup &group = panel_details[d].second;
+			row[panel_details[d].first] += group.sum_voltage_breakdown_in_group
+					+ group.sum_voltage_open_circuit_non_active_cells;
+		}
+	}
+	// Suffix sums: row m adds the open circuit voltages of the zone m+1 to row m+1. Every row depends on the last
+	// zones, so they are all built again
+	zone_lower_voltages.assign((size_t)(Z + 1)*n, 0.0);
+	for (int m = Z - 2; m >= 0; --m){
+		double *row = &zone_lower_voltages[(size_t)m*n];
+		std::copy(row + n, row + 2*n, row);
+		int end = panel_vector[m+1].first_detail + panel_vector[m+1].number_details;
+		for (int d = panel_vector[m+1].first_detail; d < end; ++d){
+			const CellsGroup &group = panel_details[d].second;
+			row[panel_details[d].first] += (group.sum_voltage_open_circuit_all_cells
+					+ group.sum_voltage_open_circuit_non_active_cells);
+		}
+	}
+}
+
+void SolarSolver::findStringGroups (int j){
+	vector <pair<pair<double,double>,CellsGroup>> &groups = string_groups[j];
 	double Iscx, Vbrx;
 	CellsGroup gS;
-	SameIshortcutAndVbreakdownGroup iMC;
 	pair<double,double> clau;
-	// Iterates all the strings in the panel.
-	// Since the groups are ordered, the ones with lesser Isc will be first (breakdown,actives and non-active)
-	for (int j=0; j<number_strings; j++){
-		// Iterator of the groups of cells with the same parameters in the string
-		list<TotalsOfCellsGroup>::iterator itList = string_array[j].groupsByCurrentShortcut.begin();
-		while (itList !=string_array[j].groupsByCurrentShortcut.end()){
 
-			// Stores locally all the values. It takes all the cells in the group as 'active cells'
-			Iscx = itList->current_shortcut;
-			gS.group_size = itList->index.size();
-			gS.sum_voltage_open_circuit_all_cells = itList->sum_voltage_open_circuit;
-			gS.sum_voltage_open_circuit_non_active_cells = 0.0;
-			gS.sum_voltage_breakdown_in_group = itList->sum_voltage_breakdown_in_group;
+	groups.clear();
+	// Iterator of the groups of cells with the same parameters in the string
+	vector<TotalsOfCellsGroup>::iterator itList = string_array[j].groupsByCurrentShortcut.begin();
+	while (itList !=string_array[j].groupsByCurrentShortcut.end()){
 
-			Vbrx = itList->sum_voltage_breakdown_in_group/gS.group_size;
-			// The key of the map
-			clau = make_pair(Iscx,Vbrx);
+		// Stores locally all the values. It takes all the cells in the group as 'active cells'
+		Iscx = itList->current_shortcut;
+		gS.group_size = itList->number_cells;
+		gS.sum_voltage_open_circuit_all_cells = itList->sum_voltage_open_circuit;
+		gS.sum_voltage_open_circuit_non_active_cells = 0.0;
+		gS.sum_voltage_breakdown_in_group = itList->sum_voltage_breakdown_in_group;
 
-			// If the group analyzed has the bypass diode conducting (or all the cells in breakdown) end the while loop.
-			if (itList->sum_voltage_breakdown_in_group > itList->sum_voltage_breakdown) break;
+		Vbrx = itList->sum_voltage_breakdown_in_group/gS.group_size;
+		// The key of the map
+		clau = make_pair(Iscx,Vbrx);
 
-			iMC.detailed_same_i_shortcut_and_v_breakdown_group.push_back(make_pair(j,gS));
-			iMC.sum_same_i_shortcut_and_v_breakdown_group = gS;
-			MultiMapElDets.insert(make_pair(clau,iMC));
-			iMC.detailed_same_i_shortcut_and_v_breakdown_group.clear();
-
-			advance(itList,1);
-		}
-		// Only enters this loop if the iterator is not at the end --> If there's group/s in breakdown(diode on)
-		if (itList != string_array[j].groupsByCurrentShortcut.end()){
-			advance(itList,1);
-			while(itList !=string_array[j].groupsByCurrentShortcut.end()){
-				// If there's group/s in breakdown we have to correct the SVocr
-				gS.sum_voltage_open_circuit_non_active_cells += itList->sum_voltage_open_circuit;
-				advance(itList,1);
-			}
-			iMC.detailed_same_i_shortcut_and_v_breakdown_group.push_back(make_pair(j,gS));
-			iMC.sum_same_i_shortcut_and_v_breakdown_group = gS;
+		// If the group analyzed has the bypass diode conducting (or all the cells in breakdown) end the while loop.
+		if (itList->sum_voltage_breakdown_in_group > itList->sum_voltage_breakdown) break;
 
-			MultiMapElDets.insert(make_pair(clau,iMC));
-			iMC.detailed_same_i_shortcut_and_v_breakdown_group.clear();
+		groups.push_back(make_pair(clau,gS));
 
+		advance(itList,1);
+	}
+	// Only enters this loop if the iterator is not at the end --> If there's group/s in breakdown(diode on)
+	if (itList != string_array[j].groupsByCurrentShortcut.end()){
+		advance(itList,1);
+		while(itList !=string_array[j].groupsByCurrentShortcut.end()){
+			// If there's group/s in breakdown we have to correct the SVocr
+			gS.sum_voltage_open_circuit_non_active_cells += itList->sum_voltage_open_circuit;
+			advance(itList,1);
 		}
+		groups.push_back(make_pair(clau,gS));
 	}
-	// Unifies elements with the same Isc and Vbr. Across all the multimap. This implies the entire panel.
-	// Instantiates a pair of multimaps
-	pair<multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator,
-		multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator> ret;
-	// Temporal iterator to keep track of the last element
-	multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator itmap1;
-	// Iterator 2 iterates across our filled multimap
-	for (multimap<pair<double,double>,SameIshortcutAndVbreakdownGroup, Classcomp>::iterator
-			itmap2 = MultiMapElDets.begin(); itmap2 != MultiMapElDets.end(); ++itmap2)
-	{
-		itmap1 = itmap2;
-		ret = MultiMapElDets.equal_range(itmap2->first);
-		advance(itmap1,1);
-		while (itmap1 != ret.second){
-			itmap2->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_breakdown_in_group
-				+= itmap1->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_breakdown_in_group;
-			itmap2->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_all_cells
-				+= itmap1->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_all_cells;
-			itmap2->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_non_active_cells
-				+= itmap1->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_open_circuit_non_active_cells;
-			itmap2->second.sum_same_i_shortcut_and_v_breakdown_group.group_size
-				+= itmap1->second.sum_same_i_shortcut_and_v_breakdown_group.group_size;
+}
 
-			itmap2->second.detailed_same_i_shortcut_and_v_breakdown_group.push_back
-				(*itmap1->second.detailed_same_i_shortcut_and_v_breakdown_group.begin());
-			itmap1 = MultiMapElDets.erase(itmap1);
-			}
+void SolarSolver::retrieveDataFromStringArray (void)
+{
+	// Iterates all the strings in the panel. Their groups were found by findStringGroups
+	panel_order.clear();
+	for (int j=0; j<number_strings; j++){
+		for (size_t g=0; g<string_groups[j].size(); g++){
+			panel_order.push_back(make_pair(j,g));
+		}
 	}
+	// A single sort joins the groups with the same Isc and Vbr across the entire panel
+	sort(panel_order.begin(), panel_order.end(), PanelOrderComp(string_groups));
 }
 /*
  * Returns the "first upper limit" of the I-V characteristic. That is the sum of Voc of every cell.
  */
 double SolarSolver::findMaxVoltageLimit (){
 	double LTO = 0;
-	for(int k=0; k<panel_vector.size(); ++k){
+	for(size_t k=0; k<panel_vector.size(); ++k){
 		LTO += (panel_vector[k].sum_same_i_shortcut_group.sum_voltage_open_circuit_non_active_cells+panel_vector[k].sum_same_i_shortcut_group.sum_voltage_open_circuit_all_cells);
 	}
 	return LTO;
@@ -276,7 +555,7 @@ double SolarSolver::findMaxVoltageLimit (){
  */
 void SolarSolver::findVoltageLimitsForChangesInCurrent (const double LTO){
 	double LTi = LTO;
-	for (int k=0; k<panel_vector.size(); ++k){
+	for (size_t k=0; k<panel_vector.size(); ++k){
 		LTi -= panel_vector[k].sum_same_i_shortcut_group.sum_voltage_open_circuit_all_cells;
 		LTi += panel_vector[k].sum_same_i_shortcut_group.sum_voltage_breakdown_in_group;
 		panel_vector[k].sum_same_i_shortcut_group.limit_voltage = LTi;
@@ -289,20 +568,20 @@ void SolarSolver::findVoltageLimitsForChangesInCurrent (const double LTO){
  *
  * The internal limits represent a change in the distribution of the total voltage.
  */
-void SolarSolver::findVoltageLimitsForChangesInVoltage(){
+void SolarSolver::findVoltageLimitsForChangesInVoltage(int first_zone){
 	int N, Ngr;
 	double Voffset;
-	map <double, SameIshortcutAndVbreakdownGroup>::reverse_iterator itMap;
-	for (int k=0; k<panel_vector.size(); ++k){
+	for (size_t k = first_zone; k < panel_vector.size(); ++k){
 		N = panel_vector[k].sum_same_i_shortcut_group.group_size;
 		Voffset = -panel_vector[k].sum_same_i_shortcut_group.sum_voltage_breakdown_in_group;
-			for (itMap = panel_vector[k].detailed_same_i_shortcut_group.rbegin();
-					itMap != panel_vector[k].detailed_same_i_shortcut_group.rend(); ++itMap)
+			// From the greatest Vbrx to the lowest one
+			for (int g = panel_vector[k].first_group + panel_vector[k].number_groups - 1; g >= panel_vector[k].first_group; --g)
 			{
-				Ngr = itMap->second.sum_same_i_shortcut_and_v_breakdown_group.group_size;
-				itMap->second.sum_same_i_shortcut_and_v_breakdown_group.limit_voltage = N*itMap->first + Voffset;
+				CellsGroup &group = panel_groups[g].sum_same_i_shortcut_and_v_breakdown_group;
+				Ngr = group.group_size;
+				group.limit_voltage = N*panel_groups[g].voltage_breakdown_in_group + Voffset;
 				N -= Ngr;
-				Voffset += itMap->second.sum_same_i_shortcut_and_v_breakdown_group.sum_voltage_breakdown_in_group;
+				Voffset += group.sum_voltage_breakdown_in_group;
 			}
 	}
 }
@@ -310,7 +589,20 @@ void SolarSolver::findVoltageLimitsForChangesInVoltage(){
 
 int SolarSolver::findWorkingZone (double Vin)
 {
-	int i = 0;
+	if (zone_limits_decreasing){
+		// First zone whose limit is below Vin
+		int lower = 0, upper = panel_vector.size();
+		while (lower < upper){
+			int i = (lower + upper)/2;
+			if (Vin > panel_vector[i].sum_same_i_shortcut_group.limit_voltage){
+				upper = i;
+			}else{
+				lower = i + 1;
+			}
+		}
+		return(lower);
+	}
+	size_t i = 0;
 	while(i<panel_vector.size()){
 			if (Vin > panel_vector[i].sum_same_i_shortcut_group.limit_voltage)
 				{break;
@@ -323,101 +615,91 @@ int SolarSolver::findWorkingZone (double Vin)
 
 void SolarSolver::calcUpperZones(int m, vector <double> &vVector)
 {
-	int iString;
-	for (int k = 0; k < m; ++k){
-		for (map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap
-				= panel_vector[k].detailed_same_i_shortcut_group.begin();
-				itmap != panel_vector[k].detailed_same_i_shortcut_group.end(); ++itmap)
-		{
-			for (list<pair<int,CellsGroup>>::iterator itList
-					= itmap->second.detailed_same_i_shortcut_and_v_breakdown_group.begin();
-					itList != itmap->second.detailed_same_i_shortcut_and_v_breakdown_group.end(); ++itList)
-			{
-				iString = itList->first;
-				vVector[iString]+=itList->second.sum_voltage_breakdown_in_group
-						+ itList->second.sum_voltage_open_circuit_non_active_cells;
-			}
+	// The groups of the zones before m are the first ones in panel_details
+	size_t end = ((size_t)m < panel_vector.size()) ? panel_vector[m].first_detail : panel_details.size();
+	// The row of the table is added when it is shorter than the groups
+	if (!zone_upper_voltages.empty() && end > (size_t)number_strings){
+		const double *row = &zone_upper_voltages[(size_t)m*number_strings];
+		for (int j = 0; j < number_strings; ++j){
+			vVector[j] += row[j];
 		}
+		return;
+	}
+	for (size_t d = 0; d < end; ++d){
+		const CellsGroup &group = panel_details[d].second;
+		vVector[panel_details[d].first] += group.sum_voltage_breakdown_in_group
+				+ group.sum_voltage_open_circuit_non_active_cells;
 	}
 }
 
 void SolarSolver::calcLowerZones(int m, vector <double> &vVector)
 {
-	int iString;
+	// The groups of the zones after m are the last ones in panel_details
+	size_t begin = ((size_t)m < panel_vector.size()) ? panel_vector[m].first_detail + panel_vector[m].number_details : panel_details.size();
+	if (!zone_lower_voltages.empty() && panel_details.size() - begin > (size_t)number_strings){
+		const double *row = &zone_lower_voltages[(size_t)m*number_strings];
+		for (int j = 0; j < number_strings; ++j){
+			vVector[j] += row[j];
+		}
+		return;
+	}
 	for (int k = panel_vector.size()-1; k > m; --k){
-		for (map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap
-				= panel_vector[k].detailed_same_i_shortcut_group.begin();
-				itmap != panel_vector[k].detailed_same_i_shortcut_group.end(); ++itmap)
+		int end = panel_vector[k].first_detail + panel_vector[k].number_details;
+		for (int d = panel_vector[k].first_detail; d < end; ++d)
 		{
-			for (list<pair<int,CellsGroup>>::iterator itList
-					= itmap->second.detailed_same_i_shortcut_and_v_breakdown_group.begin();
-					itList != itmap->second.detailed_same_i_shortcut_and_v_breakdown_group.end(); ++itList)
-			{
-				iString = itList->first;
-				vVector[iString]+=(itList->second.sum_voltage_open_circuit_all_cells
-						+ itList->second.sum_voltage_open_circuit_non_active_cells);
-			}
+			const CellsGroup &group = panel_details[d].second;
+			vVector[panel_details[d].first] += (group.sum_voltage_open_circuit_all_cells
+					+ group.sum_voltage_open_circuit_non_active_cells);
 		}
 	}
 }
 
 void SolarSolver::calcMiddleZones(int m, double Vpan, vector <double> &vVector)
 {
-	int iString;
 	double Vrel = Vpan-panel_vector[m].sum_same_i_shortcut_group.limit_voltage;
-	map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap;
+	int first = panel_vector[m].first_group;
+	int end = first + panel_vector[m].number_groups;
+	int g;
 	// The working zone is found
-	for (itmap = panel_vector[m].detailed_same_i_shortcut_group.begin();
-			itmap != panel_vector[m].detailed_same_i_shortcut_group.end(); ++itmap)
+	for (g = first; g < end; ++g)
 	{
-		if (Vrel<itmap->second.sum_same_i_shortcut_and_v_breakdown_group.limit_voltage) break;
+		if (Vrel<panel_groups[g].sum_same_i_shortcut_and_v_breakdown_group.limit_voltage) break;
 	}
+	/*
+	 * Degenerate case: Vrel is below the limit of the first group. That limit is 0 up to rounding, so it only happens
+	 * when Vpan is at the limit of the zone. There is no group before the first one to take vLim and vRupt from (the
+	 * previous version stepped back from the beginning of the map there), so the group with the lowest Vbrx is taken
+	 * as active. The zone has at least one group, so g does not go beyond end.
+	 */
+	if (g == first) g = first + 1;
 
 	// Assignment of the breakdown voltages (or Vocr if the diode conducts first)
-	map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap2 = itmap;
-
-	while (itmap2 != panel_vector[m].detailed_same_i_shortcut_group.end()){
-		for (list<pair<int,CellsGroup>>::iterator itList
-				= itmap2->second.detailed_same_i_shortcut_and_v_breakdown_group.begin();
-				itList != itmap2->second.detailed_same_i_shortcut_and_v_breakdown_group.end(); ++itList)
-		{
-				iString = itList->first;
-				vVector[iString]+=itList->second.sum_voltage_breakdown_in_group
-						+ itList->second.sum_voltage_open_circuit_non_active_cells;
-			}
-			advance(itmap2,1);
+	int split = (g < end) ? panel_groups[g].first_detail : panel_vector[m].first_detail + panel_vector[m].number_details;
+	for (int d = split; d < panel_vector[m].first_detail + panel_vector[m].number_details; ++d)
+	{
+		const CellsGroup &group = panel_details[d].second;
+		vVector[panel_details[d].first] += group.sum_voltage_breakdown_in_group
+				+ group.sum_voltage_open_circuit_non_active_cells;
 	}
 
 	int N = 0;
 	double vLim, vRupt, vS;
 
-	for (map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap3
-			= panel_vector[m].detailed_same_i_shortcut_group.begin(); itmap3 != itmap; ++itmap3)
+	for (int g2 = first; g2 < g; ++g2)
 	{
-		N += itmap3->second.sum_same_i_shortcut_and_v_breakdown_group.group_size;
+		N += panel_groups[g2].sum_same_i_shortcut_and_v_breakdown_group.group_size;
 	}
 
-	advance(itmap,-1);
-
-	vLim = itmap->second.sum_same_i_shortcut_and_v_breakdown_group.limit_voltage;
-	vRupt = itmap->first;
+	vLim = panel_groups[g-1].sum_same_i_shortcut_and_v_breakdown_group.limit_voltage;
+	vRupt = panel_groups[g-1].voltage_breakdown_in_group;
 
 	// The voltage of every active cell is calculated
 	vS = (Vrel-vLim)/N + vRupt;
 
-	advance(itmap,1);
-
-	for (map<double,SameIshortcutAndVbreakdownGroup>::iterator itmap3
-			= panel_vector[m].detailed_same_i_shortcut_group.begin(); itmap3 != itmap; ++itmap3)
+	for (int d = panel_vector[m].first_detail; d < split; ++d)
 	{
-		for (list<pair<int,CellsGroup>>::iterator itList
-				= itmap3->second.detailed_same_i_shortcut_and_v_breakdown_group.begin();
-				itList != itmap3->second.detailed_same_i_shortcut_and_v_breakdown_group.end(); ++itList)
-		{
-				iString = itList->first;
-				N = itList->second.group_size;
-				vVector[iString]+=(N*vS + itList->second.sum_voltage_open_circuit_non_active_cells);
-			}
+		const CellsGroup &group = panel_details[d].second;
+		vVector[panel_details[d].first] += (group.group_size*vS + group.sum_voltage_open_circuit_non_active_cells);
 	}
 }
 
@@ -450,231 +732,1644 @@ void SolarSolver::assignStringVoltages(double Vpan, vector <double> &VString)
 
 void SolarSolver::calcIVcharacteristic(std::string output_path)
 {
+	// A point where the iterative method fails is reported and the rest are still written
+	report_point_errors = true;
 	try
 	{
-		// Vector to store the voltage of every string
-		vector <double> voltVector(number_strings, 0.0);
-
-		double Itotal;
-
-		// The variables are the voltage of every cell, the currents of every string and the total current
-		int dimX = number_strings + 1;
-		for (int i=0; i<number_strings; i++)
-		{
-			dimX = dimX + string_array[i].string_size;
-		}
-
-		// Standard characteristic is composed by 250 points
-		double start_v = -2;
-		double end_v = findMaxVoltageLimit();
-		int numb_points = 250;
-		double step = (end_v - start_v)/numb_points;
-		step = (int)(step * 100 + .5);
-		step = (double)step / 100;
-
+		mat curve = calcIVcharacteristic();
 
 		fstream fout;
 		// opens an existing csv file or creates a new file.
 		fout.open(output_path, ios::out);
 
-		for (double vc = start_v; vc <= end_v; vc += step)
+		for (uword k = 0; k < curve.n_rows; ++k)
 		{
-			// Initialization of the (recycled) voltVector
-			for (int i = 0; i < voltVector.size(); ++i)
-			{
-				voltVector[i] = 0.0;
-			}
-			// Assignment of currents and voltages to every string
-			Itotal = findTotalCurrent(vc);
-			assignStringVoltages(vc, voltVector);
-			// Calculation of the initial approximation
-			for (int k = 0; k < number_strings; ++k)
-			{
-				string_array[k].findInitialState(Itotal, voltVector[k]);
-			}
-
-			// Iterative method is called to solve every string
-			try
-			{
-				Itotal = calcNewtonRaphson(string_array,vc,dimX, number_strings);
-			}
-			catch(...)
-			{
-				std::cout << "Error when computing the iterative method for "<< vc << " volts." << endl;
-			}
-
 			// Insert the data to file
-			fout << vc << ";" << Itotal << "\n";
-			std::cout << vc << "; " << Itotal << "\n";
+			fout << curve(k,0) << ";" << curve(k,1) << "\n";
+			std::cout << curve(k,0) << "; " << curve(k,1) << "\n";
 		}
 		fout.close();
 	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the IV characteristic: " << err.what() << endl;
+	}
 	catch(...)
 	{
 		std::cout << "Error when computing the IV characteristic" << endl;
 	}
+	report_point_errors = false;
 }
 
 void SolarSolver::calcIVcharacteristic(std::string output_path, double start_v, double end_v, int numb_points)
 {
+	// A point where the iterative method fails is reported and the rest are still written
+	report_point_errors = true;
 	try
 	{
-		if(start_v > end_v || numb_points < 1)
-		{
-			throw std::runtime_error("Error in the characteristic parameters.");
-		}
-
-		// Vector to store the voltage of every string
-		vector <double> voltVector(number_strings, 0.0);
-
-		double Itotal;
-
-		// The variables are the voltage of every cell, the currents of every string and the total current
-		int dimX = number_strings + 1;
-		for (int i=0; i<number_strings; i++)
-		{
-			dimX = dimX + string_array[i].string_size;
-		}
-
-		// Standard characteristic is composed by 250 points
-		double step = (end_v - start_v)/numb_points;
-		step = (int)(step * 100 + .5);
-		step = (double)step / 100;
+		mat curve = calcIVcharacteristic(start_v, end_v, numb_points);
 
 		fstream fout;
 		// opens an existing csv file or creates a new file.
 		fout.open(output_path, ios::out);
 
-		for (double vc = start_v; vc <= end_v; vc += step)
+		for (uword k = 0; k < curve.n_rows; ++k)
 		{
-			// Initialization of the (recycled) voltVector
-			for (int i = 0; i < voltVector.size(); ++i)
-			{
-				voltVector[i] = 0.0;
-			}
-			// Assignment of currents and voltages to every string
-			Itotal = findTotalCurrent(vc);
-			assignStringVoltages(vc, voltVector);
-			// Calculation of the initial approximation
-			for (int k = 0; k < number_strings; ++k)
-			{
-				string_array[k].findInitialState(Itotal, voltVector[k]);
-			}
-
-			// Iterative method is called to solve every string
-			try
-			{
-				Itotal = calcNewtonRaphson(string_array,vc,dimX,number_strings);
-			}
-			catch(...)
-			{
-				std::cout << "Error when computing the iterative method for "<< vc << " volts." << endl;
-			}
-
 			// Insert the data to file
-			fout << vc << ";" << Itotal << "\n";
-			std::cout << vc << "; " << Itotal << "\n";
+			fout << curve(k,0) << ";" << curve(k,1) << "\n";
+			std::cout << curve(k,0) << "; " << curve(k,1) << "\n";
 		}
 		fout.close();
 	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the IV characteristic: " << err.what() << endl;
+	}
 	catch(...)
 	{
 		std::cout << "Error when computing the IV characteristic" << endl;
 	}
+	report_point_errors = false;
 }
 
-void SolarSolver::calcState(std::string output_path, double Vpan)
+mat SolarSolver::calcIVcharacteristic(void)
 {
-	try
-	{
-		// Vector to store the voltage of every string
-		vector <double> voltVector(number_strings, 0.0);
+	// Standard characteristic is composed by 250 points
+	return(calcIVcharacteristic(-2, findMaxVoltageLimit(), 250));
+}
 
-		double Itotal;
+mat SolarSolver::calcIVcharacteristic(double start_v, double end_v, int numb_points)
+{
+	if(start_v > end_v || numb_points < 1)
+	{
+		throw std::runtime_error("Error in the characteristic parameters.");
+	}
 
-		// The variables are the voltage of every cell, the currents of every string and the total current
-		int dimX = number_strings + 1;
-		for (int i=0; i<number_strings; i++)
-		{
-			dimX = dimX + string_array[i].string_size;
-		}
+	// Voltage of every point of the characteristic
+	vector <double> voltages;
+	findCharacteristicVoltages(start_v, end_v, numb_points, voltages);
 
-		// Initialization of the (recycled) voltVector
-		for (int i = 0; i < voltVector.size(); ++i)
-		{
-			voltVector[i] = 0.0;
-		}
-		// Assignment of currents and voltages to every string
-		Itotal = findTotalCurrent(Vpan);
-		assignStringVoltages(Vpan, voltVector);
-		// Calculation of the initial approximation
-		for (int k = 0; k < number_strings; ++k)
-		{
-			string_array[k].findInitialState(Itotal, voltVector[k]);
-		}
+	return(calcIVcharacteristic(voltages));
+}
 
-		// Iterative method is called to solve every string
-		try
-		{
-			Itotal = calcNewtonRaphson(string_array, Vpan, dimX, number_strings);
-		}
-		catch(...)
-		{
-			std::cout << "Error when computing the iterative method." << endl;
-		}
+void SolarSolver::findCharacteristicVoltages(double start_v, double end_v, int numb_points, vector<double> &voltages)
+{
+	double step = (end_v - start_v)/numb_points;
+	step = (int)(step * 100 + .5);
+	step = (double)step / 100;
 
-		// Starts the printing process
-		ofstream arx;
+	voltages.clear();
+	for (double vc = start_v; vc <= end_v; vc += step)
+	{
+		voltages.push_back(vc);
+	}
+}
 
-		std::string output_file = output_path;
-		arx.open(output_path, ios::out);
-		if (!arx){
-			cout << "Cannot open the output file.";
-		}
+mat SolarSolver::calcIVcharacteristic(const vector<double> &voltages)
+{
+	vector <double> currents;
 
-		for (int k = 0; k < number_strings; ++k){
-			arx << "Idiode(" << k << ") = " << string_array[k].diode_bypass.getCurrentDiode() << " A" << endl;
-		}
+	// Every point is solved (in parallel if more than one thread is used)
+	calcCharacteristicPoints(voltages, currents, continuation);
+
+	mat curve(voltages.size(), 2);
+	for (size_t k = 0; k < voltages.size(); ++k)
+	{
+		curve(k,0) = voltages[k];
+		curve(k,1) = currents[k];
+	}
+	return(curve);
+}
+
+void SolarSolver::calcAdaptiveIVcharacteristic(std::string output_path, double tolerance, int max_points)
+{
+	// Same range as the standard characteristic
+	calcAdaptiveIVcharacteristic(output_path, -2, findMaxVoltageLimit(), tolerance, max_points);
+}
+
+void SolarSolver::calcAdaptiveIVcharacteristic(std::string output_path, double start_v, double end_v, double tolerance, int max_points)
+{
+	// A point where the iterative method fails is reported and the rest are still written
+	report_point_errors = true;
+	try
+	{
+		mat curve = calcAdaptiveIVcharacteristic(start_v, end_v, tolerance, max_points);
+
+		fstream fout;
+		// opens an existing csv file or creates a new file.
+		fout.open(output_path, ios::out);
+
+		for (uword k = 0; k < curve.n_rows; ++k)
+		{
+			// Insert the data to file
+			fout << curve(k,0) << ";" << curve(k,1) << "\n";
+			std::cout << curve(k,0) << "; " << curve(k,1) << "\n";
+		}
+		fout.close();
+	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the IV characteristic: " << err.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when computing the IV characteristic" << endl;
+	}
+	report_point_errors = false;
+}
+
+mat SolarSolver::calcAdaptiveIVcharacteristic(double tolerance, int max_points)
+{
+	// Same range as the standard characteristic
+	return(calcAdaptiveIVcharacteristic(-2, findMaxVoltageLimit(), tolerance, max_points));
+}
+
+mat SolarSolver::calcAdaptiveIVcharacteristic(double start_v, double end_v, double tolerance, int max_points)
+{
+	if(start_v > end_v || tolerance <= 0 || max_points < 2)
+	{
+		throw std::runtime_error("Error in the characteristic parameters.");
+	}
+
+	// Points of the characteristic already solved, sorted by voltage
+	map <double, double> curve;
+	vector <double> voltages;
+	vector <double> currents;
+
+	findCharacteristicBreakpoints(start_v, end_v, voltages);
+	if (voltages.size() > (size_t)max_points)
+	{
+		// The budget does not reach every breakpoint: they are taken evenly
+		vector <double> reduced(max_points);
+		for (int k = 0; k < max_points; ++k)
+		{
+			reduced[k] = voltages[(long)k*(voltages.size()-1)/(max_points-1)];
+		}
+		voltages = reduced;
+	}
+
+	while (!voltages.empty())
+	{
+		// The new points are solved (in parallel if more than one thread is used). The points of every pass
+		// are far apart, so the previous solution alone is not a reliable estimate: only the tangent is used.
+		calcCharacteristicPoints(voltages, currents,
+				continuation == TANGENT_CONTINUATION ? TANGENT_CONTINUATION : NO_CONTINUATION);
+		for (size_t k = 0; k < voltages.size(); ++k)
+		{
+			curve[voltages[k]] = currents[k];
+		}
+		voltages.clear();
+
+		// Error of every point respect the line through its neighbours. Both intervals around a point with a
+		// greater error than the tolerance are split. The key is the new voltage and the value its error.
+		map <double, double> splits;
+		if (curve.size() >= 3)
+		{
+			map<double,double>::iterator it0 = curve.begin();
+			map<double,double>::iterator it1 = next(it0);
+			map<double,double>::iterator it2 = next(it1);
+			for (; it2 != curve.end(); ++it0, ++it1, ++it2)
+			{
+				double Iline = it0->second + (it2->second - it0->second)*(it1->first - it0->first)/(it2->first - it0->first);
+				double error = fabs(it1->second - Iline);
+				if (!(error > tolerance)) continue;
+
+				if (it1->first - it0->first > 2*ADAPTIVE_MIN_STEP_REF)
+				{
+					double &e = splits[0.5*(it0->first + it1->first)];
+					e = max(e, error);
+				}
+				if (it2->first - it1->first > 2*ADAPTIVE_MIN_STEP_REF)
+				{
+					double &e = splits[0.5*(it1->first + it2->first)];
+					e = max(e, error);
+				}
+			}
+		}
+
+		// The points with greater error are added first, until the budget is spent
+		vector <pair<double,double>> candidates;
+		for (map<double,double>::iterator it = splits.begin(); it != splits.end(); ++it)
+		{
+			candidates.push_back(make_pair(it->second, it->first));
+		}
+		sort(candidates.begin(), candidates.end(), greater<pair<double,double>>());
+		int budget = max_points - (int)curve.size();
+		for (int k = 0; k < (int)candidates.size() && k < budget; ++k)
+		{
+			voltages.push_back(candidates[k].second);
+		}
+		sort(voltages.begin(), voltages.end());
+	}
+
+	mat result(curve.size(), 2);
+	int k = 0;
+	for (map<double,double>::iterator it = curve.begin(); it != curve.end(); ++it, ++k)
+	{
+		result(k,0) = it->first;
+		result(k,1) = it->second;
+	}
+	return(result);
+}
+
+void SolarSolver::calcComposedIVcharacteristic(std::string output_path, double start_v, double end_v, int numb_points)
+{
+	try
+	{
+		mat curve = calcComposedIVcharacteristic(start_v, end_v, numb_points);
+
+		fstream fout;
+		// opens an existing csv file or creates a new file.
+		fout.open(output_path, ios::out);
+
+		for (uword k = 0; k < curve.n_rows; ++k)
+		{
+			// Insert the data to file
+			fout << curve(k,0) << ";" << curve(k,1) << "\n";
+			std::cout << curve(k,0) << "; " << curve(k,1) << "\n";
+		}
+		fout.close();
+	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the IV characteristic: " << err.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when computing the IV characteristic" << endl;
+	}
+}
+
+mat SolarSolver::calcComposedIVcharacteristic(double start_v, double end_v, int numb_points)
+{
+	if(start_v > end_v || numb_points < 1)
+	{
+		throw std::runtime_error("Error in the characteristic parameters.");
+	}
+
+	vector <double> voltages;
+	findCharacteristicVoltages(start_v, end_v, numb_points, voltages);
+
+	return(calcComposedIVcharacteristic(voltages));
+}
+
+mat SolarSolver::calcComposedIVcharacteristic(const vector<double> &voltages)
+{
+	int numb_points = voltages.size();
+	mat curve(numb_points, 2);
+	if (numb_points == 0)
+	{
+		return(curve);
+	}
+	double start_v = voltages.front();
+	double end_v = voltages.back();
+
+	// Only one string of every different characteristic is solved
+	vector <int> representatives;
+	vector <int> weights;
+	findEquivalentStrings(representatives, weights);
+	vector <solar_string> strings;
+	for (size_t s = 0; s < representatives.size(); ++s)
+	{
+		strings.push_back(string_array[representatives[s]]);
+	}
+
+	// Maximum distance between consecutive points of the table, in voltage and in current
+	double Imax = 0.0;
+	for (size_t s = 0; s < strings.size(); ++s)
+	{
+		for (vector<TotalsOfCellsGroup>::iterator it = strings[s].groupsByCurrentShortcut.begin(); it != strings[s].groupsByCurrentShortcut.end(); ++it)
+		{
+			Imax = max(Imax, it->current_shortcut);
+		}
+	}
+	Imax = Imax > 0 ? 1.05*Imax : 1.0;
+	double voltage_step = (numb_points > 1 && end_v > start_v) ? (end_v - start_v)/(numb_points - 1) : 1.0;
+	double current_step = Imax/(COMPOSITION_CURRENT_POINTS_REF - 1);
+
+	// Voltage of the panel for every current
+	map <double, double> table;
+	vector <double> currents;
+	vector <vector<double>> string_voltages;
+
+	// First grid: from no current to the greatest shortcut current, plus the shortcut current of every group of
+	// cells, where a bypass diode starts conducting or a cell goes into reverse bias
+	for (int k = 0; k < COMPOSITION_CURRENT_POINTS_REF; ++k)
+	{
+		currents.push_back(current_step*k);
+	}
+	for (size_t s = 0; s < strings.size(); ++s)
+	{
+		for (vector<TotalsOfCellsGroup>::iterator it = strings[s].groupsByCurrentShortcut.begin(); it != strings[s].groupsByCurrentShortcut.end(); ++it)
+		{
+			currents.push_back(it->current_shortcut - 0.01*current_step);
+			currents.push_back(it->current_shortcut);
+			currents.push_back(it->current_shortcut + 0.01*current_step);
+		}
+	}
+
+	int extensions = 0;
+	while (!currents.empty())
+	{
+		sort(currents.begin(), currents.end());
+		currents.erase(unique(currents.begin(), currents.end()), currents.end());
+		calcStringVoltages(strings, currents, string_voltages);
+		for (size_t k = 0; k < currents.size(); ++k)
+		{
+			double Vpan = 0.0;
+			for (size_t s = 0; s < strings.size(); ++s)
+			{
+				Vpan += weights[s]*string_voltages[s][k];
+			}
+			table[currents[k]] = Vpan;
+		}
+		currents.clear();
+		if (table.size() >= COMPOSITION_MAX_POINTS_REF)
+		{
+			break;
+		}
+
+		// The table is extended until it covers the range of voltages, with steps of current that grow every time
+		if (extensions < COMPOSITION_MAX_EXTENSIONS_REF)
+		{
+			double scale = current_step*pow(2.0, extensions);
+			if (table.begin()->second < end_v)
+			{
+				currents.push_back(table.begin()->first - scale);
+			}
+			if (table.rbegin()->second > start_v)
+			{
+				currents.push_back(table.rbegin()->first + scale);
+			}
+			if (!currents.empty())
+			{
+				++extensions;
+				continue;
+			}
+		}
+
+		// Intervals in the range of voltages are split when they are longer than a step of the characteristic, or when
+		// the current of a point is further than the tolerance from the line through its neighbours
+		map<double,double>::iterator it0 = table.begin();
+		map<double,double>::iterator it1 = next(it0);
+		for (; it1 != table.end(); ++it0, ++it1)
+		{
+			// The voltage decreases with the current
+			if (it1->second > end_v || it0->second < start_v) continue;
+			bool split = it0->second - it1->second > voltage_step;
+			map<double,double>::iterator it2 = next(it1);
+			if (!split && it2 != table.end() && it0->second > it2->second)
+			{
+				double Iline = it0->first + (it2->first - it0->first)*(it1->second - it0->second)/(it2->second - it0->second);
+				split = fabs(it1->first - Iline) > COMPOSITION_TOLERANCE_REF;
+			}
+			if (it0 != table.begin() && !split)
+			{
+				map<double,double>::iterator itp = prev(it0);
+				if (itp->second > it1->second)
+				{
+					double Iline = itp->first + (it1->first - itp->first)*(it0->second - itp->second)/(it1->second - itp->second);
+					split = fabs(it0->first - Iline) > COMPOSITION_TOLERANCE_REF;
+				}
+			}
+			double Imid = 0.5*(it0->first + it1->first);
+			if (split && Imid > it0->first && Imid < it1->first)
+			{
+				currents.push_back(Imid);
+			}
+		}
+		if (table.size() + currents.size() > COMPOSITION_MAX_POINTS_REF)
+		{
+			currents.resize(COMPOSITION_MAX_POINTS_REF - table.size());
+		}
+	}
+
+	// The table sorted by increasing voltage. Points that are not decreasing in voltage (numerical noise) are skipped
+	vector <double> table_voltages;
+	vector <double> table_currents;
+	for (map<double,double>::reverse_iterator it = table.rbegin(); it != table.rend(); ++it)
+	{
+		if (table_voltages.empty() || it->second > table_voltages.back())
+		{
+			table_voltages.push_back(it->second);
+			table_currents.push_back(it->first);
+		}
+	}
+
+	vec Vq(voltages);
+	vec Iq;
+	interp1(vec(table_voltages), vec(table_currents), Vq, Iq, "linear", datum::nan);
+	curve.col(0) = Vq;
+	curve.col(1) = Iq;
+	return(curve);
+}
+
+void SolarSolver::calcApproximateIVcharacteristic(std::string output_path, double start_v, double end_v, int numb_points, ApproximationType type)
+{
+	try
+	{
+		mat curve = calcApproximateIVcharacteristic(start_v, end_v, numb_points, type);
+
+		fstream fout;
+		// opens an existing csv file or creates a new file.
+		fout.open(output_path, ios::out);
+
+		for (uword k = 0; k < curve.n_rows; ++k)
+		{
+			// Insert the data to file
+			fout << curve(k,0) << ";" << curve(k,1) << "\n";
+			std::cout << curve(k,0) << "; " << curve(k,1) << "\n";
+		}
+		fout.close();
+	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the IV characteristic: " << err.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when computing the IV characteristic" << endl;
+	}
+}
+
+mat SolarSolver::calcApproximateIVcharacteristic(double start_v, double end_v, int numb_points, ApproximationType type)
+{
+	if(start_v > end_v || numb_points < 1)
+	{
+		throw std::runtime_error("Error in the characteristic parameters.");
+	}
+
+	vector <double> voltages;
+	findCharacteristicVoltages(start_v, end_v, numb_points, voltages);
+
+	return(calcApproximateIVcharacteristic(voltages, type));
+}
+
+mat SolarSolver::calcApproximateIVcharacteristic(const vector<double> &voltages, ApproximationType type)
+{
+	int numb_points = voltages.size();
+	mat curve(numb_points, 2);
+	if (numb_points == 0)
+	{
+		return(curve);
+	}
+
+	if (type == ZONE_APPROXIMATION)
+	{
+		// The current of a working zone is the shortcut current of its groups of cells, and there is no current above
+		// the open circuit voltage of every cell
+		double maxV = findMaxVoltageLimit();
+		for (int k = 0; k < numb_points; ++k)
+		{
+			double Itotal = 0.0;
+			if (voltages[k] <= maxV && !panel_vector.empty())
+			{
+				int m = findWorkingZone(voltages[k]);
+				if ((size_t)m >= panel_vector.size()) m = panel_vector.size() - 1;
+				Itotal = panel_vector[m].sum_same_i_shortcut_group.current_shortcut;
+			}
+			curve(k,0) = voltages[k];
+			curve(k,1) = Itotal;
+		}
+		return(curve);
+	}
+
+	// Only one string of every different characteristic is evaluated
+	vector <int> representatives;
+	vector <int> weights;
+	findEquivalentStrings(representatives, weights);
+
+	double Imax = 0.0;
+	for (size_t s = 0; s < representatives.size(); ++s)
+	{
+		solar_string &st = string_array[representatives[s]];
+		for (vector<TotalsOfCellsGroup>::iterator it = st.groupsByCurrentShortcut.begin(); it != st.groupsByCurrentShortcut.end(); ++it)
+		{
+			Imax = max(Imax, it->current_shortcut);
+		}
+	}
+	Imax = Imax > 0 ? 1.05*Imax : 1.0;
+
+	// Voltage of the panel for a uniform grid of currents, from a negative current (above the open circuit voltage)
+	// to twice the greatest shortcut current
+	vector <double> currents;
+	for (int k = 0; k <= 2.5*APPROXIMATION_CURRENT_POINTS_REF; ++k)
+	{
+		currents.push_back(Imax*(-0.5 + (double)k/APPROXIMATION_CURRENT_POINTS_REF));
+	}
+	vector <double> panel_voltages(currents.size(), 0.0);
+	vector <double> string_voltages;
+	map <vector<double>, vector<double>> cell_voltages;
+	for (size_t s = 0; s < representatives.size(); ++s)
+	{
+		calcApproximateStringVoltages(string_array[representatives[s]], Imax, currents, cell_voltages, string_voltages);
+		for (size_t k = 0; k < currents.size(); ++k)
+		{
+			panel_voltages[k] += weights[s]*string_voltages[k];
+		}
+	}
+
+	// The table sorted by increasing voltage. Points that are not decreasing in voltage are skipped
+	vector <double> table_voltages;
+	vector <double> table_currents;
+	for (int k = currents.size() - 1; k >= 0; --k)
+	{
+		if (table_voltages.empty() || panel_voltages[k] > table_voltages.back())
+		{
+			table_voltages.push_back(panel_voltages[k]);
+			table_currents.push_back(currents[k]);
+		}
+	}
+
+	vec Vq(voltages);
+	vec Iq;
+	interp1(vec(table_voltages), vec(table_currents), Vq, Iq, "linear", datum::nan);
+	curve.col(0) = Vq;
+	curve.col(1) = Iq;
+	return(curve);
+}
+
+void SolarSolver::calcApproximateStringVoltages(solar_string &st, double Imax, const vector<double> &currents,
+		map<vector<double>, vector<double>> &cell_cache, vector<double> &voltages)
+{
+	// Voltage of the cells in series for every current. Every class of cells (irradiance and temperature) is sampled once
+	vector <double> cell_voltages(currents.size(), 0.0);
+	vector <pair<double,double>> table;
+	for (size_t c = 0; c < st.equivalent_cells_index.size(); ++c)
+	{
+		SolarCell &cell = st.cells_array[st.equivalent_cells_index[c]];
+		vector <double> key = {cell.getIrradiance(), cell.getTemperatureCell()};
+		map<vector<double>, vector<double>>::iterator it = cell_cache.find(key);
+		if (it == cell_cache.end())
+		{
+			sampleCellCharacteristic(cell, Imax, table);
+			it = cell_cache.insert(make_pair(key, vector<double>(currents.size(), 0.0))).first;
+			addInterpolatedValues(table, 1.0, currents, it->second);
+		}
+		int weight = st.equivalent_cells_weight[c];
+		for (size_t k = 0; k < currents.size(); ++k)
+		{
+			cell_voltages[k] += weight*it->second[k];
+		}
+	}
+	if (!st.getWithDiode())
+	{
+		voltages = cell_voltages;
+		return;
+	}
+
+	/*
+	 * The current through the bypass diode is explicit in the voltage of the string. The string is sampled for the
+	 * currents of the cells and for a grid of voltages of the diode (with the current of the cells interpolated), since
+	 * the diode takes most of the current for a small change of the current of the cells.
+	 */
+	BypassDiode &diode = st.diode_bypass;
+	double Is = diode.getCurrentReverseSaturation();
+	double Vt = diode.getIdealityFactor()*BOLTZMANN_CONST*diode.getTemperatureDiode()/ELECTRONS_CHARGE;
+	table.clear();
+	vector <pair<double,double>> inverse;
+	for (size_t k = 0; k < currents.size(); ++k)
+	{
+		inverse.push_back(make_pair(-cell_voltages[k], currents[k]));
+		if (-cell_voltages[k]/Vt <= APPROXIMATION_MAX_EXPONENT_REF)
+		{
+			table.push_back(make_pair(currents[k] + Is*(exp(-cell_voltages[k]/Vt) - 1), cell_voltages[k]));
+		}
+	}
+	vector <double> diode_voltages;
+	double Vtop = Vt*log(2*Imax/Is + 1);
+	for (int k = 0; k <= APPROXIMATION_CELL_POINTS_REF; ++k)
+	{
+		diode_voltages.push_back(Vtop*k/APPROXIMATION_CELL_POINTS_REF);
+		diode_voltages.push_back(Vt*log(2*Imax*k/(APPROXIMATION_CELL_POINTS_REF*Is) + 1));
+	}
+	sort(diode_voltages.begin(), diode_voltages.end());
+	vector <double> cell_currents(diode_voltages.size(), 0.0);
+	addInterpolatedValues(inverse, 1.0, diode_voltages, cell_currents);
+	for (size_t k = 0; k < diode_voltages.size(); ++k)
+	{
+		table.push_back(make_pair(cell_currents[k] + Is*(exp(diode_voltages[k]/Vt) - 1), -diode_voltages[k]));
+	}
+	sort(table.begin(), table.end());
+
+	voltages.assign(currents.size(), 0.0);
+	addInterpolatedValues(table, 1.0, currents, voltages);
+}
+
+double SolarSolver::calcApproximationError(double start_v, double end_v, int numb_points, ApproximationType type)
+{
+	mat approximate = calcApproximateIVcharacteristic(start_v, end_v, numb_points, type);
+
+	double Imax = 0.0;
+	for (size_t k = 0; k < panel_vector.size(); ++k)
+	{
+		Imax = max(Imax, panel_vector[k].sum_same_i_shortcut_group.current_shortcut);
+	}
+
+	// Only the points where the solver converges are compared
+	double error = 0.0;
+	for (uword k = 0; k < approximate.n_rows; ++k)
+	{
+		bool solved = false;
+		double Itotal = calcWorkingPoint(approximate(k,0), solved);
+		if (solved && std::isfinite(approximate(k,1)))
+		{
+			error = max(error, fabs(Itotal - approximate(k,1)));
+		}
+	}
+	return(Imax > 0 ? error/Imax : error);
+}
+
+mat SolarSolver::calcCharacteristicForCurrents(const vector<double> &currents)
+{
+	vector <int> representatives;
+	vector <int> weights;
+	findEquivalentStrings(representatives, weights);
+	vector <solar_string> strings;
+	for (size_t s = 0; s < representatives.size(); ++s)
+	{
+		strings.push_back(string_array[representatives[s]]);
+	}
+
+	vector <vector<double>> string_voltages;
+	calcStringVoltages(strings, currents, string_voltages);
+
+	mat curve(currents.size(), 2);
+	for (size_t k = 0; k < currents.size(); ++k)
+	{
+		double Vpan = 0.0;
+		for (size_t s = 0; s < strings.size(); ++s)
+		{
+			Vpan += weights[s]*string_voltages[s][k];
+		}
+		curve(k,0) = Vpan;
+		curve(k,1) = currents[k];
+	}
+	return(curve);
+}
+
+vector<double> SolarSolver::getShortcutCurrents(void)
+{
+	vector <double> currents;
+	for (size_t k = 0; k < panel_vector.size(); ++k)
+	{
+		currents.push_back(panel_vector[k].sum_same_i_shortcut_group.current_shortcut);
+	}
+	return(currents);
+}
+
+MaximumPowerPoint SolarSolver::findMaximumPowerPoint(void)
+{
+	MaximumPowerPoint mpp;
+	mpp.voltage = 0.0;
+	mpp.current = 0.0;
+	mpp.power = 0.0;
+	mpp.number_solves = 0;
+	mpp.number_cells_reverse = 0;
+	mpp.solved = false;
+
+	double maxV = findMaxVoltageLimit();
+	bool solved = false;
+	// A zone where no sample is solved can hide the maximum
+	bool zone_failed = false;
+
+	// Upper bound of the power of every working zone, sorted in decreasing order
+	vector <pair<double,int>> bounds;
+	for (size_t k = 0; k < panel_vector.size(); ++k)
+	{
+		double upper = (k == 0) ? maxV : panel_vector[k-1].sum_same_i_shortcut_group.limit_voltage;
+		bounds.push_back(make_pair(upper*panel_vector[k].sum_same_i_shortcut_group.current_shortcut, k));
+	}
+	sort(bounds.begin(), bounds.end(), greater<pair<double,int>>());
+
+	for (size_t b = 0; b < bounds.size(); ++b)
+	{
+		if (bounds[b].first <= mpp.power) break;
+
+		// Bracket of the zone. Only positive voltages generate power
+		int k = bounds[b].second;
+		double upper = (k == 0) ? maxV : panel_vector[k-1].sum_same_i_shortcut_group.limit_voltage;
+		double lower = panel_vector[k].sum_same_i_shortcut_group.limit_voltage + MPP_VOLTAGE_TOLERANCE_REF;
+		if (lower < 0) lower = 0;
+		if (upper - lower < MPP_VOLTAGE_TOLERANCE_REF) continue;
+
+		// The zone is sampled, since the power can decrease after the knee and increase again before the upper limit
+		double V[MPP_ZONE_POINTS_REF], I[MPP_ZONE_POINTS_REF], g[MPP_ZONE_POINTS_REF];
+		int best = 0;
+		int numb_solved = 0;
+		for (int n = 0; n < MPP_ZONE_POINTS_REF; ++n)
+		{
+			V[n] = lower + (upper - lower)*n/(MPP_ZONE_POINTS_REF - 1);
+			g[n] = calcPowerDerivative(V[n], solved, I[n]);
+			mpp.number_solves += 1;
+			if (!solved){
+				I[n] = 0.0;
+				g[n] = NAN;
+			} else {
+				numb_solved += 1;
+			}
+			if (V[n]*I[n] > V[best]*I[best]) best = n;
+		}
+		if (numb_solved == 0) zone_failed = true;
+		double Vbest = V[best];
+		double Ibest = I[best];
+
+		// Every bracket where dP/dV changes from positive to negative contains a local maximum. The current does not
+		// increase with the voltage, so the power in the bracket is lower than its upper voltage by its first current.
+		for (int first = 0; first < MPP_ZONE_POINTS_REF-1; ++first)
+		{
+			if (!(g[first] > 0 && g[first+1] < 0)) continue;
+			if (V[first+1]*I[first] <= Vbest*Ibest || V[first+1]*I[first] <= mpp.power) continue;
+
+			double Vlow = V[first], glow = g[first];
+			double Vupp = V[first+1], gupp = g[first+1];
+			double Inew;
+
+			// Secant method, safeguarded by the bracket (Illinois modification of the regula falsi)
+			int side = 0;
+			for (int m = 0; m < MPP_MAX_ITERATIONS_REF && Vupp - Vlow > MPP_VOLTAGE_TOLERANCE_REF; ++m)
+			{
+				double Vnew = (Vlow*gupp - Vupp*glow)/(gupp - glow);
+				if (!(Vnew > Vlow && Vnew < Vupp)) Vnew = 0.5*(Vlow + Vupp);
+
+				double gnew = calcPowerDerivative(Vnew, solved, Inew);
+				mpp.number_solves += 1;
+				if (!solved) break;
+
+				if (Vnew*Inew > Vbest*Ibest)
+				{
+					Vbest = Vnew;
+					Ibest = Inew;
+				}
+				if (fabs(gnew) < epsilon) break;
+
+				if (gnew > 0){
+					Vlow = Vnew;
+					glow = gnew;
+					if (side == 1) gupp *= 0.5;
+					side = 1;
+				} else {
+					Vupp = Vnew;
+					gupp = gnew;
+					if (side == -1) glow *= 0.5;
+					side = -1;
+				}
+			}
+		}
+
+		if (Vbest*Ibest > mpp.power)
+		{
+			mpp.voltage = Vbest;
+			mpp.current = Ibest;
+			mpp.power = Vbest*Ibest;
+		}
+	}
+
+	// The panel is solved again at the maximum power point to keep its state
+	calcPowerDerivative(mpp.voltage, solved, mpp.current);
+	mpp.number_solves += 1;
+	if (!solved || zone_failed)
+	{
+		mpp.current = NAN;
+		mpp.power = NAN;
+		return(mpp);
+	}
+	mpp.power = mpp.voltage*mpp.current;
+	mpp.solved = true;
+
+	mpp.string_voltages.resize(number_strings);
+	mpp.string_currents.resize(number_strings);
+	mpp.diode_currents.resize(number_strings);
+	for (int k = 0; k < number_strings; ++k)
+	{
+		string_array[k].expandEquivalentCells();
+		string_array[k].setSumVoltageAllCells();
+		mpp.string_voltages[k] = string_array[k].getSumVoltageAllCells();
+		mpp.string_currents[k] = string_array[k].cells_array[0].getCurrentCell();
+		mpp.diode_currents[k] = string_array[k].diode_bypass.getCurrentDiode();
+		for (int j = 0; j < string_array[k].string_size; ++j)
+		{
+			if (string_array[k].cells_array[j].getVoltageCell() < 0)
+			{
+				mpp.number_cells_reverse += 1;
+			}
+		}
+	}
+
+	return(mpp);
+}
+
+double SolarSolver::findShortCircuitCurrent(void)
+{
+	double Isc = NAN;
+	try
+	{
+		bool solved;
+		double Itotal = calcWorkingPoint(0.0, solved);
+		if (solved) Isc = Itotal;
+	}
+	catch(...)
+	{
+		std::cout << "Error when finding the short circuit current." << endl;
+	}
+	return(Isc);
+}
+
+double SolarSolver::findOpenCircuitVoltage(void)
+{
+	double Voc = NAN;
+	try
+	{
+		bool solved;
+		double Vlow = 0.0;
+		double Ilow = calcWorkingPoint(Vlow, solved);
+		if (!solved){
+			throw std::runtime_error("The short circuit current could not be found.");
+		}
+		if (!(Ilow > 0)){
+			// The panel does not generate current
+			return(0.0);
+		}
+
+		// The current does not increase with the voltage. The upper limit is moved until the current is not positive
+		double Vupp = findMaxVoltageLimit();
+		double Iupp = calcWorkingPoint(Vupp, solved);
+		for (int m = 0; m < OPEN_CIRCUIT_MAX_ITERATIONS_REF && solved && Iupp > 0; ++m)
+		{
+			Vlow = Vupp;
+			Ilow = Iupp;
+			Vupp += max(1.0, 0.05*Vupp);
+			Iupp = calcWorkingPoint(Vupp, solved);
+		}
+		if (!solved || Iupp > 0){
+			throw std::runtime_error("The open circuit voltage could not be bracketed.");
+		}
+
+		// Secant method, safeguarded by the bracket (Illinois modification of the regula falsi)
+		Voc = (Ilow*Vupp - Iupp*Vlow)/(Ilow - Iupp);
+		int side = 0;
+		for (int m = 0; m < OPEN_CIRCUIT_MAX_ITERATIONS_REF && Vupp - Vlow > OPEN_CIRCUIT_TOLERANCE_REF; ++m)
+		{
+			Voc = (Ilow*Vupp - Iupp*Vlow)/(Ilow - Iupp);
+			if (!(Voc > Vlow && Voc < Vupp)) Voc = 0.5*(Vlow + Vupp);
+
+			double Inew = calcWorkingPoint(Voc, solved);
+			if (!solved){
+				throw std::runtime_error("The open circuit voltage could not be found.");
+			}
+			if (fabs(Inew) < epsilon) break;
+
+			if (Inew > 0){
+				Vlow = Voc;
+				Ilow = Inew;
+				if (side == 1) Iupp *= 0.5;
+				side = 1;
+			} else {
+				Vupp = Voc;
+				Iupp = Inew;
+				if (side == -1) Ilow *= 0.5;
+				side = -1;
+			}
+		}
+	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << err.what() << endl;
+		Voc = NAN;
+	}
+	catch(...)
+	{
+		std::cout << "Error when finding the open circuit voltage." << endl;
+		Voc = NAN;
+	}
+	return(Voc);
+}
+
+double SolarSolver::calcWorkingPoint(double Vpan, bool &solved)
+{
+	// With continuation, the last working point solved (also before setCellConditions) is the estimate.
+	// Otherwise, or if it is in a different working zone, the estimate by groups is used
+	solved = continuation != NO_CONTINUATION && last_solved;
+	int zone = last_zone;
+	double Itotal = calcCharacteristicPoint(string_array, workspace, Vpan, last_voltage, continuation, zone, solved);
+	last_voltage = Vpan;
+	last_zone = zone;
+	last_solved = solved;
+	return(Itotal);
+}
+
+double SolarSolver::calcPowerDerivative(double Vpan, bool &solved, double &Itotal)
+{
+	// Every point starts from the estimate by groups: the points of the search are too far apart for the continuation.
+	// The tangent is still calculated, since the derivative of the current is needed.
+	int zone = -1;
+	solved = false;
+	Itotal = calcCharacteristicPoint(string_array, workspace, Vpan, Vpan, TANGENT_CONTINUATION, zone, solved);
+	last_voltage = Vpan;
+	last_zone = zone;
+	last_solved = solved;
+
+	// dI/dV of the solved point
+	double dIdV;
+	if (solve_method == NESTED_NEWTON_METHOD){
+		double sumdVdI = 0.0;
+		for (int i = 0; i < number_strings; ++i)
+		{
+			sumdVdI += workspace.string_voltage_derivative[i];
+		}
+		dIdV = 1.0/sumdVdI;
+	} else {
+		// The total current follows the voltage of the cells in the increment vector
+		dIdV = workspace.tangent[workspace.total_cells-1];
+	}
+
+	return(Itotal + Vpan*dIdV);
+}
+
+void SolarSolver::findCharacteristicBreakpoints(double start_v, double end_v, vector<double> &voltages)
+{
+	voltages.clear();
+
+	// Coarse grid
+	for (int k = 0; k <= ADAPTIVE_INITIAL_POINTS_REF; ++k)
+	{
+		voltages.push_back(start_v + (end_v - start_v)*k/ADAPTIVE_INITIAL_POINTS_REF);
+	}
+
+	// Limits where the distribution of current (external limits) or voltage (internal limits, relative to the external one) changes
+	for (size_t k = 0; k < panel_vector.size(); ++k)
+	{
+		double vLim = panel_vector[k].sum_same_i_shortcut_group.limit_voltage;
+		voltages.push_back(vLim);
+		for (int g = panel_vector[k].first_group; g < panel_vector[k].first_group + panel_vector[k].number_groups; ++g)
+		{
+			voltages.push_back(vLim + panel_groups[g].sum_same_i_shortcut_and_v_breakdown_group.limit_voltage);
+		}
+	}
+
+	// Only the limits inside the range are kept, sorted and separated at least by the minimum step
+	sort(voltages.begin(), voltages.end());
+	vector <double> selected;
+	for (size_t k = 0; k < voltages.size(); ++k)
+	{
+		if (voltages[k] < start_v || voltages[k] > end_v) continue;
+		if (!selected.empty() && voltages[k] - selected.back() < ADAPTIVE_MIN_STEP_REF) continue;
+		selected.push_back(voltages[k]);
+	}
+	voltages = selected;
+}
+
+void SolarSolver::findEquivalentStrings(vector<int> &representatives, vector<int> &weights)
+{
+	representatives.clear();
+	weights.clear();
+
+	// Key: bypass diode, number of cells and every class of equivalent cells (irradiance, temperature and weight), sorted
+	map <vector<double>, int> characteristics;
+	for (int k = 0; k < number_strings; ++k)
+	{
+		solar_string &st = string_array[k];
+		vector <double> key;
+		vector <vector<double>> classes;
+		for (size_t c = 0; c < st.equivalent_cells_index.size(); ++c)
+		{
+			SolarCell &cell = st.cells_array[st.equivalent_cells_index[c]];
+			classes.push_back({cell.getIrradiance(), cell.getTemperatureCell(), (double)st.equivalent_cells_weight[c]});
+		}
+		sort(classes.begin(), classes.end());
+		key.push_back(st.getWithDiode());
+		key.push_back(st.string_size);
+		for (size_t c = 0; c < classes.size(); ++c)
+		{
+			key.insert(key.end(), classes[c].begin(), classes[c].end());
+		}
+
+		map<vector<double>, int>::iterator it = characteristics.find(key);
+		if (it == characteristics.end())
+		{
+			characteristics[key] = representatives.size();
+			representatives.push_back(k);
+			weights.push_back(1);
+		}
+		else
+		{
+			weights[it->second] += 1;
+		}
+	}
+}
+
+void SolarSolver::calcStringVoltages(vector<solar_string> &strings, const vector<double> &currents, vector<vector<double>> &voltages)
+{
+	int numb_strings = strings.size();
+	int numb_parts = number_threads < numb_strings ? number_threads : numb_strings;
+	voltages.resize(numb_strings);
+
+	// The strings are independent: every one is solved for every current, in increasing order
+	auto solveStrings = [&strings, &currents, &voltages](int first, int last)
+	{
+		for (int s = first; s < last; ++s)
+		{
+			voltages[s].resize(currents.size());
+			double Icells = currents.empty() ? 0.0 : currents[0];
+			double dVdI;
+			for (size_t k = 0; k < currents.size(); ++k)
+			{
+				voltages[s][k] = strings[s].calcVoltageForTotalCurrent(currents[k], Icells, dVdI);
+			}
+		}
+	};
+
+	if (numb_parts <= 1){
+		solveStrings(0, numb_strings);
+		return;
+	}
+
+	vector <std::thread> threads;
+	vector <std::exception_ptr> errors(numb_parts);
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		int first = (long)numb_strings*t/numb_parts;
+		int last = (long)numb_strings*(t+1)/numb_parts;
+		threads.push_back(std::thread([&solveStrings, &errors, t, first, last]()
+		{
+			try
+			{
+				solveStrings(first, last);
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+			}
+		}));
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		threads[t].join();
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		if (errors[t]){
+			std::rethrow_exception(errors[t]);
+		}
+	}
+}
+
+void SolarSolver::calcCharacteristicPoints(const vector<double> &voltages, vector<double> &currents, ContinuationType cont)
+{
+	int numb_points = voltages.size();
+	int numb_parts = number_threads < numb_points ? number_threads : numb_points;
+	currents.assign(numb_points, 0.0);
+
+	if (numb_parts <= 1){
+		// Working zone and result of the previous point (continuation)
+		int zone = -1;
+		bool solved = false;
+		for (int k = 0; k < numb_points; ++k)
+		{
+			currents[k] = calcCharacteristicPoint(string_array, workspace, voltages[k],
+					k > 0 ? voltages[k-1] : voltages[k], cont, zone, solved);
+		}
+		if (numb_points > 0){
+			last_voltage = voltages[numb_points-1];
+			last_zone = zone;
+			last_solved = solved;
+		}
+		return;
+	}
+
+	vector <std::thread> threads;
+	vector <std::exception_ptr> errors(numb_parts);
+
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		// Consecutive points are solved by the same thread
+		int first = (long)numb_points*t/numb_parts;
+		int last = (long)numb_points*(t+1)/numb_parts;
+
+		threads.push_back(std::thread([this, &voltages, &currents, &errors, cont, t, first, last]()
+		{
+			try
+			{
+				// Private copy of the state of every cell and of the memory of the solver
+				vector <solar_string> strings(string_array, string_array + number_strings);
+				SolverWorkspace ws = workspace;
+
+				int zone = -1;
+				bool solved = false;
+				for (int k = first; k < last; ++k)
+				{
+					currents[k] = calcCharacteristicPoint(strings.data(), ws, voltages[k],
+							k > first ? voltages[k-1] : voltages[k], cont, zone, solved);
+				}
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+			}
+		}));
+	}
+
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		threads[t].join();
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		if (errors[t]){
+			std::rethrow_exception(errors[t]);
+		}
+	}
+}
+
+double SolarSolver::calcCharacteristicPoint(solar_string *st, SolverWorkspace &ws, double Vpan, double Vprev, ContinuationType cont, int &zone, bool &solved)
+{
+	// Vector to store the voltage of every string
+	vector <double> &voltVector = ws.string_voltages;
+
+	double Itotal;
+	int new_zone = findWorkingZone(Vpan);
+
+	// The previous solution is only a good estimate when the same groups of cells are in breakdown
+	bool warm_start = cont != NO_CONTINUATION && solved && new_zone == zone;
+
+	zone = new_zone;
+	solved = false;
+
+	while (true)
+	{
+		if (warm_start){
+			Itotal = (solve_method == NESTED_NEWTON_METHOD) ? ws.nested_state[number_strings]
+					: ws.state[ws.total_cells];
+			predictState(Vpan, Vpan - Vprev, cont, ws);
+		} else {
+			// Initialization of the (recycled) voltVector
+			for (size_t i = 0; i < voltVector.size(); ++i)
+			{
+				voltVector[i] = 0.0;
+			}
+			// Assignment of currents and voltages to every string
+			Itotal = findTotalCurrent(Vpan);
+			assignStringVoltages(Vpan, voltVector);
+			// Calculation of the initial approximation
+			for (int k = 0; k < number_strings; ++k)
+			{
+				st[k].findInitialState(Itotal, voltVector[k]);
+			}
+		}
+
+		// Iterative method is called to solve every string. An error from the estimate by groups reaches the caller,
+		// unless it is only reported (file-based methods)
+		try
+		{
+			Itotal = calcNewtonRaphson(st, Vpan, ws, warm_start);
+			solved = std::isfinite(Itotal) && ws.residual_norm <= epsilon;
+			if (solved && cont == TANGENT_CONTINUATION && solve_method == FULL_NEWTON_METHOD){
+				calcTangent(st, ws);
+			}
+			if (!solved && !warm_start && report_point_errors){
+				std::cout << "The iterative method did not converge for "<< Vpan << " volts." << endl;
+			}
+		}
+		catch(std::exception& err)
+		{
+			solved = false;
+			if (!warm_start && !report_point_errors){
+				throw;
+			}
+			if (!warm_start){
+				std::cout << "Error when computing the iterative method for "<< Vpan << " volts: " << err.what() << endl;
+			}
+		}
+		catch(...)
+		{
+			solved = false;
+			if (!warm_start && !report_point_errors){
+				throw;
+			}
+			if (!warm_start){
+				std::cout << "Error when computing the iterative method for "<< Vpan << " volts." << endl;
+			}
+		}
+
+		// If the previous solution was not a good estimate, the point is solved again from the estimate by groups
+		if (solved || !warm_start) break;
+		warm_start = false;
+	}
+
+	// A point that did not converge is not a point of the characteristic
+	if (!solved){
+		Itotal = NAN;
+	}
+	return(Itotal);
+}
+
+void SolarSolver::calcState(std::string output_path, double Vpan)
+{
+	// A point where the iterative method fails is reported and the rest are still written
+	report_point_errors = true;
+	try
+	{
+		PanelState state = calcState(Vpan);
+
+		// Starts the printing process
+		ofstream arx;
+
+		std::string output_file = output_path;
+		arx.open(output_path, ios::out);
+		if (!arx){
+			cout << "Cannot open the output file.";
+		}
+
+		for (int k = 0; k < number_strings; ++k){
+			arx << "Idiode(" << k << ") = " << state.diode_currents[k] << " A" << endl;
+		}
 
 		arx << endl << endl;
 
 		arx << "String" << "," << "Cell" << "," << "Irrad." << "," << "Temper." << "," << "Curr. (A)" << "," << "Volt. (V)" << endl;
-		for (int k = 0; k < number_strings; ++k){
-			for (int j = 0; j < string_array[k].string_size; ++j){
-				arx << k << "," << string_array[k].cells_array[j].getIndex() << ","
-						<< string_array[k].cells_array[j].getIrradiance() << ","
-						<< string_array[k].cells_array[j].getTemperatureCell();
-				arx << "," << string_array[k].cells_array[j].getCurrentCell() << ","
-						<< string_array[k].cells_array[j].getVoltageCell() << endl;
-			}
+		for (uword r = 0; r < state.cells.n_rows; ++r){
+			arx << state.cells(r,0) << "," << state.cells(r,1) << ","
+					<< state.cells(r,2) << ","
+					<< state.cells(r,3);
+			arx << "," << state.cells(r,4) << ","
+					<< state.cells(r,5) << endl;
 		}
 	}
+	catch(std::runtime_error& err)
+	{
+		std::cout << "Error when computing the state: " << err.what() << endl;
+	}
 	catch(...)
 	{
 		std::cout << "Error when computing the state." << endl;
 	}
+	report_point_errors = false;
+}
+
+PanelState SolarSolver::calcState(double Vpan)
+{
+	PanelState state;
+	state.voltage = Vpan;
+
+	state.current = calcWorkingPoint(Vpan, state.solved);
+
+	// Every cell takes the state of the representative cell of its class
+	int total_cells = 0;
+	for (int k = 0; k < number_strings; ++k)
+	{
+		string_array[k].expandEquivalentCells();
+		total_cells += string_array[k].string_size;
+	}
+
+	state.diode_currents.resize(number_strings);
+	state.cells.set_size(total_cells, 6);
+	int r = 0;
+	for (int k = 0; k < number_strings; ++k){
+		state.diode_currents[k] = string_array[k].diode_bypass.getCurrentDiode();
+		for (int j = 0; j < string_array[k].string_size; ++j, ++r){
+			state.cells(r,0) = k;
+			state.cells(r,1) = string_array[k].cells_array[j].getIndex();
+			state.cells(r,2) = string_array[k].cells_array[j].getIrradiance();
+			state.cells(r,3) = string_array[k].cells_array[j].getTemperatureCell();
+			state.cells(r,4) = string_array[k].cells_array[j].getCurrentCell();
+			state.cells(r,5) = string_array[k].cells_array[j].getVoltageCell();
+		}
+	}
+
+	return(state);
+}
+
+void SolarSolver::setCellConditions(int string, int cell, double G, double Tc)
+{
+	CellConditions change;
+	change.string = string;
+	change.cell = cell;
+	change.irradiance = G;
+	change.temperature = Tc;
+	setCellConditions(vector<CellConditions>(1, change));
+}
+
+void SolarSolver::setCellConditions(const vector<CellConditions> &changes)
+{
+	// The positions are checked before any cell changes
+	for (size_t c = 0; c < changes.size(); ++c)
+	{
+		if (changes[c].string < 0 || changes[c].string >= number_strings
+				|| changes[c].cell < 0 || changes[c].cell >= string_array[changes[c].string].string_size)
+		{
+			throw std::runtime_error("Error in the position of the cell to change.");
+		}
+	}
+
+	// Strings with a changed cell. Before the change, every cell takes the working point of its class,
+	// since the classes of equivalent cells of the string can change
+	vector <bool> modified(number_strings, false);
+	for (size_t c = 0; c < changes.size(); ++c)
+	{
+		int k = changes[c].string;
+		if (!modified[k])
+		{
+			string_array[k].expandEquivalentCells();
+			modified[k] = true;
+		}
+		string_array[k].setCellConditions(changes[c].cell, changes[c].irradiance, changes[c].temperature);
+	}
+
+	// Only the modified strings find their groups again, and only the zones of panel_vector from the first one with
+	// a group of them are built again
+	bool same_classes = true;
+	for (int k = 0; k < number_strings; ++k)
+	{
+		if (modified[k])
+		{
+			size_t numb_classes = string_array[k].equivalent_cells_index.size();
+			string_array[k].updateGroups();
+			findStringGroups(k);
+			same_classes = same_classes && numb_classes == string_array[k].equivalent_cells_index.size();
+		}
+	}
+	updatePanelVector(modified);
+
+	// The workspace takes the last working point of the cells as its state. If the number of classes of equivalent
+	// cells of every string is the same, only the variables of the modified strings change. Otherwise it is sized again
+	if (same_classes)
+	{
+		int relatiu = 0;
+		for (int k = 0; k < number_strings; ++k)
+		{
+			solar_string &st = string_array[k];
+			if (modified[k])
+			{
+				for (size_t j = 0; j < st.equivalent_cells_index.size(); ++j)
+				{
+					SolarCell &cell = st.cells_array[st.equivalent_cells_index[j]];
+					workspace.cell_weight[relatiu+j] = st.equivalent_cells_weight[j];
+					workspace.cells.setCell(relatiu+j, cell);
+					workspace.state[relatiu+j] = cell.getVoltageCell();
+				}
+				workspace.state[workspace.total_cells+1+k] = st.cells_array[0].getCurrentCell();
+				workspace.nested_state[k] = st.cells_array[0].getCurrentCell();
+			}
+			relatiu += st.equivalent_cells_index.size();
+		}
+		// The weights of the cells are part of the terms of the sparse jacobian matrix
+		if (linear_solver == SPARSE_SOLVER){
+			initSparsePattern(workspace);
+		}
+	}
+	else
+	{
+		initWorkspace(workspace);
+		loadInitialValues(string_array, number_strings, workspace.state.data());
+		for (int k = 0; k < number_strings; ++k)
+		{
+			workspace.nested_state[k] = string_array[k].cells_array[0].getCurrentCell();
+		}
+		workspace.nested_state[number_strings] = workspace.state[workspace.total_cells];
+	}
+	// The limits of the working zones can move
+	last_zone = findWorkingZone(last_voltage);
+}
+
+void SolarSolver :: initWorkspace (SolverWorkspace &ws)
+{
+	// The variables are the voltage of every class of equivalent cells, the currents of every string and the total current
+	ws.number_strings = number_strings;
+	ws.total_cells = 0;
+	for (int i=0; i<number_strings; i++)
+	{
+		ws.total_cells += string_array[i].equivalent_cells_index.size();
+	}
+	ws.dimension = ws.total_cells + number_strings + 1;
+
+	// Number of cells represented by every variable
+	ws.cell_weight.resize(ws.total_cells);
+	int relatiu = 0;
+	for (int i=0; i<number_strings; i++)
+	{
+		for (size_t j=0; j<string_array[i].equivalent_cells_weight.size(); j++)
+		{
+			ws.cell_weight[relatiu+j] = string_array[i].equivalent_cells_weight[j];
+		}
+		relatiu += string_array[i].equivalent_cells_weight.size();
+	}
+
+	ws.residual_norm = 0.0;
+	ws.state.assign(ws.dimension, 0.0);
+	ws.functions.assign(ws.dimension-1, 0.0);
+	ws.increment.assign(ws.dimension-1, 0.0);
+	ws.tangent.assign(ws.dimension-1, 0.0);
+	ws.cell_derivative_voltage.assign(ws.total_cells, 0.0);
+	ws.cell_derivative_current.assign(ws.total_cells, 0.0);
+	ws.diode_derivative_voltage.assign(number_strings, 0.0);
+	ws.string_alpha.assign(number_strings, 0.0);
+	ws.string_beta.assign(number_strings, 0.0);
+	ws.string_p.assign(number_strings, 0.0);
+	ws.string_q.assign(number_strings, 0.0);
+	ws.string_voltages.assign(number_strings, 0.0);
+	ws.string_voltage_derivative.assign(number_strings, 0.0);
+	ws.nested_state.assign(number_strings+1, 0.0);
+	ws.nested_functions.assign(number_strings+1, 0.0);
+
+	// Parameters of the representative cells, stored by fields for the vectorized evaluation
+	ws.cells.resize(ws.total_cells);
+	relatiu = 0;
+	for (int i=0; i<number_strings; i++)
+	{
+		for (size_t j=0; j<string_array[i].equivalent_cells_index.size(); j++)
+		{
+			ws.cells.setCell(relatiu+j, string_array[i].cells_array[string_array[i].equivalent_cells_index[j]]);
+		}
+		relatiu += string_array[i].equivalent_cells_index.size();
+	}
+
+	// The dense jacobian matrix is only stored when it is going to be used
+	if (linear_solver == ARMADILLO_DENSE_SOLVER){
+		ws.jacobian.assign((ws.dimension-1)*(ws.dimension-1), 0.0);
+	} else {
+		vector<double>().swap(ws.jacobian);
+	}
+
+	// The same happens with the pattern of the sparse jacobian matrix
+	if (linear_solver == SPARSE_SOLVER){
+		initSparsePattern(ws);
+	} else {
+		ws.sparse_jacobian.reset();
+		vector<int>().swap(ws.sparse_term_type);
+		vector<int>().swap(ws.sparse_term_index);
+		vector<double>().swap(ws.sparse_term_weight);
+	}
 }
 
+void SolarSolver :: initSparsePattern (SolverWorkspace &ws)
+{
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+	int last = totalCells-1;
+	int lastString = nS-1;
+
+	/*
+	 * The variables (columns) are the voltage of every cell but the last one, the total current and the current of every string.
+	 * The equations (rows) are the function of every cell and the function of every string.
+	 * The terms are added column by column, with increasing rows, so they are already sorted as the sparse matrix needs.
+	 */
+	umat locations;
+	int nnz = 0;
+	for (int pass = 0; pass < 2; ++pass){
+		int relatiu = 0;
+		for (int i=0; i<nS; i++){
+			for (size_t j=0; j<string_array[i].equivalent_cells_index.size(); j++){
+				int k = relatiu+j;
+				if (k == last) break;
+				if (pass == 1){
+					locations(0,nnz) = k;
+					locations(1,nnz) = k;
+					ws.sparse_term_type[nnz] = TERM_CELL_VOLTAGE;
+					ws.sparse_term_index[nnz] = k;
+					ws.sparse_term_weight[nnz] = 1.0;
+					locations(0,nnz+1) = last;
+					locations(1,nnz+1) = k;
+					ws.sparse_term_type[nnz+1] = TERM_LAST_CELL_VOLTAGE;
+					ws.sparse_term_index[nnz+1] = last;
+					ws.sparse_term_weight[nnz+1] = ws.cell_weight[k]/ws.cell_weight[last];
+				}
+				nnz += 2;
+				// The string function of the last string depends on the voltage of all the cells of the other strings
+				if (i != lastString){
+					if (pass == 1){
+						locations(0,nnz) = totalCells+i;
+						locations(1,nnz) = k;
+						ws.sparse_term_type[nnz] = TERM_DIODE_VOLTAGE;
+						ws.sparse_term_index[nnz] = i;
+						ws.sparse_term_weight[nnz] = ws.cell_weight[k];
+						locations(0,nnz+1) = totalCells+lastString;
+						locations(1,nnz+1) = k;
+						ws.sparse_term_type[nnz+1] = TERM_LAST_DIODE_VOLTAGE;
+						ws.sparse_term_index[nnz+1] = lastString;
+						ws.sparse_term_weight[nnz+1] = ws.cell_weight[k];
+					}
+					nnz += 2;
+				}
+			}
+			relatiu += string_array[i].equivalent_cells_index.size();
+		}
+		// Column of the total current
+		for (int i=0; i<nS; i++){
+			if (pass == 1){
+				locations(0,nnz) = totalCells+i;
+				locations(1,nnz) = last;
+				ws.sparse_term_type[nnz] = TERM_TOTAL_CURRENT;
+				ws.sparse_term_index[nnz] = i;
+				ws.sparse_term_weight[nnz] = 1.0;
+			}
+			nnz += 1;
+		}
+		// Columns of the current of every string
+		relatiu = 0;
+		for (int i=0; i<nS; i++){
+			for (size_t j=0; j<string_array[i].equivalent_cells_index.size(); j++){
+				if (pass == 1){
+					locations(0,nnz) = relatiu+j;
+					locations(1,nnz) = totalCells+i;
+					ws.sparse_term_type[nnz] = TERM_CELL_CURRENT;
+					ws.sparse_term_index[nnz] = relatiu+j;
+					ws.sparse_term_weight[nnz] = 1.0;
+				}
+				nnz += 1;
+			}
+			if (pass == 1){
+				locations(0,nnz) = totalCells+i;
+				locations(1,nnz) = totalCells+i;
+				ws.sparse_term_type[nnz] = TERM_STRING_CURRENT;
+				ws.sparse_term_index[nnz] = i;
+				ws.sparse_term_weight[nnz] = 1.0;
+			}
+			nnz += 1;
+			relatiu += string_array[i].equivalent_cells_index.size();
+		}
+		// The first pass only counts the non-zero terms
+		if (pass == 0){
+			locations.set_size(2, nnz);
+			ws.sparse_term_type.assign(nnz, 0);
+			ws.sparse_term_index.assign(nnz, 0);
+			ws.sparse_term_weight.assign(nnz, 0.0);
+			nnz = 0;
+		}
+	}
+
+	// The matrix is built only once. The zeros are kept, so its values follow the order of the terms and can be refilled
+	ws.sparse_jacobian = SpMat<double>(locations, Col<double>(nnz, fill::zeros), ws.dimension-1, ws.dimension-1, false, false);
+}
 
+void SolarSolver :: fillSparseJacobian (SolverWorkspace &ws)
+{
+	const double *dfdV = ws.cell_derivative_voltage.data();
+	const double *dfdI = ws.cell_derivative_current.data();
+	const double *dIddV = ws.diode_derivative_voltage.data();
+	const double *weight = ws.sparse_term_weight.data();
+	// The values are written in place, which is safe as long as no element of the matrix is accessed through operator()
+	double *values = const_cast<double*>(ws.sparse_jacobian.values);
+
+	for (size_t n = 0; n < ws.sparse_term_type.size(); ++n){
+		int index = ws.sparse_term_index[n];
+		switch (ws.sparse_term_type[n]){
+			case TERM_CELL_VOLTAGE:
+				values[n] = dfdV[index];
+				break;
+			case TERM_LAST_CELL_VOLTAGE:
+				values[n] = -weight[n]*dfdV[index];
+				break;
+			case TERM_CELL_CURRENT:
+				values[n] = dfdI[index];
+				break;
+			case TERM_DIODE_VOLTAGE:
+				values[n] = weight[n]*dIddV[index];
+				break;
+			case TERM_LAST_DIODE_VOLTAGE:
+				values[n] = -weight[n]*dIddV[index];
+				break;
+			case TERM_TOTAL_CURRENT:
+				values[n] = 1;
+				break;
+			case TERM_STRING_CURRENT:
+				values[n] = -1;
+				break;
+		}
+	}
+}
 
-double SolarSolver :: calcNewtonRaphson (solar_string *st, double Vp, int _dimX, int nS)
+double SolarSolver :: calcNewtonRaphson (solar_string *st, double Vp, SolverWorkspace &ws, bool warm_start)
 {
+	if (solve_method == NESTED_NEWTON_METHOD){
+		return(calcNestedNewtonRaphson(st, Vp, ws, warm_start));
+	}
+
+	int _dimX = ws.dimension;
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+
+	// The armadillo objects use the memory of the workspace (no copies or allocations are made)
 	// Functions matrix (column)
-	Col<double> Fv = zeros(_dimX-1);
-	// Initial state matrix (column)
-	Col<double> Xv = zeros(_dimX);
-	// Jacobian matrix
-	Mat<double> Jv = zeros(_dimX-1,_dimX-1);
+	Col<double> Fv(ws.functions.data(), _dimX-1, false, true);
 	// Solution: new state (column)
-	Col<double> Gv = zeros(_dimX-1);
+	Col<double> Gv(ws.increment.data(), _dimX-1, false, true);
 
+	// State vector
+	double *Xv = ws.state.data();
+	// Non-zero terms of the jacobian matrix
+	double *dfdV = ws.cell_derivative_voltage.data();
+	double *dfdI = ws.cell_derivative_current.data();
+	double *dIddV = ws.diode_derivative_voltage.data();
+	// Number of cells represented by every cell variable
+	const double *weight = ws.cell_weight.data();
 
 	double It;
-	int totalCells = _dimX-nS-1;
-	int *indexs = new int[totalCells];
 
-	// Initial values are loaded
-	Xv = loadInitialValues(st, _dimX, nS);
+	// Initial values are loaded, unless the state of the workspace is already the estimate
+	if (!warm_start){
+		loadInitialValues(st, nS, Xv);
+	}
+	Gv.zeros();
 
 	double nm;
 
@@ -682,170 +2377,386 @@ double SolarSolver :: calcNewtonRaphson (solar_string *st, double Vp, int _dimX,
 
 	do
 	{
-		// Starts building the jacobian matrix
-		double **J = new double *[_dimX-1];
-		for (int i=0; i<_dimX-1; i++){
-			J[i] = new double [_dimX];
-		}
-
-		for (int i=0; i<_dimX-1; i++){
-			for (int j=0; j<_dimX; j++){
-				J[i][j] = 0;
-			}
-		}
-
 		int relatiu1 = 0;
-		It = Xv(_dimX-nS-1);
+		It = Xv[totalCells];
 		double Id = 0.0;
 
-		// Updates the string of arrays with the initial state vector
+		// Updates the string of arrays with the initial state vector. Only the representative cells are updated
 		for (int i=0; i<nS; i++){
-			for (int j=0; j<st[i].string_size; j++){
-				st[i].cells_array[j].setCurrentCell(Xv(_dimX-nS+i));
-				st[i].cells_array[j].setVoltageCell(Xv(relatiu1+j));
+			for (size_t j=0; j<st[i].equivalent_cells_index.size(); j++){
+				st[i].cells_array[st[i].equivalent_cells_index[j]].setCurrentCell(Xv[totalCells+1+i]);
+				st[i].cells_array[st[i].equivalent_cells_index[j]].setVoltageCell(Xv[relatiu1+j]);
+				ws.cells.current[relatiu1+j] = Xv[totalCells+1+i];
+				ws.cells.voltage[relatiu1+j] = Xv[relatiu1+j];
 			}
 			st[i].setSumVoltageAllCells();
 			Id = st[i].diode_bypass.calcFunctionD(-st[i].getSumVoltageAllCells());
 			st[i].diode_bypass.setCurrentDiode(Id);
-			relatiu1 = relatiu1 + st[i].string_size;
+			relatiu1 = relatiu1 + st[i].equivalent_cells_index.size();
 		}
 
 		relatiu1 = 0;
+		nm = 0.0;
 
-		// Fills the Functions vector
+		// The function and both derivatives of every representative cell of the panel are calculated at once
+		ws.cells.calcFunctionCAndDerivatives(Fv.memptr(), dfdV, dfdI);
+
+		// Fills the Functions vector and the non-zero terms of the jacobian matrix
 		for (int i=0; i<nS; i++){
-			for (int j=0; j < st[i].string_size; j++){
-				Fv(relatiu1+j)=st[i].cells_array[j].calcFunctionC();
+			for (size_t j=0; j < st[i].equivalent_cells_index.size(); j++){
+				// The function of a representative cell counts once for every cell of its class
+				nm += weight[relatiu1+j]*Fv(relatiu1+j)*Fv(relatiu1+j);
 			}
-			Fv(_dimX-nS-1+i) = It - st[i].cells_array[0].getCurrentCell()
+			Fv(totalCells+i) = It - st[i].cells_array[0].getCurrentCell()
 					-st[i].getWithDiode()*st[i].diode_bypass.getCurrentDiode();
+			dIddV[i] = st[i].getWithDiode()
+					* st[i].diode_bypass.calcFuntionDiodeDerivativeRespectVoltage(-st[i].getSumVoltageAllCells());
+			nm += Fv(totalCells+i)*Fv(totalCells+i);
 			// next string
-			relatiu1 = relatiu1 + st[i].string_size;
+			relatiu1 = relatiu1 + st[i].equivalent_cells_index.size();
 		}
 
-		relatiu1 = 0;
-		int relatiu2 = _dimX-nS-1;
-		// Fills the jacobian matrix (initialy a 2D array, not the matrix)
+		// Calculates the norm
+		nm = sqrt(nm);
+
+		if (nm <= epsilon){
+			break;
+		}
+
+		// Finds the increment with the linear solver in use
+		solveLinearSystem(st, ws);
+
+		// X_2 = X_1 + Jx(-F)
+		for (int j=0; j<_dimX-1;j++){
+			if (j<totalCells-1){
+				Xv[j]+=Gv(j);
+			} else {
+				Xv[j+1]+=Gv(j);
+			}
+		}
+
+		double sumX = 0.0;
+		for (int i=0; i<totalCells-1; i++){
+			sumX = sumX + weight[i]*Xv[i];
+		}
+
+		Xv[totalCells-1] = (Vp - sumX)/weight[totalCells-1];
+
+		m += 1;
+
+	// Condition of convergence, or the maximum number of iterations is reached (then residual_norm is above epsilon)
+	}while(nm > epsilon && m < max_iterations);
+
+	ws.residual_norm = nm;
+	return(It);
+}
+
+void SolarSolver :: calcTangent (solar_string *st, SolverWorkspace &ws)
+{
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+
+	// Derivative of the functions respect the total voltage, through the voltage of the last cell
+	for (int j=0; j<ws.dimension-1; j++){
+		ws.functions[j] = 0.0;
+	}
+	ws.functions[totalCells-1] = ws.cell_derivative_voltage[totalCells-1]/ws.cell_weight[totalCells-1];
+	ws.functions[totalCells+nS-1] = ws.diode_derivative_voltage[nS-1];
+
+	// J*T = -dF/dVp
+	solveLinearSystem(st, ws);
+	ws.tangent = ws.increment;
+}
+
+void SolarSolver :: predictState (double Vp, double dV, ContinuationType cont, SolverWorkspace &ws)
+{
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+
+	if (solve_method == NESTED_NEWTON_METHOD){
+		// The total voltage is the sum of the voltage of the strings, so dIt/dVp = 1/sum(dV/dI)
+		double sumdVdI = 0.0;
+		for (int i=0; i<nS; i++){
+			sumdVdI += ws.string_voltage_derivative[i];
+		}
+		if (cont == TANGENT_CONTINUATION && sumdVdI != 0.0){
+			ws.nested_state[nS] += dV/sumdVdI;
+		}
+		return;
+	}
+
+	double *Xv = ws.state.data();
+	const double *weight = ws.cell_weight.data();
+
+	if (cont == TANGENT_CONTINUATION){
+		for (int j=0; j<ws.dimension-1; j++){
+			if (j<totalCells-1){
+				Xv[j] += dV*ws.tangent[j];
+			} else {
+				Xv[j+1] += dV*ws.tangent[j];
+			}
+		}
+	}
+
+	// The last cell takes the rest of the new total voltage
+	double sumX = 0.0;
+	for (int i=0; i<totalCells-1; i++){
+		sumX = sumX + weight[i]*Xv[i];
+	}
+	Xv[totalCells-1] = (Vp - sumX)/weight[totalCells-1];
+}
+
+void SolarSolver :: solveLinearSystem (solar_string *st, SolverWorkspace &ws)
+{
+	int _dimX = ws.dimension;
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+
+	// The armadillo objects use the memory of the workspace (no copies or allocations are made)
+	Col<double> Fv(ws.functions.data(), _dimX-1, false, true);
+	Col<double> Gv(ws.increment.data(), _dimX-1, false, true);
+
+	const double *dfdV = ws.cell_derivative_voltage.data();
+	const double *dfdI = ws.cell_derivative_current.data();
+	const double *dIddV = ws.diode_derivative_voltage.data();
+	const double *weight = ws.cell_weight.data();
+
+	if (linear_solver == BORDERED_BLOCK_SOLVER){
+		// Solve the bordered-block system to find the increment
+		solveBorderedBlock(st, ws);
+	} else if (linear_solver == SPARSE_SOLVER){
+		// Only the values of the sparse jacobian matrix change; its pattern was set when the solver was selected
+		fillSparseJacobian(ws);
+		const SpMat<double> &Jv = ws.sparse_jacobian;
+
+		// Solve the sparse matrix equation to find the increment
+		// spsolve factorizes the matrix again in every iteration (the symbolic factorization is not kept by Armadillo)
+		// The iterative method can not continue without an increment, so the error is passed to the caller
+#if defined(ARMA_USE_SUPERLU)
+		bool status = spsolve(Gv,Jv,-Fv,"superlu");
+#else
+		bool status = spsolve(Gv,Jv,-Fv,"lapack");
+#endif
+		if (!status){
+			throw std::runtime_error("Error in Armadillo spsolve: solution not found.");
+		}
+	} else {
+		// Jacobian matrix
+		Mat<double> Jv(ws.jacobian.data(), _dimX-1, _dimX-1, false, true);
+		Jv.zeros();
+
+		// Fills the jacobian matrix
+		int relatiu1 = 0;
 		for (int i=0; i<nS; i++){
-			for (int j=0; j < st[i].string_size; j++){
-				J[relatiu1+j][relatiu1+j]=st[i].cells_array[j].calcFunctionCellDerivativeRespectVoltage();
-				J[relatiu1+j][relatiu2+i]=st[i].cells_array[j].calcFunctionCellDerivativeRespectCurrent();
-				indexs[relatiu1+j]=relatiu2+i;
+			for (size_t j=0; j < st[i].equivalent_cells_index.size(); j++){
+				Jv(relatiu1+j,relatiu1+j)=dfdV[relatiu1+j];
+				Jv(relatiu1+j,totalCells+i)=dfdI[relatiu1+j];
 			}
-			relatiu1 = relatiu1 + st[i].string_size;
+			relatiu1 = relatiu1 + st[i].equivalent_cells_index.size();
 		}
 
-		relatiu1 = _dimX-nS-1;
-		relatiu2 = 0;
+		int relatiu2 = 0;
 		for (int i=0; i<nS; i++){
-			for (int j=0; j<st[i].string_size; j++){
-				J[relatiu1+i][relatiu2+j]
-							  = st[i].getWithDiode()
-							  * st[i].diode_bypass.calcFuntionDiodeDerivativeRespectVoltage(-st[i].getSumVoltageAllCells());
+			for (size_t j=0; j<st[i].equivalent_cells_index.size(); j++){
+				Jv(totalCells+i,relatiu2+j) = dIddV[i]*weight[relatiu2+j];
 			}
 			// Fixes the last diode
 			if (i==(nS-1)){
-					for(int j=0; j<_dimX-nS-1; j++){
-						J[_dimX-2][j] = J[_dimX-2][j] - J[_dimX-2][_dimX-nS-2];
+					for(int j=0; j<totalCells; j++){
+						Jv(_dimX-2,j) = Jv(_dimX-2,j) - dIddV[i]*weight[j];
 					}
 			}
-			J[relatiu1+i][relatiu1-1]=1;
-			J[relatiu1+i][relatiu1+i]=-1;
-			relatiu2+=st[i].string_size;
+			Jv(totalCells+i,totalCells-1)=1;
+			Jv(totalCells+i,totalCells+i)=-1;
+			relatiu2+=st[i].equivalent_cells_index.size();
 		}
 
 		// Loop the replace the voltage of the last cell by the difference of the total voltage and the rest of cells
-		for(int i=0; i<_dimX-nS-1; i++){
-			J[_dimX-nS-2][i] = J[_dimX-nS-2][i] - J[_dimX-nS-2][_dimX-nS-2];
-		}
-
-		// Calculates the norm
-		nm = norm(Fv,2);
-
-		if (nm <= epsilon){
-			break;
+		for(int i=0; i<totalCells-1; i++){
+			Jv(totalCells-1,i) = -dfdV[totalCells-1]*weight[i]/weight[totalCells-1];
 		}
+		Jv(totalCells-1,totalCells-1) = 0;
 
-		for (int i = 0; i < _dimX-1; i++){
-			J[i][_dimX-1] = -Fv(i);
+		// Solve the matrix equation to find the increment
+		// The iterative method can not continue without an increment, so the error is passed to the caller
+		if (!solve(Gv,Jv,-Fv)){
+			throw std::runtime_error("Error in Armadillo solve: solution not found.");
 		}
+	}
+}
 
-		// Fills the actual armadillo Jacobian matrix
-		for (int i=0; i<_dimX-1; i++){
-						for (int j=0; j<_dimX-1; j++){
-							Jv(i,j)=J[i][j];
-						}
-				}
+void SolarSolver :: solveBorderedBlock (solar_string *st, SolverWorkspace &ws)
+{
+	/*
+	 * Every cell equation but the last one only depends on its own voltage and on the current of its string:
+	 *   dfdV(k)*dV(k) + dfdI(k)*dI(s) = -F(k)  -->  dV(k) = a(k) + b(k)*dI(s)
+	 * Adding these expressions along every string (every variable counts once for every cell of its class of equivalent cells),
+	 * the sum of the voltage increments of string i is
+	 *   alpha(i) + beta(i)*dI(i)
+	 * The last cell is excluded, since its voltage has been replaced by the total voltage minus the rest of cells.
+	 */
+	int nS = ws.number_strings;
+	int totalCells = ws.total_cells;
+	int last = totalCells-1;
+	int lastString = nS-1;
+
+	const double *F = ws.functions.data();
+	const double *dfdV = ws.cell_derivative_voltage.data();
+	const double *dfdI = ws.cell_derivative_current.data();
+	const double *dIddV = ws.diode_derivative_voltage.data();
+	double *G = ws.increment.data();
+	const double *weight = ws.cell_weight.data();
+
+	double *alpha = ws.string_alpha.data();
+	double *beta = ws.string_beta.data();
+	double *p = ws.string_p.data();
+	double *q = ws.string_q.data();
 
-		double temp;
-		for (int i=0; i<_dimX; i++){
-			temp = J[_dimX-2][i];
-			J[_dimX-2][i] = J[_dimX-nS-2][i];
-			J[_dimX-nS-2][i] = temp;
+	int relatiu = 0;
+	for (int i=0; i<nS; i++){
+		alpha[i] = 0.0;
+		beta[i] = 0.0;
+		for (size_t j=0; j<st[i].equivalent_cells_index.size(); j++){
+			if (relatiu+j == (size_t)last) break;
+			alpha[i] -= weight[relatiu+j]*F[relatiu+j]/dfdV[relatiu+j];
+			beta[i] -= weight[relatiu+j]*dfdI[relatiu+j]/dfdV[relatiu+j];
 		}
+		relatiu += st[i].equivalent_cells_index.size();
+	}
+	/*
+	 * The equation of every string but the last one gives its current as a function of the total current:
+	 *   dIt - dI(i) + dIddV(i)*(alpha(i) + beta(i)*dI(i)) = -F(string i)  -->  dI(i) = p(i) + q(i)*dIt
+	 * Then the sum of the voltage increments of all these strings is P + Q*dIt
+	 */
+	double P = 0.0;
+	double Q = 0.0;
+	double denom;
+	for (int i=0; i<lastString; i++){
+		denom = dIddV[i]*beta[i] - 1;
+		p[i] = (-F[totalCells+i] - dIddV[i]*alpha[i])/denom;
+		q[i] = -1/denom;
+		P += alpha[i] + beta[i]*p[i];
+		Q += beta[i]*q[i];
+	}
 
-		// Solve the matrix equation to find the increment
-		try
-		{
-			Gv = solve(Jv,-Fv);
-		}
-		catch(std::runtime_error& err)
-		{
-			std::cout << "Error in Armadillo solve. Runtime error: " << err.what() << endl;
-		}
-		catch(...)
-		{
-			std::cout << "Error in Armadillo solve" << endl;
-		}
+	/*
+	 * Only the equation of the last string and the equation of the last cell remain, with the total current
+	 * and the current of the last string as unknowns.
+	 */
+	double a11 = 1 - dIddV[lastString]*Q;
+	double a12 = -1;
+	double r1 = -F[totalCells+lastString] + dIddV[lastString]*P;
+	double dfdVlast = dfdV[last]/weight[last];
+	double a21 = -dfdVlast*Q;
+	double a22 = dfdI[last] - dfdVlast*beta[lastString];
+	double r2 = -F[last] + dfdVlast*(P + alpha[lastString]);
+
+	double det = a11*a22 - a12*a21;
+	double dIt = (r1*a22 - a12*r2)/det;
+	double dIlast = (a11*r2 - a21*r1)/det;
+
+	// Backward substitution
+	G[totalCells-1] = dIt;
+	G[totalCells+lastString] = dIlast;
+	for (int i=0; i<lastString; i++){
+		G[totalCells+i] = p[i] + q[i]*dIt;
+	}
 
-		// X_2 = X_1 + Jx(-F)
-		for (int j=0; j<_dimX-1;j++){
-			if (j<_dimX-nS-2){
-				Xv(j)+=Gv(j);
-			} else {
-				Xv(j+1)+=Gv(j);
-			}
+	relatiu = 0;
+	for (int i=0; i<nS; i++){
+		for (size_t j=0; j<st[i].equivalent_cells_index.size(); j++){
+			if (relatiu+j == (size_t)last) break;
+			G[relatiu+j] = -(F[relatiu+j] + dfdI[relatiu+j]*G[totalCells+i])/dfdV[relatiu+j];
 		}
+		relatiu += st[i].equivalent_cells_index.size();
+	}
+}
 
-		double sumX = 0.0;
-		for (int i=0; i<_dimX-nS-2; i++){
-			sumX = sumX + Xv(i);
+double SolarSolver :: calcNestedNewtonRaphson (solar_string *st, double Vp, SolverWorkspace &ws, bool warm_start)
+{
+	int nS = ws.number_strings;
+	// Current of every string followed by the total current
+	double *X = ws.nested_state.data();
+	double *F = ws.nested_functions.data();
+	double *dVdI = ws.string_voltage_derivative.data();
+
+	double lower = 0.0, upper = 0.0;
+	bool with_lower = false, with_upper = false;
+	double It, sumV, sumdVdI;
+	// The solve is not converged if no iteration is made
+	double nm = DBL_MAX;
+
+	// Initial values are loaded from the initial estimate of the cells, unless the workspace already contains the estimate
+	if (!warm_start){
+		for (int i=0; i<nS; i++){
+			X[i] = st[i].cells_array[0].getCurrentCell();
 		}
+		X[nS] = st[0].cells_array[0].getCurrentCell() + st[0].diode_bypass.getCurrentDiode();
+	}
+	It = X[nS];
 
-		Xv(_dimX-nS-2) = Vp - sumX;
+	for (int m=0; m<max_iterations; m++)
+	{
+		It = X[nS];
+		sumV = 0.0;
+		sumdVdI = 0.0;
+		nm = 0.0;
 
-		for (int i=0; i<_dimX-1; i++){
-			delete [] J[i];
+		// Inner method: every string is solved for the total current
+		for (int i=0; i<nS; i++){
+			sumV += st[i].calcVoltageForTotalCurrent(It, X[i], dVdI[i]);
+			sumdVdI += dVdI[i];
+			F[i] = It - X[i] - st[i].getWithDiode()*st[i].diode_bypass.getCurrentDiode();
+			nm += F[i]*F[i];
 		}
-		delete [] J;
+		F[nS] = sumV - Vp;
+		nm = sqrt(nm + F[nS]*F[nS]);
 
-		m += 1;
+		if (nm <= epsilon){
+			break;
+		}
 
-	// Condition of convergence
-	}while(nm > epsilon or m > max_iterations);
+		// The voltage decreases with the total current
+		if (F[nS] > 0){
+			lower = It;
+			with_lower = true;
+		}else{
+			upper = It;
+			with_upper = true;
+		}
 
-	delete [] indexs;
+		X[nS] = It - F[nS]/sumdVdI;
+		// Bisection when the Newton step leaves the bracket
+		if (with_lower && with_upper && !(X[nS] > lower && X[nS] < upper)){
+			X[nS] = 0.5*(lower+upper);
+		}
+	}
 
+	ws.residual_norm = nm;
 	return(It);
 }
 
-
 SolarSolver :: SolarSolver(SolarPanel &panel)
 {
+	string_array = NULL;
 	try
 	{
 		epsilon = EPSILON_REF;
 		max_iterations = MAX_ITERATIONS_REF;
+		linear_solver = ARMADILLO_DENSE_SOLVER;
+		solve_method = FULL_NEWTON_METHOD;
+		continuation = NO_CONTINUATION;
+		number_threads = NUMBER_THREADS_REF;
 		number_strings = panel.panel_size;
 		string_array = new solar_string[number_strings];
-
-		// The string objects are created from the info in the panel object
-		for (int k=0; k<number_strings; k++)
-		{
-			string_array[k].updateStringsData(panel.string_info[k], panel.cell_panel);
-		}
-
-		// If a certain knee voltage for the bypass diodes has been specified, then all the strings are updated
+		last_voltage = 0.0;
+		last_zone = -1;
+		last_solved = false;
+		zone_limits_decreasing = false;
+		report_point_errors = false;
+
+		// If a certain knee voltage for the bypass diodes has been specified, then all the strings are updated.
+		// It is set first, since the groups of every string depend on it (as in solar_string::updateGroups)
 		if(panel.voltage_knee_diode != 0)
 		{
 			for (int k=0; k<number_strings; k++)
@@ -853,8 +2764,21 @@ SolarSolver :: SolarSolver(SolarPanel &panel)
 				string_array[k].setVoltageDiode(panel.voltage_knee_diode);
 			}
 		}
+
+		// The string objects are created from the info in the panel object
+		for (int k=0; k<number_strings; k++)
+		{
+			string_array[k].updateStringsData(panel.string_info[k], panel.cell_panel);
+		}
 		// The vector is fulfilled and properly organized
+		string_groups.resize(number_strings);
+		for (int k=0; k<number_strings; k++)
+		{
+			findStringGroups(k);
+		}
 		generatePanelVector ();
+		// The memory used by the iterative method is reserved once
+		initWorkspace (workspace);
 	}
 	catch(...)
 	{
@@ -863,4 +2787,54 @@ SolarSolver :: SolarSolver(SolarPanel &panel)
 
 }
 
+SolarSolver :: SolarSolver(const SolarSolver &other)
+{
+	string_array = NULL;
+	*this = other;
+}
+
+SolarSolver& SolarSolver :: operator= (const SolarSolver &other)
+{
+	if (this == &other){
+		return (*this);
+	}
+
+	solar_string *new_strings = NULL;
+	if (other.string_array != NULL){
+		new_strings = new solar_string[other.number_strings];
+		for (int k = 0; k < other.number_strings; k++){
+			new_strings[k] = other.string_array[k];
+		}
+	}
+	delete [] string_array;
+	string_array = new_strings;
+
+	number_strings = other.number_strings;
+	panel_vector = other.panel_vector;
+	panel_groups = other.panel_groups;
+	panel_details = other.panel_details;
+	panel_order = other.panel_order;
+	zone_upper_voltages = other.zone_upper_voltages;
+	zone_lower_voltages = other.zone_lower_voltages;
+	zone_limits_decreasing = other.zone_limits_decreasing;
+	max_iterations = other.max_iterations;
+	epsilon = other.epsilon;
+	linear_solver = other.linear_solver;
+	solve_method = other.solve_method;
+	continuation = other.continuation;
+	workspace = other.workspace;
+	number_threads = other.number_threads;
+	string_groups = other.string_groups;
+	last_voltage = other.last_voltage;
+	last_zone = other.last_zone;
+	last_solved = other.last_solved;
+	report_point_errors = other.report_point_errors;
+	return (*this);
+}
+
+SolarSolver :: ~SolarSolver(void)
+{
+	delete[] string_array;
+}
+
 }
@@ -49,12 +49,102 @@
 #include <map>
 #include <vector>
 #include <list>
+#include <armadillo>
 #include "pv_panel.h"
 
 namespace stringarma{
 
 #define MAX_ITERATIONS_REF 50
 #define EPSILON_REF 0.01
+#define NUMBER_THREADS_REF 1
+#define ADAPTIVE_INITIAL_POINTS_REF 16
+#define ADAPTIVE_MIN_STEP_REF 0.01
+#define MPP_VOLTAGE_TOLERANCE_REF 0.01
+#define MPP_MAX_ITERATIONS_REF 20
+#define MPP_ZONE_POINTS_REF 7
+#define OPEN_CIRCUIT_TOLERANCE_REF 0.01
+#define OPEN_CIRCUIT_MAX_ITERATIONS_REF 30
+#define COMPOSITION_CURRENT_POINTS_REF 64
+#define COMPOSITION_MAX_POINTS_REF 8192
+#define COMPOSITION_MAX_EXTENSIONS_REF 30
+#define COMPOSITION_TOLERANCE_REF 0.0001
+#define ZONE_TABLE_MAX_VALUES_REF 2097152
+#define APPROXIMATION_CELL_POINTS_REF 64
+#define APPROXIMATION_CURRENT_POINTS_REF 1000
+#define APPROXIMATION_REVERSE_VOLTAGE_REF 1.0
+#define APPROXIMATION_BREAKDOWN_MARGIN_REF 1e-3
+#define APPROXIMATION_MAX_EXPONENT_REF 500.0
+
+/**
+ * Linear solvers available to compute the increment of every iteration of the Newton-Raphson method.
+ */
+enum LinearSolverType {
+	/// Builds the full jacobian matrix and solves it with the dense LU factorization of Armadillo (solve function).
+	ARMADILLO_DENSE_SOLVER,
+	/**
+	 * Exploits the bordered-block (arrow-shaped) structure of the jacobian matrix.
+	 * The voltage of every cell is eliminated through its diagonal term and only a 2x2 system remains for the total current
+	 * and the current of the last string. The cost is linear in the number of cells and strings.
+	 */
+	BORDERED_BLOCK_SOLVER,
+	/**
+	 * Keeps the jacobian matrix in sparse format. The matrix and its pattern of non-zero terms are built once per workspace
+	 * and only the values are refilled in every iteration. The system is solved with the spsolve function of Armadillo,
+	 * which factorizes the matrix from scratch in every iteration (the symbolic factorization is not reused).
+	 * SuperLU must be enabled in Armadillo (ARMA_USE_SUPERLU); otherwise spsolve converts the matrix to a dense one and
+	 * uses LAPACK, so the sparse format only saves the assembly.
+	 */
+	SPARSE_SOLVER
+};
+
+/**
+ * Iterative methods available to find the state of the panel for a given voltage.
+ */
+enum SolveMethodType {
+	/// A single Newton-Raphson method with the voltage of every cell, the current of every string and the total current as variables.
+	FULL_NEWTON_METHOD,
+	/**
+	 * Two-level Newton-Raphson method. The outer method only has the current of every string and the total current as variables.
+	 * For a given current, every cell of a string is solved independently (inner scalar method), which gives the voltage
+	 * of the string and its derivative respect the current. The strings are only coupled through the balance of currents
+	 * with their bypass diodes and the total voltage, so the size of the outer system is the number of strings plus one.
+	 */
+	NESTED_NEWTON_METHOD
+};
+
+/**
+ * Initial estimates available for the points of the I-V characteristic.
+ */
+enum ContinuationType {
+	/// Every point starts from the estimate found by the groups of cells (findInitialState of every string).
+	NO_CONTINUATION,
+	/// Every point starts from the solution of the previous point of the characteristic.
+	PREVIOUS_SOLUTION_CONTINUATION,
+	/**
+	 * Every point starts from the solution of the previous point plus its derivative respect the total voltage
+	 * (first order predictor). The derivative is found with the jacobian matrix of the last iteration of the previous point.
+	 */
+	TANGENT_CONTINUATION
+};
+
+/**
+ * Approximations of the I-V characteristic that do not solve the nonlinear system (see calcApproximateIVcharacteristic).
+ */
+enum ApproximationType {
+	/**
+	 * Piecewise constant characteristic of the working zones: the current for every voltage is the shortcut current
+	 * of its working zone (see findWorkingZone), and 0 above the sum of the open circuit voltages of the cells.
+	 * The error is about the difference between the shortcut currents of consecutive zones, near the knees and the open circuit voltage.
+	 */
+	ZONE_APPROXIMATION,
+	/**
+	 * The single-diode equation of every class of equivalent cells, including the shunt and the breakdown terms, is
+	 * explicit in the current for a given junction voltage, and so is the current of a bypass diode for a given voltage.
+	 * Both are sampled and the voltages of cells and strings in series are added for the same current, interpolating linearly.
+	 * The error depends on the panel and on the sampling; it can be measured with calcApproximationError.
+	 */
+	SINGLE_DIODE_APPROXIMATION
+};
 
 /**
  * Structure to gather global information of a group of cells that share, at least, the same shortcut current.
@@ -88,78 +178,208 @@ struct CellsGroup {
 
 /**
  * Structure with info of groups of cells with the same Isc and Vbrx.
- * Contains global information (inMapSum) and detailed information (inMapDetails) about groups of cells with the same shortcut current and breakdown voltage.
+ * Contains global information (sum_same_i_shortcut_and_v_breakdown_group) and the range of its detailed information
+ * in SolarSolver::panel_details.
  *
- * @see inVectorCell
+ * @see SameIshortcutGroup
  */
 struct SameIshortcutAndVbreakdownGroup {
 	/**
 	 * Global information of the group of cells with the same Isc and Vbrx.
 	 *
 	 * Contains the shortcut current of the group and the total sum of certain parameters.
-	 * The grupString's Limit attribute stored in this structure refers to the internal limits.
+	 * The CellsGroup's limit_voltage attribute stored in this structure refers to the internal limits.
 	 *
 	 * These "internal" limits are the total voltage in the panel needed to get every bypass diode in conducting state.
 	 * In case there's no diode, the limit will match the lower external limit.
 	 * The internal limits represent a change in the distribution of the total voltage.
 	 *
-	 * @see grupString
+	 * @see CellsGroup
 	 */
 	CellsGroup sum_same_i_shortcut_and_v_breakdown_group;
+	/// Breakdown voltage calculated in the group Vbrx of every cell of the group.
+	double voltage_breakdown_in_group;
 	/**
 	 * Detailed information of the group of cells with the same Isc and Vbrx.
 	 *
-	 * The cells in the group are split in smaller groups that share the same string.
-	 * Every entry in the list contains a pair with an integer corresponding to the index of the string and a grupString structure with the grouped info of this group.
+	 * The cells in the group are split in smaller groups that share the same string. They are the elements of
+	 * SolarSolver::panel_details from first_detail on: every one contains the index of the string and a CellsGroup
+	 * structure with the grouped info of this smaller group.
 	 */
-	std::list<std::pair<int,CellsGroup>> detailed_same_i_shortcut_and_v_breakdown_group;
+	int first_detail;
+	/// Number of smaller groups (of different strings) of this group.
+	int number_details;
 };
 /**
- * Vector meant to contain info of groups of cells with the same shortcut current (Isc).
+ * Info of groups of cells with the same shortcut current (Isc).
  *
- * Contains global information (inVectorSum) and detailed information (inVectorDetail).
+ * Contains global information (sum_same_i_shortcut_group) and the range of its detailed information.
  * Global information refers to the sum of certain parameters.
  * Detailed information distinguish smaller groups that share the same Isc and Vbrx.
  *
- * @see inMapCell
+ * @see SameIshortcutAndVbreakdownGroup
  */
 struct SameIshortcutGroup {
 	/**
 	 * Global information of the group of cells with the same shortcut current.
 	 *
 	 * Contains the shortcut current of the group and the total sum of certain parameters.
-	 * The grupString's Limit attribute stored in this structure refers to the external limits.
+	 * The CellsGroup's limit_voltage attribute stored in this structure refers to the external limits.
 	 * These "external" limits are the total voltage in the panel needed to get every cell into breakdown. The external limits represent a change in the total current.
 	 *
-	 * @see grupString
+	 * @see CellsGroup
 	 */
 	CellsGroup sum_same_i_shortcut_group;
 	/**
 	 * Detailed information of the group of cells with the same shortcut current.
 	 * The cells in the group are split in smaller groups that share the same breakdown voltage calculated in the group Vbrx.
-	 * Every entry in the map is composed by key, which is a double corresponding to Vbrx, and a inMapCell structure with the information of this reduced group.
-	 *
+	 * They are the elements of SolarSolver::panel_groups from first_group on, sorted by increasing Vbrx.
+	 */
+	int first_group;
+	/// Number of groups with a different Vbrx.
+	int number_groups;
+	/// Position in SolarSolver::panel_details of the first group of a string with this shortcut current.
+	int first_detail;
+	/// Number of groups of a string with this shortcut current.
+	int number_details;
+};
+
+/**
+ * Working point of the panel with the maximum power, and the state of every string in it.
+ */
+struct MaximumPowerPoint {
+	/// Voltage of the panel [V].
+	double voltage;
+	/// Current generated by the panel [A].
+	double current;
+	/// Power generated by the panel [W].
+	double power;
+	/// Number of working points solved to find the maximum power point.
+	int number_solves;
+	/// True if the maximum power point was found and the panel was solved in it. Otherwise the current and the power
+	/// are NAN and the state of the strings is empty.
+	bool solved;
+	/// Voltage of every string [V].
+	std::vector<double> string_voltages;
+	/// Current through the cells of every string [A].
+	std::vector<double> string_currents;
+	/// Current through the bypass diode of every string [A].
+	std::vector<double> diode_currents;
+	/// Number of cells with a negative voltage (reverse biased, towards breakdown) at the maximum power point.
+	int number_cells_reverse;
+};
+
+/**
+ * New irradiance and temperature of a cell of the panel (see SolarSolver::setCellConditions).
+ */
+struct CellConditions {
+	/// Number of the string of the cell.
+	int string;
+	/// Position of the cell in the string.
+	int cell;
+	/// New irradiance of the cell.
+	double irradiance;
+	/// New temperature of the cell.
+	double temperature;
+};
+
+/**
+ * State of the panel for a given voltage, with the working point of every cell.
+ */
+struct PanelState {
+	/// Voltage of the panel [V].
+	double voltage;
+	/// Current generated by the panel [A].
+	double current;
+	/// True if the iterative method converged (the norm of its functions is not greater than epsilon).
+	bool solved;
+	/// Current through the bypass diode of every string [A].
+	std::vector<double> diode_currents;
+	/**
+	 * Working point of every cell, with a row for every cell sorted by string and by position in the string.
+	 * The columns are the number of string, index of the cell, irradiance, temperature, current and voltage (see calcState).
 	 */
-	std::map<double,SameIshortcutAndVbreakdownGroup> detailed_same_i_shortcut_group;
+	arma::mat cells;
 };
 
 /**
- * Comparison function object for the multimap.
- * Compares the Isc of both groups.
- * In case they are equal, compares the SVbr of the groups.
+ * Memory used by the Newton-Raphson method.
  *
- * @returns True in case the Isc of the first element is lower than the first one. If they are equal, returns TRUE if the first element has higher SVbr.
+ * It is sized once, when the SolarSolver object is created, and reused by every solve.
+ * This way no memory is allocated while the I-V characteristic is computed.
  */
-struct Classcomp
-{
-	bool operator()(const std::pair<double,double> &k1, const std::pair<double,double> &k2)
-	{
-		return ((k1.first < k2.first)||((k1.first == k2.first)&&(k1.second > k2.second)));
-	}
+struct SolverWorkspace {
+	/// Total number of variables. That is the total number of cell variables plus the number of strings plus one (the total current).
+	int dimension;
+	/// Total number of cell variables in the panel. There is one for every class of equivalent cells of every string.
+	int total_cells;
+	/// Number of strings in the panel.
+	int number_strings;
+	/// State vector. The voltage of every cell variable, the total current and the current of every string.
+	std::vector<double> state;
+	/// Number of cells represented by every cell variable (size of its class of equivalent cells).
+	std::vector<double> cell_weight;
+	/// Functions vector. The function of every cell followed by the function of every string.
+	std::vector<double> functions;
+	/// Increment of the state. The voltage of every cell but the last one, the total current and the current of every string.
+	std::vector<double> increment;
+	/// Derivative of the state respect the total voltage, in the same order as the increment (TANGENT_CONTINUATION).
+	std::vector<double> tangent;
+	/// Partial derivative respect the voltage of the function of every cell.
+	std::vector<double> cell_derivative_voltage;
+	/// Partial derivative respect the current of the function of every cell.
+	std::vector<double> cell_derivative_current;
+	/// Partial derivative respect the voltage of the cells of the function of every string (current through the diode).
+	std::vector<double> diode_derivative_voltage;
+	/// Parameters and working point of the representative cell of every cell variable (vectorized evaluation of the cells).
+	CellArrays cells;
+	/// Norm of the functions vector in the last iteration. The last solve converged if it is not greater than epsilon.
+	double residual_norm;
+	/// Sum of the voltage increments of every string that do not depend on its current (bordered-block elimination).
+	std::vector<double> string_alpha;
+	/// Sum of the voltage increments of every string per unit of increment of its current (bordered-block elimination).
+	std::vector<double> string_beta;
+	/// Independent term of the current increment of every string as a function of the total current increment.
+	std::vector<double> string_p;
+	/// Slope of the current increment of every string as a function of the total current increment.
+	std::vector<double> string_q;
+	/// Initial estimate of the voltage of every string [V].
+	std::vector<double> string_voltages;
+	/// Derivative of the voltage of every string respect the total current (NESTED_NEWTON_METHOD) [V/A].
+	std::vector<double> string_voltage_derivative;
+	/// State of the outer system of the NESTED_NEWTON_METHOD. The current of every string followed by the total current.
+	std::vector<double> nested_state;
+	/// Functions of the outer system of the NESTED_NEWTON_METHOD. The function of every string followed by the sum of voltages.
+	std::vector<double> nested_functions;
+	/// Dense jacobian matrix, stored by columns. It is only sized when the ARMADILLO_DENSE_SOLVER is in use.
+	std::vector<double> jacobian;
+	/**
+	 * Sparse jacobian matrix. It is only built when the SPARSE_SOLVER is in use, once per pattern, and then only its values
+	 * are refilled in every iteration.
+	 */
+	arma::sp_mat sparse_jacobian;
+	/// Derivative that corresponds to every non-zero term of the sparse jacobian matrix.
+	std::vector<int> sparse_term_type;
+	/// Index of the cell or string of the derivative that corresponds to every non-zero term of the sparse jacobian matrix.
+	std::vector<int> sparse_term_index;
+	/// Number of cells that multiplies the derivative of every non-zero term of the sparse jacobian matrix.
+	std::vector<double> sparse_term_weight;
 };
 
 /**
+ * Solves the electrical state of a solar panel.
+ *
+ * It creates a SolarString object for every string of a SolarPanel object and groups the cells of every string that
+ * work in the same way. The groups are sorted into working zones, which give the initial estimate of the voltage of
+ * every cell for a total voltage of the panel. Then the state of the panel is found with an iterative method (see
+ * SolveMethodType and LinearSolverType), for one voltage, an I-V characteristic or the maximum power point.
+ * The conditions of the cells can be changed afterwards, without creating the solver again (see setCellConditions).
  *
+ * A SolarSolver object is not thread-safe: every thread needs its own copy.
+ *
+ * @see SolarPanel
+ * @see SolarString
+ * @note The iterative method is explained in the @ref math part of the @ref mainPage.
  */
 class SolarSolver
 {
@@ -168,12 +388,61 @@ protected:
 	int number_strings;
 	/// Array of SolarString objects that compose the PV panel.
 	solar_string *string_array;
-	/// Main vector where all the info will be organized by shortcut current, breakdown voltage and number of string.
+	/**
+	 * Main vector where all the info will be organized by shortcut current, breakdown voltage and number of string.
+	 * Every element is a working zone (a different shortcut current, increasing), with a range of panel_groups.
+	 */
 	std::vector <SameIshortcutGroup> panel_vector;
+	/// Groups of cells with the same Isc and Vbrx, sorted by Isc and then by Vbrx, with a range of panel_details.
+	std::vector <SameIshortcutAndVbreakdownGroup> panel_groups;
+	/// Groups of cells of every string, sorted by Isc, Vbrx and number of string. Contains the number of the string.
+	std::vector <std::pair<int,CellsGroup>> panel_details;
+	/// Number of string and of group in string_groups of every group of a string, sorted as panel_details.
+	std::vector <std::pair<int,int>> panel_order;
+	/**
+	 * Voltage of every string due to the zones before every working zone (see calcUpperZones). Row m (of number_strings
+	 * values) is the sum of the zones 0 to m-1, for m from 0 to the number of zones. Empty if the table is too large.
+	 */
+	std::vector <double> zone_upper_voltages;
+	/**
+	 * Voltage of every string due to the zones after every working zone (see calcLowerZones), with the same rows as
+	 * zone_upper_voltages. Empty if the table is too large.
+	 */
+	std::vector <double> zone_lower_voltages;
+	/// True if the limit voltages of the zones decrease strictly, so that the working zone can be found with a binary search.
+	bool zone_limits_decreasing;
 	/// Maximum number of iterations to solve the Newton-Raphson iterative method.
 	int max_iterations;
 	/// Condition of convergence.
 	double epsilon;
+	/// Linear solver used to find the increment in every iteration of the Newton-Raphson method.
+	LinearSolverType linear_solver;
+	/// Iterative method used to find the state of the panel.
+	SolveMethodType solve_method;
+	/// Initial estimate used for the points of the I-V characteristic.
+	ContinuationType continuation;
+	/// Memory reused by every call to the Newton-Raphson method.
+	SolverWorkspace workspace;
+	/// Number of threads used to calculate the points of the I-V characteristic.
+	int number_threads;
+	/**
+	 * Groups of cells of every string as they enter panel_vector, with their key (Isc and Vbrx) to sort them in
+	 * retrieveDataFromStringArray. They are only found again for the strings whose cells change (see setCellConditions).
+	 */
+	std::vector<std::vector<std::pair<std::pair<double,double>,CellsGroup>>> string_groups;
+	/// Voltage of the last working point solved in the workspace (the estimate of calcState with continuation).
+	double last_voltage;
+	/// Working zone of the last working point solved in the workspace (see findWorkingZone).
+	int last_zone;
+	/// True if the last working point solved in the workspace converged.
+	bool last_solved;
+	/**
+	 * If true, a point where the iterative method fails is reported on the standard output and the sweep goes on
+	 * (file-based methods). Otherwise the error is passed to the caller (in-memory methods).
+	 */
+	bool report_point_errors;
+
+	friend class CharacteristicCache;
 
 public:
 	/**
@@ -183,6 +452,22 @@ public:
 	 * @param The SolarPanel object with the information to be simulated already loaded.
 	 */
 	SolarSolver(stringarma::SolarPanel&);
+	/**
+	 * Copy constructor of the class SolarSolver.
+	 * The array of SolarString objects is copied, so the new solver can be used independently of the original one.
+	 * @param The SolarSolver object to copy.
+	 */
+	SolarSolver(const SolarSolver&);
+	/**
+	 * Assignment operator of the class SolarSolver. The array of SolarString objects is copied.
+	 * @param The SolarSolver object to copy.
+	 * @returns A reference to this object.
+	 */
+	SolarSolver& operator=(const SolarSolver&);
+	/**
+	 * Destructor of the class SolarSolver. Frees the array of SolarString objects.
+	 */
+	~SolarSolver(void);
 	/**
 	 * Set a double value for the maximum number of iterations to solve the Newton-Raphson iterative method.
 	 * @param Double value for the maximum number of iterations.
@@ -193,6 +478,35 @@ public:
 	 * @param Double value for the condition of convergence.
 	 */
 	void setEpsilon(double);
+	/**
+	 * Set the linear solver used in every iteration of the Newton-Raphson method.
+	 * By default the ARMADILLO_DENSE_SOLVER is used, as in the original implementation.
+	 * The ARMADILLO_DENSE_SOLVER needs to store the whole jacobian matrix, which is allocated when this solver is selected.
+	 * The SPARSE_SOLVER finds the pattern of non-zero terms of the jacobian matrix when it is selected.
+	 * @param LinearSolverType value with the solver to use.
+	 */
+	void setLinearSolver(LinearSolverType);
+	/**
+	 * Set the iterative method used to find the state of the panel.
+	 * By default the FULL_NEWTON_METHOD is used. The linear solver only applies to the FULL_NEWTON_METHOD.
+	 * @param SolveMethodType value with the method to use.
+	 */
+	void setSolveMethod(SolveMethodType);
+	/**
+	 * Set the number of threads used to calculate the I-V characteristic.
+	 * The voltage range is split in consecutive parts, one for every thread. Every thread solves its part with its own
+	 * copy of the SolarString objects and its own workspace. By default (1) the characteristic is calculated in the calling thread.
+	 * @param Integer value with the number of threads.
+	 */
+	void setNumberThreads(int);
+	/**
+	 * Set the initial estimate used for the points of the I-V characteristic.
+	 * By default (NO_CONTINUATION) every point starts from the estimate found by the groups of cells.
+	 * With continuation, the estimate by groups is still used for the first point and whenever the working zone changes
+	 * (see findWorkingZone) or the previous point could not be solved.
+	 * @param ContinuationType value with the initial estimate to use.
+	 */
+	void setContinuation(ContinuationType);
 	/**
 	 * Gets the maximum number of iterations to solve the Newton-Raphson iterative method.
 	 * @returns A double type with the value of the maximum number of iterations.
@@ -203,6 +517,26 @@ public:
 	 * @returns A double type with the condition of convergence (epsilon).
 	 */
 	double getEpsilon(void);
+	/**
+	 * Gets the linear solver used in every iteration of the Newton-Raphson method.
+	 * @returns A LinearSolverType value with the solver in use.
+	 */
+	LinearSolverType getLinearSolver(void);
+	/**
+	 * Gets the iterative method used to find the state of the panel.
+	 * @returns A SolveMethodType value with the method in use.
+	 */
+	SolveMethodType getSolveMethod(void);
+	/**
+	 * Gets the initial estimate used for the points of the I-V characteristic.
+	 * @returns A ContinuationType value with the initial estimate in use.
+	 */
+	ContinuationType getContinuation(void);
+	/**
+	 * Gets the number of threads used to calculate the I-V characteristic.
+	 * @returns Integer value with the number of threads.
+	 */
+	int getNumberThreads(void);
 	/**
 	 * Calculates the I-V characteristic of the SolarPanel object introduced in the constructor of the SolarSolver object.
 	 * The resulting characteristic is stored in a file, specified as a parameter.
@@ -218,6 +552,196 @@ public:
 	 * @param numb_points Number of points in the characteristic.
 	 */
 	void calcIVcharacteristic(std::string, double, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object, with the same points as calcIVcharacteristic(std::string),
+	 * and returns it in memory. Nothing is written to a file or to the standard output.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcIVcharacteristic(void);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object in a given range and returns it in memory.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcIVcharacteristic(double, double, int);
+	/**
+	 * Calculates the current of the SolarPanel object for the given voltages and returns the characteristic in memory.
+	 * The points where the iterative method does not converge in the maximum number of iterations have a NAN current.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param voltages Vector with the voltage of every point, sorted in increasing order.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcIVcharacteristic(const std::vector<double> &);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object with an adaptive distribution of points.
+	 * The characteristic starts with a coarse grid plus every limit voltage of panel_vector (where the distribution of
+	 * current or voltage changes), and it is refined where the curve is not linear between consecutive points.
+	 * The resulting characteristic is stored in a file, specified as a parameter.
+	 * @param output_path Full path of the file where to store the I-V characteristic. If the file exists it will be replaced. If it doesn't, it will be created.
+	 * @param tolerance Maximum difference between the current of a point and the line through its neighbours [A].
+	 * @param max_points Maximum number of points in the characteristic.
+	 */
+	void calcAdaptiveIVcharacteristic(std::string, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object with an adaptive distribution of points.
+	 * The resulting characteristic is stored in a file, specified as a parameter.
+	 * @param output_path Full path of the file where to store the I-V characteristic. If the file exists it will be replaced. If it doesn't, it will be created.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param tolerance Maximum difference between the current of a point and the line through its neighbours [A].
+	 * @param max_points Maximum number of points in the characteristic.
+	 */
+	void calcAdaptiveIVcharacteristic(std::string, double, double, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object with an adaptive distribution of points (see
+	 * calcAdaptiveIVcharacteristic(std::string, double, int)) and returns it in memory.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param tolerance Maximum difference between the current of a point and the line through its neighbours [A].
+	 * @param max_points Maximum number of points in the characteristic.
+	 * @returns A matrix with a row for every point of the characteristic, sorted by voltage. The columns are the voltage and the current.
+	 */
+	arma::mat calcAdaptiveIVcharacteristic(double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object with an adaptive distribution of points in a given
+	 * range and returns it in memory.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param tolerance Maximum difference between the current of a point and the line through its neighbours [A].
+	 * @param max_points Maximum number of points in the characteristic.
+	 * @returns A matrix with a row for every point of the characteristic, sorted by voltage. The columns are the voltage and the current.
+	 */
+	arma::mat calcAdaptiveIVcharacteristic(double, double, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object by composing the characteristics of its strings.
+	 *
+	 * The strings are in series, so they share the current of the panel. The voltage of every string (cells and bypass
+	 * diode) is tabulated for a common grid of currents, and the voltage of the panel for every current is the sum of
+	 * the voltages of its strings. The current for every voltage of the characteristic is interpolated in this table.
+	 * Strings with the same bypass diode and the same conditions of their cells, in any order, share their table.
+	 * The grid of currents is refined until consecutive points are not further than a step of the characteristic, and
+	 * the current of every point is within COMPOSITION_TOLERANCE_REF of the line through its neighbours.
+	 * The resulting characteristic is stored in a file, specified as a parameter.
+	 * @param output_path Full path of the file where to store the I-V characteristic. If the file exists it will be replaced. If it doesn't, it will be created.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 */
+	void calcComposedIVcharacteristic(std::string, double, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object by composing the characteristics of its strings (see
+	 * calcComposedIVcharacteristic(std::string, double, double, int)) in a given range and returns it in memory.
+	 * The voltages are the same as calcIVcharacteristic(double, double, int).
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcComposedIVcharacteristic(double, double, int);
+	/**
+	 * Calculates the I-V characteristic of the SolarPanel object by composing the characteristics of its strings (see
+	 * calcComposedIVcharacteristic(std::string, double, double, int)) for the given voltages and returns it in memory.
+	 * The voltages out of the range of the table (beyond COMPOSITION_MAX_EXTENSIONS_REF extensions of its currents) have a NAN current.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param voltages Vector with the voltage of every point, sorted in increasing order.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcComposedIVcharacteristic(const std::vector<double> &);
+	/**
+	 * Calculates the voltage of the SolarPanel object for the given currents through the panel and returns it in memory.
+	 * The voltage of every string is found for the current (see calcComposedIVcharacteristic), so no interpolation is done.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param currents Vector with the current of every point, preferably sorted in increasing order.
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcCharacteristicForCurrents(const std::vector<double> &);
+	/**
+	 * Calculates an approximate I-V characteristic of the SolarPanel object without any iteration of the nonlinear
+	 * solver (see ApproximationType), and stores it in a file, specified as a parameter.
+	 * It is meant for the screening of many panels, where the error of the approximation is acceptable. The error can be
+	 * measured on representative panels with calcApproximationError.
+	 * @param output_path Full path of the file where to store the I-V characteristic. If the file exists it will be replaced. If it doesn't, it will be created.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @param type Approximation used (see ApproximationType).
+	 */
+	void calcApproximateIVcharacteristic(std::string, double, double, int, ApproximationType);
+	/**
+	 * Calculates an approximate I-V characteristic of the SolarPanel object (see
+	 * calcApproximateIVcharacteristic(std::string, double, double, int, ApproximationType)) in a given range and returns it in memory.
+	 * The voltages are the same as calcIVcharacteristic(double, double, int).
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @param type Approximation used (see ApproximationType).
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcApproximateIVcharacteristic(double, double, int, ApproximationType = SINGLE_DIODE_APPROXIMATION);
+	/**
+	 * Calculates an approximate I-V characteristic of the SolarPanel object for the given voltages and returns it in memory.
+	 * The voltages out of the range of the table of the single-diode approximation have a NAN current.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param voltages Vector with the voltage of every point, sorted in increasing order.
+	 * @param type Approximation used (see ApproximationType).
+	 * @returns A matrix with a row for every point of the characteristic. The columns are the voltage and the current.
+	 */
+	arma::mat calcApproximateIVcharacteristic(const std::vector<double> &, ApproximationType = SINGLE_DIODE_APPROXIMATION);
+	/**
+	 * Measures the error of an approximate I-V characteristic against the exact solver at the given points.
+	 * It is the maximum error found at those points, not a bound for the voltages between them.
+	 *
+	 * Every point is solved with the current settings of the solver (see calcWorkingPoint), so it is meant to validate
+	 * the approximation on representative panels, not to be called for every panel.
+	 * The points where the solver does not converge, or out of the range of the approximation, are skipped.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @param type Approximation used (see ApproximationType).
+	 * @returns The maximum difference of current between both characteristics, relative to the greatest shortcut current of the panel.
+	 */
+	double calcApproximationError(double, double, int, ApproximationType = SINGLE_DIODE_APPROXIMATION);
+	/**
+	 * Returns the shortcut current of every working zone of the panel (see findWorkingZone), where the characteristic
+	 * has a knee.
+	 * @returns A vector with the shortcut current of every zone [A].
+	 */
+	std::vector<double> getShortcutCurrents(void);
+	/**
+	 * Finds the global maximum power point of the SolarPanel object without calculating the whole I-V characteristic.
+	 *
+	 * Every working zone of panel_vector (the current is limited by a different group of shortcut current) can
+	 * contain a local maximum of power. The zones are visited from the greatest upper bound of power (upper voltage
+	 * of the zone by its shortcut current), and a zone is skipped if its bound is below the best power found.
+	 * Every zone is sampled in a few points, and every local maximum between two samples is refined with the secant
+	 * method on dP/dV = I + V*dI/dV, safeguarded by the samples where dP/dV changes its sign.
+	 * The derivative dI/dV is the tangent of the solved point (see calcTangent).
+	 * After the search, the objects of the panel contain the state of the maximum power point.
+	 * If no sample of a zone can be solved, or the panel can not be solved again at the maximum, the result is not
+	 * solved (see MaximumPowerPoint). Errors are not caught, so they reach the caller as exceptions.
+	 * @returns A MaximumPowerPoint struct with the voltage, current and power of the maximum, and the state of every string.
+	 */
+	MaximumPowerPoint findMaximumPowerPoint(void);
+	/**
+	 * Finds the short circuit current of the SolarPanel object (the current for a total voltage of 0 V).
+	 * With continuation, the last working point solved is the estimate (see setContinuation).
+	 * @returns A double type with the short circuit current [A], or NAN if the iterative method did not converge.
+	 */
+	double findShortCircuitCurrent(void);
+	/**
+	 * Finds the open circuit voltage of the SolarPanel object (the total voltage where the current is 0 A).
+	 * The voltage is bracketed between 0 V and the upper limit of the characteristic (see findMaxVoltageLimit),
+	 * and found with the secant method safeguarded by the bracket.
+	 * @returns A double type with the open circuit voltage [V]. It is 0 if the panel does not generate current, and NAN if
+	 * the voltage could not be found.
+	 */
+	double findOpenCircuitVoltage(void);
 	/**
 	 * Calculates the state the SolarPanel object introduced in the constructor of the SolarSolver object for a single value of voltage.
 	 * The resulting .csv file, specified as a parameter, contains the number of string, position in the string, irradiance, temperature, current and voltage of every cell.
@@ -226,17 +750,44 @@ public:
 	 * @param Vpan Total voltage in the panel.
 	 */
 	void calcState(std::string, double);
+	/**
+	 * Calculates the state the SolarPanel object for a single value of voltage and returns it in memory.
+	 * Nothing is written to a file. After the call, the objects of the panel also contain this state.
+	 * Errors are not caught, so they reach the caller as exceptions.
+	 * @param Vpan Total voltage in the panel.
+	 * @returns A PanelState struct with the current of the panel and of every diode, and the working point of every cell.
+	 */
+	PanelState calcState(double);
+	/**
+	 * Changes the irradiance and temperature of a cell of the panel, without building the SolarPanel and SolarSolver objects again.
+	 * @param string Number of the string of the cell.
+	 * @param cell Position of the cell in the string.
+	 * @param G New irradiance of the cell.
+	 * @param Tc New temperature of the cell.
+	 * @see setCellConditions(const std::vector<CellConditions>&)
+	 */
+	void setCellConditions(int, int, double, double);
+	/**
+	 * Changes the irradiance and temperature of several cells of the panel at once.
+	 *
+	 * Only the strings with a changed cell update their groups of cells and their classes of equivalent cells, and only
+	 * their groups are found again to update panel_vector (see updatePanelVector). The working point of the cells is
+	 * kept, so with continuation the next call to calcState starts from the last solution (see setContinuation).
+	 * Errors are not caught, so they reach the caller as exceptions. A wrong position of a cell is detected before
+	 * any cell changes.
+	 * @param changes Vector with the new conditions of every changed cell.
+	 */
+	void setCellConditions(const std::vector<CellConditions> &);
 
 protected:
 
 	/**
-	 * @brief Fulfills the multimap structure with the data contained in the array of SolarString objects.
-	 * The groups of cells of different strings working under the same breakdown current (Isc) and voltage (Vbr) are grouped inside the multimap.
+	 * @brief Sorts the groups of cells of every string (see findStringGroups) by Isc, then by Vbrx and then by number of string.
+	 * The groups of cells of different strings working under the same breakdown current (Isc) and voltage (Vbr) become consecutive.
 	 *
-	 * @param &MultiMapElDets Type multimap. The key is composed by two double values: Iscx and Vbrx in this order. The SameIshortcutAndVbreakdownGroup struct contains the corresponding sum_same_i_shortcut_and_v_breakdown_group (CellsGroup struct) with the total sums of the parameters of the groups of groups, and the detailed_same_i_shortcut_and_v_breakdown_group list of pairs with the integer pointing the number of the string and the CellsGroup struct with the specifics of this group.
-	 * @param *&panel Array of SolarString objects.
+	 * The result is stored in panel_order, with the number of the string and the position of the group in string_groups.
 	 */
-	void retrieveDataFromStringArray (std::multimap <std::pair<double,double>, SameIshortcutAndVbreakdownGroup, Classcomp> &MultiMapElDets);
+	void retrieveDataFromStringArray (void);
 
 	/**
 	 * Returns the "first upper limit" of the I-V characteristic. That is the sum of Voc of every cell.
@@ -261,18 +812,63 @@ protected:
 	 * These limits are relative to the inferior voltage limit for changes in current.
 	 *
 	 * The internal limits represent a change in the distribution of the total voltage.
+	 * @param first_zone First zone whose limits are found. The limits of every zone only depend on its own groups.
 	 */
-	void findVoltageLimitsForChangesInVoltage();
+	void findVoltageLimitsForChangesInVoltage(int first_zone);
 	/**
 	 * Fulfills the vector with the information contained in the array of strings that represents the panel.
 	 * It also organize all this info in the vector. By Isc, then by Isc and Vbrx, and by Isc, Vbrx and Index of string.
+	 * The three levels are stored in contiguous vectors (panel_vector, panel_groups and panel_details), built from a
+	 * single sort of the groups of every string and walked with linear scans.
 	 * In addition, calculates totals of every group and the limits of the I-V characteristic.
 	 */
 	void generatePanelVector();
+	/**
+	 * Updates panel_vector after the groups of some strings change (see findStringGroups), without sorting the
+	 * groups of every string again.
+	 *
+	 * The groups of the other strings keep their order in panel_order, and the new groups of the modified strings are
+	 * sorted and merged with them. The zones before the first group of a modified string (in the old or the new order)
+	 * are kept, and the zones from there are built again (see buildPanelZones), as well as their limits and their rows
+	 * of the zone tables. The limits for changes in current of every zone are found again, since they depend on the
+	 * open circuit voltage of the whole panel.
+	 * @param modified True for every string whose groups changed.
+	 */
+	void updatePanelVector(const std::vector<bool> &modified);
+	/**
+	 * Adds the zones of panel_vector, with their groups and details, from a group of panel_order to the last one.
+	 * The group must be the first one of a zone, and the vectors must end at the zone before it.
+	 * @param first_detail Position of the group in panel_order.
+	 */
+	void buildPanelZones(int first_detail);
+	/**
+	 * Builds the tables of voltage of every string due to the zones before and after every working zone
+	 * (zone_upper_voltages and zone_lower_voltages), so that the initial estimate of a working point adds a row of
+	 * each table (where the row is shorter than the groups of those zones) and the groups of its own zone. The tables
+	 * are not built when they would have more than ZONE_TABLE_MAX_VALUES_REF values, and then the zones are added one by one.
+	 * @param first_zone First zone that changed. The rows of zone_upper_voltages up to it are kept, if it was built.
+	 */
+	void buildZoneTables(int first_zone);
+	/**
+	 * Calculates the approximate voltage of a string for a grid of currents without solving it (see SINGLE_DIODE_APPROXIMATION).
+	 * @param st String whose voltages are calculated.
+	 * @param Imax Greatest current of interest [A], the shortcut current of the panel with a margin.
+	 * @param currents Currents through the string [A], sorted in increasing order.
+	 * @param cell_cache Voltage of a cell for every current, by irradiance and temperature. It is updated with the new cells.
+	 * @param voltages Output with the voltage of the string for every current [V].
+	 */
+	void calcApproximateStringVoltages(solar_string &, double, const std::vector<double> &,
+			std::map<std::vector<double>, std::vector<double>> &, std::vector<double> &);
+	/**
+	 * Finds the groups of cells of a string that enter panel_vector, and stores them in string_groups.
+	 * @param j Number of the string.
+	 */
+	void findStringGroups(int j);
 	/**
 	 * Given the external voltage limits (for changes in current), and numbering every zone in between them (from higher V zones to lower V zones),
 	 * returns the operational zone that belongs to a certain voltage.
 	 * LT2 -----zone 2------LT1------zone 1------LT0-----zone 0  where LT2<LT1<LT0
+	 * The limits are found with a binary search when they decrease strictly (see zone_limits_decreasing).
 	 * @param Vin Total voltage in the panel [V].
 	 * @returns An integer of the working zone.
 	 */
@@ -327,26 +923,168 @@ protected:
 	 * @returns No value. But the VString vector is updated with the calculated values.
 	 */
 	void assignStringVoltages(double Vpan, std::vector <double> &VString);
+	/**
+	 * Sizes the workspace according to the strings of the panel and the linear solver in use.
+	 * @param ws Workspace to be sized.
+	 */
+	void initWorkspace (SolverWorkspace &ws);
+	/**
+	 * Finds the pattern of non-zero terms of the sparse jacobian matrix, which only depends on the strings of the panel.
+	 *
+	 * The non-zero terms are the derivatives of every cell function (the diagonal and the current of its string),
+	 * the derivatives of every string function (the diode and the currents) and the terms that come from replacing
+	 * the voltage of the last cell by the total voltage minus the rest of cells.
+	 * The sparse jacobian matrix of the workspace is built here with this pattern.
+	 * @param ws Workspace where the pattern is stored.
+	 */
+	void initSparsePattern (SolverWorkspace &ws);
+	/**
+	 * Fills the values of the sparse jacobian matrix in place, following the pattern stored in the workspace.
+	 * @param ws Workspace with the pattern and the derivatives of the current iteration.
+	 */
+	void fillSparseJacobian (SolverWorkspace &ws);
 	/**
 	 * Calculates the state of a given PV panel (an array of SolarString objects) by using the Newton-Raphson iterative method.
 	 *
+	 * There is a voltage variable for every class of equivalent cells of every string, weighted by the number of cells of the class.
+	 * Only the representative cells are updated (see solar_string::expandEquivalentCells).
 	 * Certain parameters such as the convergence condition or the maximum number of iteration can be set through other member methods.
 	 * @param st Array of SolarString objects to be solved.
 	 * @param Vp Total voltage in the panel [V].
-	 * @param dimX Total number of variables. That is the total number of cells plus the number of strings plus one (the total current).
-	 * @param nS Number of strings.
+	 * @param ws Workspace sized for the array of SolarString objects. It contains the dimensions of the system.
+	 * @param warm_start If true, the initial estimate is the state stored in the workspace (see predictState) instead of the state of the SolarString objects.
 	 * @returns The total current generated by the panel. The values of voltage and current through every component of the panel are updated in the corresponding object.
 	 */
-	double calcNewtonRaphson (solar_string *st, double Vp, int _dimX, int nS);
+	double calcNewtonRaphson (solar_string *st, double Vp, SolverWorkspace &ws, bool warm_start = false);
 	/**
-	 * Returns a column matrix with the initial estimate of the solution to start the Newton-Raphson method.
-	 * @param st Array of SolarString objects.
-	 * @param n Total number of variables. That is the total number of cells plus the number of strings plus one (the total current).
-	 * @param nS Number of strings.
-	 * @returns The column with the initial estimation of the solution.
+	 * Solves the linear system of an iteration of the Newton-Raphson method with the linear solver in use.
+	 * @param st Array of SolarString objects to be solved.
+	 * @param ws Workspace with the functions vector and the derivatives of the current iteration.
+	 * @returns No value. The increment vector of the workspace is updated with the solution.
 	 */
-	//Col<double> loadInitialValues(solar_string *st, int n, int nS);
-
+	void solveLinearSystem (solar_string *st, SolverWorkspace &ws);
+	/**
+	 * Calculates the derivative of the solved state respect the total voltage (tangent of the characteristic).
+	 *
+	 * Only the function of the last cell and the function of the last string depend on the total voltage, since the voltage
+	 * of the last cell is replaced by the total voltage minus the rest of cells. The derivative is the solution of the linear
+	 * system with the jacobian matrix of the last iteration.
+	 * @param st Array of SolarString objects solved.
+	 * @param ws Workspace with the derivatives of the last iteration.
+	 * @returns No value. The tangent vector of the workspace is updated.
+	 */
+	void calcTangent (solar_string *st, SolverWorkspace &ws);
+	/**
+	 * Prepares the state stored in the workspace as the initial estimate of a new total voltage (continuation).
+	 *
+	 * With TANGENT_CONTINUATION the state is moved along the tangent of the previous point. In any case, the voltage of
+	 * the last cell is updated so the sum of voltages equals the new total voltage.
+	 * @param Vp New total voltage in the panel [V].
+	 * @param dV Difference between the new and the previous total voltage [V].
+	 * @param cont Initial estimate in use (PREVIOUS_SOLUTION_CONTINUATION or TANGENT_CONTINUATION).
+	 * @param ws Workspace with the state of the previous point.
+	 */
+	void predictState (double Vp, double dV, ContinuationType cont, SolverWorkspace &ws);
+	/**
+	 * Calculates a point of the I-V characteristic, with the initial estimate selected by the continuation parameter.
+	 * If the method fails from the previous solution, the point is solved again from the estimate by groups.
+	 * An error of the method from the estimate by groups is passed to the caller as an exception, unless report_point_errors
+	 * is set. Then it is printed and the point is not solved.
+	 * A point that does not converge in max_iterations iterations is not solved either (it is printed if report_point_errors is set).
+	 * @param st Array of SolarString objects to be solved.
+	 * @param ws Workspace sized for the array of SolarString objects.
+	 * @param Vpan Total voltage in the panel [V].
+	 * @param Vprev Total voltage of the previous point of the characteristic [V].
+	 * @param cont Initial estimate to use for this point.
+	 * @param zone Working zone of the previous point. It is updated with the working zone of this point.
+	 * @param solved True if the previous point was solved. It is updated with the result of this point.
+	 * @returns The total current generated by the panel [A], or NAN if the point was not solved.
+	 */
+	double calcCharacteristicPoint (solar_string *st, SolverWorkspace &ws, double Vpan, double Vprev, ContinuationType cont, int &zone, bool &solved);
+	/**
+	 * Calculates the total current for a list of voltages of the I-V characteristic.
+	 *
+	 * With more than one thread, the list is split in consecutive parts and every thread solves one part with a private
+	 * copy of the SolarString objects and of the workspace, so the points of a part can still start from the previous one.
+	 * @param voltages Total voltage of every point, in increasing order [V].
+	 * @param currents Vector where the total current of every point is stored [A].
+	 * @param cont Initial estimate to use for the points.
+	 */
+	void calcCharacteristicPoints (const std::vector<double> &voltages, std::vector<double> &currents, ContinuationType cont);
+	/**
+	 * Finds the initial points of an adaptive I-V characteristic: a coarse grid and every limit voltage of panel_vector between the start and the end voltages.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param voltages Vector where the voltages are stored, in increasing order and without repetitions.
+	 */
+	void findCharacteristicBreakpoints (double start_v, double end_v, std::vector<double> &voltages);
+	/**
+	 * Finds the strings with the same characteristic: the same bypass diode and the same irradiance and temperature
+	 * of their cells, in any order.
+	 * @param representatives Vector where the number of the first string of every different characteristic is stored.
+	 * @param weights Vector where the number of strings with every characteristic is stored.
+	 */
+	void findEquivalentStrings (std::vector<int> &representatives, std::vector<int> &weights);
+	/**
+	 * Finds the voltages of the characteristic in a given range (see calcIVcharacteristic(double, double, int)).
+	 * The step is rounded to hundredths of volt.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 * @param voltages Vector where the voltages are stored.
+	 */
+	void findCharacteristicVoltages (double start_v, double end_v, int numb_points, std::vector<double> &voltages);
+	/**
+	 * Calculates the voltage of some strings for a list of currents through the panel (see calcComposedIVcharacteristic).
+	 * The strings are solved in parallel if more than one thread is used.
+	 * @param strings Copies of the strings to solve. Their state is the estimate of the next call.
+	 * @param currents Currents through the panel, sorted in increasing order.
+	 * @param voltages Vector where a vector for every string, with its voltage for every current, is stored.
+	 */
+	void calcStringVoltages (std::vector<solar_string> &strings, const std::vector<double> &currents, std::vector<std::vector<double>> &voltages);
+	/**
+	 * Solves a working point of the panel, from the estimate by groups, and finds the derivative of the power respect the voltage.
+	 * @param Vpan Total voltage in the panel [V].
+	 * @param solved It is updated with true if the point was solved.
+	 * @param Itotal Total current generated by the panel [A].
+	 * @returns The derivative of the power respect the voltage, dP/dV = I + V*dI/dV [A].
+	 */
+	double calcPowerDerivative (double Vpan, bool &solved, double &Itotal);
+	/**
+	 * Solves the panel for a single voltage in the workspace of the solver.
+	 * With continuation, the last working point solved in the workspace is the estimate.
+	 * @param Vpan Total voltage in the panel.
+	 * @param solved Returns true if the iterative method converged.
+	 * @returns A double type with the total current [A], or NAN if the iterative method did not converge.
+	 */
+	double calcWorkingPoint (double Vpan, bool &solved);
+	/**
+	 * Solves the linear system of an iteration of the Newton-Raphson method by block elimination (BORDERED_BLOCK_SOLVER).
+	 *
+	 * The jacobian matrix is not built. Only its non-zero terms are needed: the derivatives of every cell function and
+	 * the derivatives of the current through every bypass diode. The voltage of the last cell is not a variable,
+	 * since it is replaced by the difference between the total voltage and the rest of cells.
+	 * @param st Array of SolarString objects to be solved.
+	 * @param ws Workspace with the functions vector and the derivatives of the current iteration.
+	 * @returns No value. The increment vector of the workspace is updated with the solution.
+	 */
+	void solveBorderedBlock (solar_string *st, SolverWorkspace &ws);
+	/**
+	 * Calculates the state of a given PV panel (an array of SolarString objects) by using the two-level Newton-Raphson method (NESTED_NEWTON_METHOD).
+	 *
+	 * The outer variables are the current of every string and the total current. Their functions are the balance of
+	 * currents in every string (total current, current of the cells and current of the bypass diode) and the sum of
+	 * the voltage of the strings, which must equal the total voltage.
+	 * Every string function only depends on its own current and the total current, so the current of every string is
+	 * eliminated: it is solved by the string itself for the total current (see solar_string::calcVoltageForTotalCurrent).
+	 * Then the Newton-Raphson iteration is scalar, in the total current, and it is safeguarded by bisection.
+	 * @param st Array of SolarString objects to be solved. It must contain the initial estimate.
+	 * @param Vp Total voltage in the panel [V].
+	 * @param ws Workspace sized for the array of SolarString objects.
+	 * @param warm_start If true, the initial estimate is the state of the previous call stored in the workspace (see predictState).
+	 * @returns The total current generated by the panel. The values of voltage and current through every component of the panel are updated in the corresponding object.
+	 */
+	double calcNestedNewtonRaphson (solar_string *st, double Vp, SolverWorkspace &ws, bool warm_start = false);
 };
 
 }
@@ -39,11 +39,6 @@ bool operator < (const TotalsOfCellsGroup &T1, const TotalsOfCellsGroup &T2 )
 {
 	return ( T2.current_shortcut > T1.current_shortcut);
 }
-bool operator == (const TotalsOfCellsGroup &T1, const TotalsOfCellsGroup &T2)
-{
-	return (T1.current_shortcut == T2.current_shortcut);
-}
-
 void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 {
 	/*
@@ -53,8 +48,8 @@ void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 	 * Finally, since the voltage between the terminals of the string is known, we find the voltage corresponding
 	 * to the active group, if there's one.
 	 */
-	list <TotalsOfCellsGroup>::iterator itL;
-	list <TotalsOfCellsGroup>::iterator itLac;
+	vector <TotalsOfCellsGroup>::iterator itL;
+	vector <TotalsOfCellsGroup>::iterator itLac;
 
 	double SumVoc = 0;
 	double SumVbr = 0;
@@ -67,7 +62,7 @@ void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 	itL = lower_bound(this->groupsByCurrentShortcut.begin(), this->groupsByCurrentShortcut.end(), cG);
 
 	// From this point, in reverse direction, the breakdown groups will be evaluated
-	list <TotalsOfCellsGroup>::reverse_iterator ritL(itL);
+	vector <TotalsOfCellsGroup>::reverse_iterator ritL(itL);
 
 	/*
 	 * Looks for an active group of cells (imposing their Isc to the rest of the panel). If it exists, the itLac iterator
@@ -99,10 +94,11 @@ void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 	while (itL != this->groupsByCurrentShortcut.end())
 	{
 		SumVoc += itL->sum_voltage_open_circuit;
-		for (int k = 0; k < itL->index.size(); ++k)
+		for (int k = 0; k < itL->number_cells; ++k)
 		{
-			this->cells_array[itL->index[k]].setVoltageCell(this->cells_array[itL->index[k]].getVoltageOpenCircuit());
-			this->cells_array[itL->index[k]].setCurrentCell(_Iin);
+			SolarCell &cell = this->cells_array[group_cells[itL->first_cell + k]];
+			cell.setVoltageCell(cell.getVoltageOpenCircuit());
+			cell.setCurrentCell(_Iin);
 		}
 		advance(itL,1);
 	}
@@ -114,10 +110,11 @@ void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 	while (ritL != this->groupsByCurrentShortcut.rend())
 	{
 		SumVbr += ritL->sum_voltage_breakdown;
-		for (int k = 0; k < ritL->index.size(); ++k)
+		for (int k = 0; k < ritL->number_cells; ++k)
 		{
-			this->cells_array[ritL->index[k]].setVoltageCell(this->cells_array[ritL->index[k]].getVoltageBreakdown());
-			this->cells_array[ritL->index[k]].setCurrentCell(_Iin);
+			SolarCell &cell = this->cells_array[group_cells[ritL->first_cell + k]];
+			cell.setVoltageCell(cell.getVoltageBreakdown());
+			cell.setCurrentCell(_Iin);
 		}
 		advance(ritL,1);
 	}
@@ -130,10 +127,11 @@ void solar_string::findInitialStateWithoutDiode (double &_Iin,double &_Vin)
 	if (itLac != this->groupsByCurrentShortcut.end())
 	{
 		SumVact = _Vin - SumVoc - SumVbr;
-		for (int k = 0; k < itLac->index.size(); ++k)
+		for (int k = 0; k < itLac->number_cells; ++k)
 		{
-			this->cells_array[itLac->index[k]].setVoltageCell(SumVact/itLac->index.size());
-			this->cells_array[itLac->index[k]].setCurrentCell(_Iin);
+			SolarCell &cell = this->cells_array[group_cells[itLac->first_cell + k]];
+			cell.setVoltageCell(SumVact/itLac->number_cells);
+			cell.setCurrentCell(_Iin);
 		}
 	}
 	// Since there is no diode, there's no current through it
@@ -149,8 +147,8 @@ void solar_string::findInitialStateWithDiode (double &_Iin)
 	 * Finally, since the voltage between the terminals of the string equals the diode's voltage,
 	 * we find the voltage corresponding to the active group.
 	 */
-	list <TotalsOfCellsGroup>::iterator itL;
-	list <TotalsOfCellsGroup>::iterator itLac;
+	vector <TotalsOfCellsGroup>::iterator itL;
+	vector <TotalsOfCellsGroup>::iterator itLac;
 
 	double Iwork;
 
@@ -168,7 +166,7 @@ void solar_string::findInitialStateWithDiode (double &_Iin)
 	Iwork = itLac->current_shortcut;
 
 	// A reverse iterator will update the breakdown groups from this point
-	list <TotalsOfCellsGroup>::reverse_iterator ritL(itL);
+	vector <TotalsOfCellsGroup>::reverse_iterator ritL(itL);
 
 	// Move one position further to skip the active group
 	advance(itL,1);
@@ -178,9 +176,10 @@ void solar_string::findInitialStateWithDiode (double &_Iin)
 	 * The current will be the one of the active group
 	 */
 	while (itL != this->groupsByCurrentShortcut.end()){
-		for (int k = 0; k < itL->index.size(); ++k){
-			this->cells_array[itL->index[k]].setVoltageCell(this->cells_array[itL->index[k]].getVoltageOpenCircuit());
-			this->cells_array[itL->index[k]].setCurrentCell(Iwork);
+		for (int k = 0; k < itL->number_cells; ++k){
+			SolarCell &cell = this->cells_array[group_cells[itL->first_cell + k]];
+			cell.setVoltageCell(cell.getVoltageOpenCircuit());
+			cell.setCurrentCell(Iwork);
 		}
 		advance(itL,1);
 	}
@@ -190,9 +189,10 @@ void solar_string::findInitialStateWithDiode (double &_Iin)
 	 * The current will be the one of the active group
 	 */
 	while (ritL != this->groupsByCurrentShortcut.rend()){
-		for (int k = 0; k < ritL->index.size(); ++k){
-			this->cells_array[ritL->index[k]].setVoltageCell(this->cells_array[ritL->index[k]].getVoltageBreakdown());
-			this->cells_array[ritL->index[k]].setCurrentCell(Iwork);
+		for (int k = 0; k < ritL->number_cells; ++k){
+			SolarCell &cell = this->cells_array[group_cells[ritL->first_cell + k]];
+			cell.setVoltageCell(cell.getVoltageBreakdown());
+			cell.setCurrentCell(Iwork);
 			}
 		advance(ritL,1);
 	}
@@ -203,9 +203,10 @@ void solar_string::findInitialStateWithDiode (double &_Iin)
 	 * The current will be its Isc
 	 */
 	if (itLac != this->groupsByCurrentShortcut.end()){
-		for (int k = 0; k < itLac->index.size(); ++k){
-			this->cells_array[itLac->index[k]].setVoltageCell(itLac->sum_voltage_breakdown_in_group/itLac->index.size());
-			this->cells_array[itLac->index[k]].setCurrentCell(Iwork);
+		for (int k = 0; k < itLac->number_cells; ++k){
+			SolarCell &cell = this->cells_array[group_cells[itLac->first_cell + k]];
+			cell.setVoltageCell(itLac->sum_voltage_breakdown_in_group/itLac->number_cells);
+			cell.setCurrentCell(Iwork);
 			}
 	}
 	// The diode will be driving the difference between the Isc of the active group and the current in the panel
@@ -217,7 +218,48 @@ solar_string :: solar_string (void)
 	with_diode = true;
 	voltage_knee_diode = VOLTAGE_KNEE_DIODE_REF;
 	string_size = 0;
+	cells_array = NULL;
 }
+
+solar_string :: solar_string (const solar_string &other)
+{
+	cells_array = NULL;
+	*this = other;
+}
+
+solar_string& solar_string :: operator= (const solar_string &other)
+{
+	if (this == &other){
+		return (*this);
+	}
+
+	SolarCell *new_cells = NULL;
+	if (other.cells_array != NULL){
+		new_cells = new SolarCell[other.string_size];
+		for (int k = 0; k < other.string_size; k++){
+			new_cells[k] = other.cells_array[k];
+		}
+	}
+	delete [] cells_array;
+	cells_array = new_cells;
+
+	diode_bypass = other.diode_bypass;
+	groupsByCurrentShortcut = other.groupsByCurrentShortcut;
+	group_cells = other.group_cells;
+	string_size = other.string_size;
+	equivalent_cells_index = other.equivalent_cells_index;
+	equivalent_cells_weight = other.equivalent_cells_weight;
+	equivalent_cells_class = other.equivalent_cells_class;
+	voltage_knee_diode = other.voltage_knee_diode;
+	current_diode = other.current_diode;
+	with_diode = other.with_diode;
+	sum_voltage_open_circuit = other.sum_voltage_open_circuit;
+	sum_voltage_breakdown = other.sum_voltage_breakdown;
+	voltage_string = other.voltage_string;
+	sum_voltage_all_cells = other.sum_voltage_all_cells;
+	return (*this);
+}
+
 solar_string :: ~solar_string (void)
 {
 	delete [] cells_array;
@@ -254,8 +296,8 @@ void solar_string :: setVoltageString (double _Vstring)
 void solar_string :: setSumVoltageAllCells (void)
 {
 	double sumVcell = 0;
-	for (int k = 0; k < string_size; k++){
-			sumVcell += cells_array[k].getVoltageCell();
+	for (size_t c = 0; c < equivalent_cells_index.size(); c++){
+			sumVcell += equivalent_cells_weight[c]*cells_array[equivalent_cells_index[c]].getVoltageCell();
 	}
 	sum_voltage_all_cells = sumVcell;
 }
@@ -285,6 +327,41 @@ void solar_string :: updateStringsData (std::pair<bool,std::vector<std::pair<dou
 	updateElectricalParameters();
 	// Sorts and groups the cells by their shortcut current
 	updateGroupsByShortcutCurrent();
+	// Finds the cells that share the same working point
+	updateEquivalentCells();
+}
+
+void solar_string :: updateEquivalentCells (void)
+{
+	// Key: irradiance and temperature. Value: class of equivalent cells
+	map <pair<double,double>, int> classes;
+	map <pair<double,double>, int>::iterator itC;
+
+	equivalent_cells_index.clear();
+	equivalent_cells_weight.clear();
+	equivalent_cells_class.assign(string_size, 0);
+
+	for (int k = 0; k < string_size; k++){
+		pair<double,double> key = make_pair(cells_array[k].getIrradiance(), cells_array[k].getTemperatureCell());
+		itC = classes.find(key);
+		if (itC == classes.end()){
+			// The first cell of the class is its representative
+			itC = classes.insert(make_pair(key, (int)equivalent_cells_index.size())).first;
+			equivalent_cells_index.push_back(k);
+			equivalent_cells_weight.push_back(0);
+		}
+		equivalent_cells_class[k] = itC->second;
+		equivalent_cells_weight[itC->second] += 1;
+	}
+}
+
+void solar_string :: expandEquivalentCells (void)
+{
+	for (int k = 0; k < string_size; k++){
+		SolarCell &representative = cells_array[equivalent_cells_index[equivalent_cells_class[k]]];
+		cells_array[k].setCurrentCell(representative.getCurrentCell());
+		cells_array[k].setVoltageCell(representative.getVoltageCell());
+	}
 }
 
 void solar_string :: updateElectricalParameters (void)
@@ -309,7 +386,7 @@ void solar_string :: updateElectricalParameters (void)
 void solar_string::setSumVolageBreakdownInGroup (void){
 	// If there's no diode Vbrx equals Vbr, since all the cells in the string will eventually suffer breakdown
 	if(!this->getWithDiode()){
-		for(list<TotalsOfCellsGroup>::iterator itL = this->groupsByCurrentShortcut.begin(); itL != this->groupsByCurrentShortcut.end(); ++itL){
+		for(vector<TotalsOfCellsGroup>::iterator itL = this->groupsByCurrentShortcut.begin(); itL != this->groupsByCurrentShortcut.end(); ++itL){
 			itL->sum_voltage_breakdown_in_group = itL->sum_voltage_breakdown;
 		}
 	/*
@@ -320,10 +397,10 @@ void solar_string::setSumVolageBreakdownInGroup (void){
 				double SumVbrPrev = 0.0;
 				double SumVocPost = 0.0;
 				double SVbrx = 0.0;
-				for(list<TotalsOfCellsGroup>::iterator itLPost = this->groupsByCurrentShortcut.begin(); itLPost != this->groupsByCurrentShortcut.end(); ++itLPost){
+				for(vector<TotalsOfCellsGroup>::iterator itLPost = this->groupsByCurrentShortcut.begin(); itLPost != this->groupsByCurrentShortcut.end(); ++itLPost){
 					SumVocPost += itLPost->sum_voltage_open_circuit;
 				}
-				for(list<TotalsOfCellsGroup>::iterator itL = this->groupsByCurrentShortcut.begin(); itL != this->groupsByCurrentShortcut.end(); ++itL){
+				for(vector<TotalsOfCellsGroup>::iterator itL = this->groupsByCurrentShortcut.begin(); itL != this->groupsByCurrentShortcut.end(); ++itL){
 					SumVocPost -= itL->sum_voltage_open_circuit;
 					SVbrx = -this->getVoltageDiode()-SumVbrPrev-SumVocPost;
 					if (SVbrx < itL->sum_voltage_breakdown){
@@ -336,55 +413,64 @@ void solar_string::setSumVolageBreakdownInGroup (void){
 	}
 }
 
-bool SameCurrent(TotalsOfCellsGroup first, TotalsOfCellsGroup second)
+void solar_string :: setCellConditions (int k, double G, double Tc)
+{
+	// Same parameters as updateElectricalParameters, only for this cell
+	cells_array[k].setIrradiance(G);
+	cells_array[k].setTemperatureCell(Tc);
+	cells_array[k].setCurrentShortcut();
+	cells_array[k].setCurrentPhotogenerated();
+	cells_array[k].setVoltageOpenCircuit();
+	cells_array[k].setCurrentReverseSaturation();
+	cells_array[k].setVoltageBreakdown(VOLTAGE_BREAKDOWN_REF);
+}
+void solar_string :: updateGroups (void)
 {
-	return (first.current_shortcut == second.current_shortcut);
+	setSumVoltageOpenCircuit();
+	setSumVoltageBreakdown();
+	// The groups are found again from every cell
+	updateGroupsByShortcutCurrent();
+	updateEquivalentCells();
 }
 void solar_string :: sortGroupsByShortcutCurrent(void)
 {
-	list<TotalsOfCellsGroup>::iterator itr = groupsByCurrentShortcut.begin();
-	list<TotalsOfCellsGroup>::iterator itrx= groupsByCurrentShortcut.begin();
-	list<TotalsOfCellsGroup>::iterator itry = itr;
-	bool stop = false;
-	while (!stop) {
-		if (itr == groupsByCurrentShortcut.end()){
-			stop = true;
-		} else {
-			advance(itry,1);
-			itry = find(itry, groupsByCurrentShortcut.end(), *itr);
-			if (itry != groupsByCurrentShortcut.end()){
-				itr->index.push_back(itry->index.front());
-				itr->sum_voltage_breakdown += itry->sum_voltage_breakdown;
-				itr->sum_voltage_breakdown_in_group += itry->sum_voltage_breakdown_in_group;
-				itr->sum_voltage_open_circuit += itry->sum_voltage_open_circuit;
-				itrx = itry;
-				}else{
-					advance(itrx,1);
-					itr = itrx;
-					itry = itr;
-			}
+	// Every run of cells with the same Isc is a group. Its sums are added in the order of the cells
+	TotalsOfCellsGroup group;
+	int first = 0;
+	while (first < string_size){
+		int i = sorted_cells[first].second;
+		group.current_shortcut = sorted_cells[first].first;
+		group.first_cell = first;
+		group.sum_voltage_breakdown = cells_array[i].getVoltageBreakdown();
+		group.sum_voltage_breakdown_in_group = 0.0;
+		group.sum_voltage_open_circuit = cells_array[i].getVoltageOpenCircuit();
+		group_cells[first] = i;
+		int last = first + 1;
+		while (last < string_size && sorted_cells[last].first == group.current_shortcut){
+			i = sorted_cells[last].second;
+			group.sum_voltage_breakdown += cells_array[i].getVoltageBreakdown();
+			group.sum_voltage_open_circuit += cells_array[i].getVoltageOpenCircuit();
+			group_cells[last] = i;
+			++last;
 		}
+		group.number_cells = last - first;
+		groupsByCurrentShortcut.push_back(group);
+		first = last;
 	}
 }
 void solar_string :: updateGroupsByShortcutCurrent(void)
 {
-	TotalsOfCellsGroup Cell;
-	// Creates an entry for every PV cell in the corda array
+	// Creates an entry for every PV cell in the string
+	groupsByCurrentShortcut.clear();
+	sorted_cells.resize(string_size);
+	group_cells.resize(string_size);
 	for (int i = 0; i < string_size; i++){
-		Cell.index.push_back(cells_array[i].getIndex());
-		Cell.current_shortcut = cells_array[i].getCurrentShortcut();
-		Cell.sum_voltage_breakdown = cells_array[i].getVoltageBreakdown();
-		Cell.sum_voltage_breakdown_in_group = 0.0;
-		Cell.sum_voltage_open_circuit = cells_array[i].getVoltageOpenCircuit();
-		groupsByCurrentShortcut.push_back(Cell);
-		Cell.index.erase(Cell.index.begin());
+		sorted_cells[i] = make_pair(cells_array[i].getCurrentShortcut(), cells_array[i].getIndex());
 	}
-	// Sorts the list
-	this->groupsByCurrentShortcut.sort();
-	// Groups the cells with the same Isc under the first identical element
+	// Sorts the cells by Isc, and by index for the same Isc
+	sort(sorted_cells.begin(), sorted_cells.end());
+	// Groups the cells with the same Isc
 	this->sortGroupsByShortcutCurrent();
-	// Delete the repeated elements, keeping the first one
-	this->groupsByCurrentShortcut.unique(SameCurrent);
 	// Calculates the SVbrx of the string
 	this->setSumVolageBreakdownInGroup();
 }
@@ -429,6 +515,77 @@ void solar_string :: findInitialState (double &Iin, double &Vin)
 			break;
 	}
 }
+double solar_string :: calcVoltageCellsForCurrent (double Icells, double &dVdI)
+{
+	sum_voltage_all_cells = 0;
+	dVdI = 0;
+	// Only the representative cell of every class of equivalent cells is solved
+	for (size_t c = 0; c < equivalent_cells_index.size(); ++c){
+		SolarCell &cell = cells_array[equivalent_cells_index[c]];
+		double f, dfdV, dfdI;
+		sum_voltage_all_cells += equivalent_cells_weight[c]*cell.calcVoltageForCurrent(Icells);
+		// Implicit derivative of the cell voltage: dV/dI = -(dfc/dI)/(dfc/dV)
+		cell.calcFunctionCAndDerivatives(f, dfdV, dfdI);
+		dVdI -= equivalent_cells_weight[c]*dfdI/dfdV;
+	}
+	return(sum_voltage_all_cells);
+}
+double solar_string :: calcVoltageForTotalCurrent (double Iin, double &Icells, double &dVdI)
+{
+	double dVcdI, Id, g, dgdI, Inext;
+
+	// Without bypass diode the current through the cells is the current through the terminals
+	if (!this->getWithDiode()){
+		Icells = Iin;
+		this->calcVoltageCellsForCurrent(Icells, dVdI);
+		diode_bypass.setCurrentDiode(0.0);
+		return(sum_voltage_all_cells);
+	}
+
+	/*
+	 * The solution is bracketed. The current through the diode can not be lower than its (tiny) reverse saturation
+	 * current, so the current through the cells is not higher than Iin. Below the lowest Isc of the string every cell has a positive voltage,
+	 * so the diode is not conducting and the current through the cells must be higher.
+	 */
+	double upper = Iin + 0.01;
+	double lower = groupsByCurrentShortcut.front().current_shortcut;
+	if (lower > Iin) lower = Iin;
+	lower -= 0.01;
+	if (!(Icells > lower && Icells < upper)) Icells = Iin;
+
+	for (int k = 0; k < CELL_MAX_ITERATIONS_REF; ++k){
+		this->calcVoltageCellsForCurrent(Icells, dVcdI);
+		Id = diode_bypass.calcFunctionD(-sum_voltage_all_cells);
+		g = Icells + Id - Iin;
+		dgdI = 1 - diode_bypass.calcFuntionDiodeDerivativeRespectVoltage(-sum_voltage_all_cells)*dVcdI;
+		if (fabs(g) <= CELL_FUNCTION_TOLERANCE_REF) break;
+		// A current through the diode too high to be evaluated is taken as an upper limit
+		if (g < 0){
+			lower = Icells;
+		}else{
+			upper = Icells;
+		}
+		/*
+		 * When the current through the diode is too high the function grows exponentially and the Newton-Raphson
+		 * steps are very short. Then the logarithm of the currents ln((Icells+Id)/Iin) is used instead, which is almost linear.
+		 */
+		if (g > 0 && Iin > 0){
+			Inext = Icells - log((g+Iin)/Iin)*(g+Iin)/dgdI;
+		}else{
+			Inext = Icells - g/dgdI;
+		}
+		// Bisection when the Newton step leaves the bracket
+		if (!(Inext > lower && Inext < upper)){
+			Inext = 0.5*(lower+upper);
+		}
+		if (Inext == Icells) break;
+		Icells = Inext;
+	}
+
+	diode_bypass.setCurrentDiode(Id);
+	dVdI = dVcdI/dgdI;
+	return(sum_voltage_all_cells);
+}
 double  solar_string :: minimumInArray(double *Fa)
 {
 	double mini = fabs(Fa[0]);
@@ -27,6 +27,7 @@
 #include "pv_diode.h"
 #include <vector>
 #include <list>
+#include <map>
 
 namespace stringarma{
 
@@ -35,10 +36,12 @@ namespace stringarma{
  */
 struct TotalsOfCellsGroup {
 		/**
-		 * Vector with the physical position index of every cell in the group.
-		 * The size of this vector is equal to the number of cells included in this group.
+		 * Position in solar_string::group_cells of the first cell of this group.
+		 * The cells of a group are consecutive in that vector.
 		 */
-		std::vector<int> index;
+		int first_cell;
+		/// Number of cells included in this group.
+		int number_cells;
 		/// Shortcut current of every cell in this group.
 		double current_shortcut;
 		/// Sum of all breakdown voltages of the PV cells in this group.
@@ -84,16 +87,43 @@ public:
 	 */
 	BypassDiode diode_bypass;
 	/**
-	 * List that contains all the info about the different groups of cells in the string that share the same shortcut current Isc.
-	 * Every element in the list is a TableStr struct with the info of the group of cells.
+	 * Vector that contains all the info about the different groups of cells in the string that share the same shortcut current Isc,
+	 * sorted by increasing Isc.
+	 * Every element in the vector is a TotalsOfCellsGroup struct with the info of the group of cells.
 	 *
 	 * @see TotalsOfCellsGroup structure.
 	 */
-	std::list<TotalsOfCellsGroup> groupsByCurrentShortcut;
+	std::vector<TotalsOfCellsGroup> groupsByCurrentShortcut;
+	/**
+	 * Index in cells_array of the cells of every group, group after group (compressed storage: every group keeps the
+	 * position of its first cell and its number of cells).
+	 */
+	std::vector<int> group_cells;
+	/**
+	 * Shortcut current and index of every cell, sorted to find the groups. Kept to reuse its memory.
+	 */
+	std::vector<std::pair<double,int>> sorted_cells;
 	/**
 	 * Number of cells contained in the string.
 	 */
 	int string_size;
+	/**
+	 * Index in cells_array of the representative cell of every class of equivalent cells.
+	 *
+	 * Cells with the same irradiance and temperature have the same parameters, and therefore the same working point.
+	 * The iterative methods only calculate the representative cell (the first cell of the class in cells_array)
+	 * and count it as many times as cells in the class.
+	 * @see expandEquivalentCells()
+	 */
+	std::vector<int> equivalent_cells_index;
+	/**
+	 * Number of cells of every class of equivalent cells.
+	 */
+	std::vector<int> equivalent_cells_weight;
+	/**
+	 * Class of equivalent cells of every cell in cells_array.
+	 */
+	std::vector<int> equivalent_cells_class;
 
 	friend class SolarSolver;
 
@@ -135,6 +165,18 @@ public:
 	 * Uses all the reference values for the attributes.
 	 */
 	solar_string (void); //constructor 1
+	/**
+	 * Copy constructor of the class solar_string.
+	 * The array of cells is copied, so the new string can be solved independently of the original one.
+	 * @param The solar_string object to copy.
+	 */
+	solar_string (const solar_string&); //constructor 2
+	/**
+	 * Assignment operator of the class solar_string. The array of cells is copied.
+	 * @param The solar_string object to copy.
+	 * @returns A reference to this object.
+	 */
+	solar_string& operator= (const solar_string&);
 	/**
 	 *  Destructor of the class solar_string.
 	 */
@@ -192,6 +234,7 @@ public:
 	 * Updates the value of the sum of the voltage between the terminals of every cell in the string (Svcell) with its current value.
 	 *
 	 * It does the sum again. In case any value of any cell has changed.
+	 * Only the representative cell of every class of equivalent cells is read, multiplied by the number of cells of its class.
 	 */
 	void setSumVoltageAllCells (void);
 	/**
@@ -231,6 +274,53 @@ public:
 	 * @param Vin Total potential difference between terminals of the string [V].
 	 */
 	void findInitialState (double&, double&);
+	/**
+	 * Solves every cell of the string for a given current through the cells.
+	 *
+	 * Every cell is an independent scalar problem once the current is fixed, so they are solved one by one
+	 * (see SolarCell::calcVoltageForCurrent). Only the representative cell of every class of equivalent cells is solved.
+	 * The representative cells and the sum of the voltages are left updated.
+	 *
+	 * @param Icells Current through the cells of the string [A].
+	 * @param dVdI Returns the derivative of the sum of the voltage of the cells respect the current [V/A].
+	 * @returns A double type with the sum of the voltage of the cells of the string [V].
+	 */
+	double calcVoltageCellsForCurrent (double, double&);
+	/**
+	 * Solves the string (cells and bypass diode) for a given current through its terminals.
+	 *
+	 * The current through the cells is found so that it plus the current through the bypass diode equals the current
+	 * through the terminals. It is a scalar problem (the sum of both currents increases with the current through the cells),
+	 * solved by the Newton-Raphson method safeguarded by bisection. Every evaluation solves the cells with calcVoltageCellsForCurrent.
+	 *
+	 * @param Iin Current through the terminals of the string [A].
+	 * @param Icells Current through the cells of the string [A]. On input it is the initial estimate, on output the solution.
+	 * @param dVdI Returns the derivative of the voltage of the string respect the current through its terminals [V/A].
+	 * @returns A double type with the sum of the voltage of the cells of the string [V].
+	 */
+	double calcVoltageForTotalCurrent (double, double&, double&);
+	/**
+	 * Copies the current and voltage of the representative cell of every class of equivalent cells to the rest of cells of the class.
+	 *
+	 * The iterative methods only update the representative cells, so this method must be called before reading the state of every cell.
+	 */
+	void expandEquivalentCells (void);
+	/**
+	 * Changes the irradiance and temperature of a cell and updates its electrical parameters.
+	 *
+	 * The groups of cells and the classes of equivalent cells of the string are not updated, so that several cells can be
+	 * changed at once. updateGroups must be called after the last change.
+	 *
+	 * @param k Position of the cell in the string.
+	 * @param G New irradiance of the cell.
+	 * @param Tc New temperature of the cell.
+	 */
+	void setCellConditions (int, double, double);
+	/**
+	 * Updates the sums of the string, the groups of cells by shortcut current and the classes of equivalent cells
+	 * after the irradiance or temperature of some cells has changed (see setCellConditions).
+	 */
+	void updateGroups (void);
 
 
 private:
@@ -241,17 +331,24 @@ private:
 	 */
 	void updateElectricalParameters (void);
 	/**
-	 * Fill the CellsGr list with the different groups of cells under the same working conditions.
+	 * Fill the groupsByCurrentShortcut vector with the different groups of cells under the same working conditions.
 	 *
+	 * The cells are sorted by shortcut current (and by index for the same current), so it takes O(n log n) time and,
+	 * once the vectors have grown, it does not allocate memory.
 	 * It also calculates the corresponding electrical parameters of each group.
 	 */
 	void updateGroupsByShortcutCurrent (void);
 	/**
-	 * Once the CellsGr has been filled with all the cells in the string, and it has been sorted, this method groups them under the same working conditions.
+	 * Once sorted_cells has been filled with all the cells in the string, and it has been sorted, this method groups
+	 * the runs of cells with the same shortcut current.
 	 *
-	 * This method is used inside genLlist().
+	 * This method is used inside updateGroupsByShortcutCurrent().
 	 */
 	void sortGroupsByShortcutCurrent (void);
+	/**
+	 * Fills the classes of equivalent cells: the cells with the same irradiance and temperature.
+	 */
+	void updateEquivalentCells (void);
 	/**
 	 * Looks for the minimum of an array of double type pointers.
 	 * @param Fa Array of double pointers.
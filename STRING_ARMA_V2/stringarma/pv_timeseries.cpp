@@ -0,0 +1,570 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <list>
+#include <string>
+#include <cmath>
+#include <thread>
+#include <exception>
+#include <cstdint>
+#include <cstring>
+#include "pv_timeseries.h"
+
+using namespace std;
+
+namespace stringarma{
+
+FrameFileSource :: FrameFileSource(string _filepath, int _number_cells)
+{
+	filepath = _filepath;
+	number_cells = _number_cells;
+	number_line = 0;
+	file.open(filepath);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Unable to open the file of frames " + filepath + ".");
+	}
+}
+
+bool FrameFileSource :: readFrame(Frame &frame)
+{
+	string line;
+	while (getline(file, line))
+	{
+		++number_line;
+		if (!line.empty() && line[line.size()-1] == '\r')
+		{
+			line.erase(line.size()-1);
+		}
+		if (line.find_first_not_of(" \t") == string::npos)
+		{
+			continue;
+		}
+
+		frame.irradiance.resize(number_cells);
+		frame.temperature.resize(number_cells);
+
+		// The time is followed by the irradiance and the temperature of every cell
+		const char *p = line.c_str();
+		char *end;
+		int numb_values = 2*number_cells + 1;
+		for (int k = 0; k < numb_values; ++k)
+		{
+			double value = strtod(p, &end);
+			if (end == p)
+			{
+				throw std::runtime_error("Wrong value in line " + to_string(number_line) + " of the file of frames " + filepath + ".");
+			}
+			if (k == 0){
+				frame.time = value;
+			}
+			else if (k % 2 == 1){
+				frame.irradiance[(k-1)/2] = value;
+			}
+			else{
+				frame.temperature[(k-1)/2] = value;
+			}
+
+			while (*end == ' ' || *end == '\t')
+			{
+				++end;
+			}
+			if (k < numb_values-1)
+			{
+				if (*end != ';')
+				{
+					throw std::runtime_error("Line " + to_string(number_line) + " of the file of frames " + filepath
+							+ " does not have " + to_string(number_cells) + " cells.");
+				}
+				++end;
+			}
+			p = end;
+		}
+		// A final separator is accepted
+		if (*p == ';')
+		{
+			++p;
+		}
+		while (*p == ' ' || *p == '\t')
+		{
+			++p;
+		}
+		if (*p != '\0')
+		{
+			throw std::runtime_error("Line " + to_string(number_line) + " of the file of frames " + filepath
+					+ " has more than " + to_string(number_cells) + " cells.");
+		}
+		return(true);
+	}
+	return(false);
+}
+
+FrameBinarySource :: FrameBinarySource(string _filepath, int _number_cells)
+{
+	filepath = _filepath;
+	number_cells = _number_cells;
+	number_frames = 0;
+	frames_read = 0;
+	file.open(filepath, ios::in | ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Unable to open the file of frames " + filepath + ".");
+	}
+	char magic[8];
+	uint64_t numb_cells = 0;
+	file.read(magic, 8);
+	file.read((char*)&numb_cells, sizeof(numb_cells));
+	file.read((char*)&number_frames, sizeof(number_frames));
+	if (!file || memcmp(magic, "STRFR001", 8) != 0)
+	{
+		throw std::runtime_error("The file of frames " + filepath + " is not a binary file of frames.");
+	}
+	if (numb_cells != (uint64_t)number_cells)
+	{
+		throw std::runtime_error("The frames of the file " + filepath + " do not have " + to_string(number_cells) + " cells.");
+	}
+}
+
+bool FrameBinarySource :: readFrame(Frame &frame)
+{
+	if (frames_read >= number_frames)
+	{
+		return(false);
+	}
+	frame.irradiance.resize(number_cells);
+	frame.temperature.resize(number_cells);
+	file.read((char*)&frame.time, sizeof(double));
+	file.read((char*)frame.irradiance.data(), number_cells*sizeof(double));
+	file.read((char*)frame.temperature.data(), number_cells*sizeof(double));
+	if (!file)
+	{
+		throw std::runtime_error("The file of frames " + filepath + " ends at frame " + to_string(frames_read) + ".");
+	}
+	++frames_read;
+	return(true);
+}
+
+uint64_t FrameBinarySource :: getNumberFrames(void)
+{
+	return(number_frames);
+}
+
+uint64_t FrameBinarySource :: writeFrames(FrameSource &source, string output_path)
+{
+	ofstream file(output_path, ios::out | ios::binary | ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Unable to open the output file " + output_path + ".");
+	}
+	// The number of frames is written once all of them are known
+	Frame frame;
+	uint64_t numb_cells = 0;
+	uint64_t numb_frames = 0;
+	file.write("STRFR001", 8);
+	file.write((const char*)&numb_cells, sizeof(numb_cells));
+	file.write((const char*)&numb_frames, sizeof(numb_frames));
+	while (source.readFrame(frame))
+	{
+		if (numb_frames == 0)
+		{
+			numb_cells = frame.irradiance.size();
+		}
+		if (frame.irradiance.size() != numb_cells || frame.temperature.size() != numb_cells)
+		{
+			throw std::runtime_error("The frame no. " + to_string(numb_frames) + " does not have " + to_string(numb_cells) + " cells.");
+		}
+		file.write((const char*)&frame.time, sizeof(double));
+		file.write((const char*)frame.irradiance.data(), numb_cells*sizeof(double));
+		file.write((const char*)frame.temperature.data(), numb_cells*sizeof(double));
+		++numb_frames;
+	}
+	file.seekp(8);
+	file.write((const char*)&numb_cells, sizeof(numb_cells));
+	file.write((const char*)&numb_frames, sizeof(numb_frames));
+	if (!file)
+	{
+		throw std::runtime_error("Unable to write the output file " + output_path + ".");
+	}
+	return(numb_frames);
+}
+
+FrameVectorSource :: FrameVectorSource(const vector<Frame> &_frames) : frames(_frames)
+{
+	next_frame = 0;
+}
+
+bool FrameVectorSource :: readFrame(Frame &frame)
+{
+	if (next_frame >= (int)frames.size())
+	{
+		return(false);
+	}
+	frame = frames[next_frame];
+	++next_frame;
+	return(true);
+}
+
+TimeSeriesSimulator :: TimeSeriesSimulator(SolarPanel &_panel) : panel(_panel)
+{
+	quantities = TIMESERIES_MAXIMUM_POWER_POINT;
+	number_threads = NUMBER_THREADS_REF;
+	solve_method = NESTED_NEWTON_METHOD;
+	continuation = TANGENT_CONTINUATION;
+	setColumnNames();
+}
+
+void TimeSeriesSimulator :: setQuantities(int _quantities)
+{
+	try
+	{
+		if (getNumberFrames() > 0)
+		{
+			throw std::runtime_error("The quantities can not change once there are results.");
+		}
+		quantities = _quantities;
+		setColumnNames();
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the quantities of the time series." << endl;
+	}
+}
+
+void TimeSeriesSimulator :: setNumberThreads(int _number_threads)
+{
+	try
+	{
+		if (_number_threads < 1)
+		{
+			throw std::runtime_error("The number of threads must be at least 1.");
+		}
+		number_threads = _number_threads;
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the number of threads." << endl;
+	}
+}
+
+void TimeSeriesSimulator :: setSolveMethod(SolveMethodType _solve_method)
+{
+	solve_method = _solve_method;
+}
+
+void TimeSeriesSimulator :: setContinuation(ContinuationType _continuation)
+{
+	continuation = _continuation;
+}
+
+void TimeSeriesSimulator :: setCharacteristicRange(double start_v, double end_v, int numb_points)
+{
+	try
+	{
+		if (getNumberFrames() > 0)
+		{
+			throw std::runtime_error("The characteristic can not change once there are results.");
+		}
+		if (numb_points < 1)
+		{
+			throw std::runtime_error("The characteristic needs at least one point.");
+		}
+		characteristic_voltages.resize(numb_points);
+		for (int k = 0; k < numb_points; ++k)
+		{
+			characteristic_voltages[k] = numb_points > 1 ? start_v + (end_v - start_v)*k/(numb_points - 1) : start_v;
+		}
+		setColumnNames();
+	}
+	catch(...)
+	{
+		std::cout << "Error when modifying the characteristic of the time series." << endl;
+	}
+}
+
+void TimeSeriesSimulator :: setColumnNames(void)
+{
+	column_names.clear();
+	column_names.push_back("time");
+	column_names.push_back("converged");
+	if (quantities & TIMESERIES_MAXIMUM_POWER_POINT)
+	{
+		column_names.push_back("voltage_mpp");
+		column_names.push_back("current_mpp");
+		column_names.push_back("power_mpp");
+	}
+	if (quantities & TIMESERIES_SHORT_CIRCUIT_OPEN_CIRCUIT)
+	{
+		column_names.push_back("current_short_circuit");
+		column_names.push_back("voltage_open_circuit");
+	}
+	if (quantities & TIMESERIES_IV_CHARACTERISTIC)
+	{
+		for (unsigned int k = 0; k < characteristic_voltages.size(); ++k)
+		{
+			ostringstream name;
+			name << "current(" << characteristic_voltages[k] << ")";
+			column_names.push_back(name.str());
+		}
+	}
+	columns.assign(column_names.size(), vector<double>());
+}
+
+void TimeSeriesSimulator :: run(FrameSource &source)
+{
+	int number_strings = panel.getPanelSize();
+	int number_cells = 0;
+	for (int k = 0; k < number_strings; ++k)
+	{
+		number_cells += panel.getStringSize(k);
+	}
+
+	// The topology is built once for every thread. The conditions of the cells are updated frame by frame
+	list <SolarSolver> solvers;
+	vector <SolarSolver*> thread_solvers;
+	vector <vector<double>> irradiances(number_threads, vector<double>(number_cells, NAN));
+	vector <vector<double>> temperatures(number_threads, vector<double>(number_cells, NAN));
+	for (int t = 0; t < number_threads; ++t)
+	{
+		solvers.emplace_back(panel);
+		solvers.back().setSolveMethod(solve_method);
+		solvers.back().setContinuation(continuation);
+		thread_solvers.push_back(&solvers.back());
+	}
+
+	int batch_size = TIMESERIES_BATCH_FRAMES_REF*number_threads;
+	vector <Frame> batch(batch_size);
+	bool end_source = false;
+	while (!end_source)
+	{
+		int numb_frames = 0;
+		while (numb_frames < batch_size && source.readFrame(batch[numb_frames]))
+		{
+			if ((int)batch[numb_frames].irradiance.size() != number_cells ||
+					(int)batch[numb_frames].temperature.size() != number_cells)
+			{
+				throw std::runtime_error("The frame at time " + to_string(batch[numb_frames].time)
+						+ " does not have the conditions of every cell of the panel.");
+			}
+			++numb_frames;
+		}
+		end_source = numb_frames < batch_size;
+		if (numb_frames == 0)
+		{
+			break;
+		}
+
+		int first_row = getNumberFrames();
+		for (unsigned int c = 0; c < columns.size(); ++c)
+		{
+			columns[c].resize(first_row + numb_frames);
+		}
+
+		try
+		{
+			solveBatch(batch, numb_frames, thread_solvers, irradiances, temperatures, first_row);
+		}
+		catch(...)
+		{
+			// The rows of the batch are not written: only the frames of the previous batches are kept
+			for (unsigned int c = 0; c < columns.size(); ++c)
+			{
+				columns[c].resize(first_row);
+			}
+			throw;
+		}
+	}
+}
+
+void TimeSeriesSimulator :: solveBatch(const vector<Frame> &batch, int numb_frames, vector<SolarSolver*> &thread_solvers,
+		vector<vector<double>> &irradiances, vector<vector<double>> &temperatures, int first_row)
+{
+	int numb_parts = number_threads < numb_frames ? number_threads : numb_frames;
+	if (numb_parts <= 1)
+	{
+		for (int f = 0; f < numb_frames; ++f)
+		{
+			solveFrame(*thread_solvers[0], batch[f], irradiances[0], temperatures[0], first_row + f);
+		}
+		return;
+	}
+
+	vector <std::thread> threads;
+	vector <std::exception_ptr> errors(numb_parts);
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		// Consecutive frames are solved by the same thread, so the previous frame is a good estimate
+		int first = (long)numb_frames*t/numb_parts;
+		int last = (long)numb_frames*(t+1)/numb_parts;
+
+		threads.push_back(std::thread([this, &batch, &thread_solvers, &irradiances, &temperatures, &errors, first_row, t, first, last]()
+		{
+			try
+			{
+				for (int f = first; f < last; ++f)
+				{
+					solveFrame(*thread_solvers[t], batch[f], irradiances[t], temperatures[t], first_row + f);
+				}
+			}
+			catch(...)
+			{
+				errors[t] = std::current_exception();
+			}
+		}));
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		threads[t].join();
+	}
+	for (int t = 0; t < numb_parts; ++t)
+	{
+		if (errors[t]){
+			std::rethrow_exception(errors[t]);
+		}
+	}
+}
+
+void TimeSeriesSimulator :: solveFrame(SolarSolver &solver, const Frame &frame, vector<double> &irradiance,
+		vector<double> &temperature, int row)
+{
+	// Only the cells whose conditions change are updated in the solver
+	vector <CellConditions> changes;
+	int number_strings = panel.getPanelSize();
+	int pos = 0;
+	for (int s = 0; s < number_strings; ++s)
+	{
+		int string_size = panel.getStringSize(s);
+		for (int c = 0; c < string_size; ++c, ++pos)
+		{
+			if (frame.irradiance[pos] != irradiance[pos] || frame.temperature[pos] != temperature[pos])
+			{
+				CellConditions cell = {s, c, frame.irradiance[pos], frame.temperature[pos]};
+				changes.push_back(cell);
+				irradiance[pos] = frame.irradiance[pos];
+				temperature[pos] = frame.temperature[pos];
+			}
+		}
+	}
+	if (!changes.empty())
+	{
+		solver.setCellConditions(changes);
+	}
+
+	// Every quantity that is not solved is NAN
+	bool converged = true;
+	int col = 0;
+	columns[col++][row] = frame.time;
+	int converged_col = col++;
+	if (quantities & TIMESERIES_SHORT_CIRCUIT_OPEN_CIRCUIT)
+	{
+		// Solved before the maximum power point, which leaves the solver far from the previous frame
+		int first_col = col + ((quantities & TIMESERIES_MAXIMUM_POWER_POINT) ? 3 : 0);
+		columns[first_col][row] = solver.findShortCircuitCurrent();
+		columns[first_col+1][row] = solver.findOpenCircuitVoltage();
+		converged = converged && std::isfinite(columns[first_col][row]) && std::isfinite(columns[first_col+1][row]);
+	}
+	if (quantities & TIMESERIES_IV_CHARACTERISTIC)
+	{
+		int first_col = col + ((quantities & TIMESERIES_MAXIMUM_POWER_POINT) ? 3 : 0)
+				+ ((quantities & TIMESERIES_SHORT_CIRCUIT_OPEN_CIRCUIT) ? 2 : 0);
+		arma::mat curve = solver.calcIVcharacteristic(characteristic_voltages);
+		for (unsigned int k = 0; k < characteristic_voltages.size(); ++k)
+		{
+			columns[first_col+k][row] = curve(k,1);
+			converged = converged && std::isfinite(curve(k,1));
+		}
+	}
+	if (quantities & TIMESERIES_MAXIMUM_POWER_POINT)
+	{
+		MaximumPowerPoint mpp = solver.findMaximumPowerPoint();
+		columns[col][row] = mpp.solved ? mpp.voltage : NAN;
+		columns[col+1][row] = mpp.current;
+		columns[col+2][row] = mpp.power;
+		converged = converged && mpp.solved;
+	}
+	columns[converged_col][row] = converged ? 1.0 : 0.0;
+}
+
+void TimeSeriesSimulator :: clearResults(void)
+{
+	columns.assign(column_names.size(), vector<double>());
+}
+
+int TimeSeriesSimulator :: getNumberFrames(void)
+{
+	return(columns.empty() ? 0 : columns[0].size());
+}
+
+const vector<string>& TimeSeriesSimulator :: getColumnNames(void)
+{
+	return(column_names);
+}
+
+const vector<double>& TimeSeriesSimulator :: getColumn(int k)
+{
+	return(columns.at(k));
+}
+
+void TimeSeriesSimulator :: writeColumns(string output_path)
+{
+	try
+	{
+		ofstream file(output_path, ios::out | ios::binary | ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("Unable to open the output file " + output_path + ".");
+		}
+		uint64_t numb_rows = getNumberFrames();
+		uint32_t numb_columns = column_names.size();
+		file.write("STRTS001", 8);
+		file.write((const char*)&numb_rows, sizeof(numb_rows));
+		file.write((const char*)&numb_columns, sizeof(numb_columns));
+		for (unsigned int k = 0; k < column_names.size(); ++k)
+		{
+			uint32_t length = column_names[k].size();
+			file.write((const char*)&length, sizeof(length));
+			file.write(column_names[k].data(), length);
+		}
+		for (unsigned int k = 0; k < columns.size(); ++k)
+		{
+			file.write((const char*)columns[k].data(), numb_rows*sizeof(double));
+		}
+		if (!file)
+		{
+			throw std::runtime_error("Unable to write the output file " + output_path + ".");
+		}
+	}
+	catch(std::exception &e)
+	{
+		std::cout << "Error when writing the time series: " << e.what() << endl;
+	}
+	catch(...)
+	{
+		std::cout << "Error when writing the time series." << endl;
+	}
+}
+
+}
@@ -0,0 +1,304 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include "pv_solver.h"
+
+namespace stringarma{
+
+#define TIMESERIES_BATCH_FRAMES_REF 256
+
+/**
+ * Quantities that can be calculated for every frame of a time series. They can be combined (bitwise or).
+ */
+enum TimeSeriesQuantity {
+	/// Voltage, current and power of the global maximum power point (see SolarSolver::findMaximumPowerPoint).
+	TIMESERIES_MAXIMUM_POWER_POINT = 1,
+	/// Short circuit current and open circuit voltage of the panel.
+	TIMESERIES_SHORT_CIRCUIT_OPEN_CIRCUIT = 2,
+	/// Current of the panel for every voltage of a fixed grid (see TimeSeriesSimulator::setCharacteristicRange).
+	TIMESERIES_IV_CHARACTERISTIC = 4
+};
+
+/**
+ * Operational data of the panel at an instant of time.
+ */
+struct Frame {
+	/// Instant of time of the frame, in the units of the input.
+	double time;
+	/// Irradiance of every cell, sorted by string and by position in the string.
+	std::vector<double> irradiance;
+	/// Temperature of every cell, in the same order as the irradiance.
+	std::vector<double> temperature;
+};
+
+/**
+ * Source of the frames of a time series, read one after the other.
+ */
+class FrameSource
+{
+public:
+	virtual ~FrameSource(void) {}
+	/**
+	 * Reads the next frame of the time series.
+	 * @param frame Frame struct where the frame is stored. Its vectors are reused.
+	 * @returns True if a frame was read, false at the end of the series.
+	 */
+	virtual bool readFrame(Frame &) = 0;
+};
+
+/**
+ * Frames read from a text file, one line for every frame.
+ *
+ * Every line contains the time followed by the irradiance and temperature of every cell, separated by ';':
+ * time;G;Tc;G;Tc;... The cells are sorted by string and by position in the string, as in the input file of the panel.
+ * Empty lines are skipped.
+ */
+class FrameFileSource : public FrameSource
+{
+private:
+	/// Input file.
+	std::ifstream file;
+	/// Path of the input file, for the error messages.
+	std::string filepath;
+	/// Number of cells of every frame.
+	int number_cells;
+	/// Number of the last line read.
+	int number_line;
+
+public:
+	/**
+	 * Constructor of the class FrameFileSource.
+	 * @param filepath Absolute path of the file with the frames.
+	 * @param number_cells Number of cells in the panel.
+	 */
+	FrameFileSource(std::string, int);
+	bool readFrame(Frame &);
+};
+
+/**
+ * Frames read from a binary file, without any parsing.
+ *
+ * The file (format STRFR001, in the byte order of the machine) contains a header with the number of cells and the
+ * number of frames, followed by every frame: the time, the irradiance of every cell and the temperature of every cell,
+ * as double values. It is written by writeFrames from any other source, such as a FrameFileSource.
+ */
+class FrameBinarySource : public FrameSource
+{
+private:
+	/// Input file.
+	std::ifstream file;
+	/// Path of the input file, for the error messages.
+	std::string filepath;
+	/// Number of cells of every frame.
+	int number_cells;
+	/// Number of frames in the file.
+	uint64_t number_frames;
+	/// Number of frames already read.
+	uint64_t frames_read;
+
+public:
+	/**
+	 * Constructor of the class FrameBinarySource.
+	 * @param filepath Absolute path of the binary file with the frames.
+	 * @param number_cells Number of cells in the panel. It must be the same as in the file.
+	 */
+	FrameBinarySource(std::string, int);
+	bool readFrame(Frame &);
+	/**
+	 * Gets the number of frames in the file.
+	 * @returns Number of frames.
+	 */
+	uint64_t getNumberFrames(void);
+	/**
+	 * Writes all the frames of a source to a binary file, which can be read by a FrameBinarySource.
+	 * All the frames must have the same number of cells.
+	 * @param source Source of the frames, read until its end.
+	 * @param output_path Absolute path of the binary file.
+	 * @returns Number of frames written.
+	 */
+	static uint64_t writeFrames(FrameSource &, std::string);
+};
+
+/**
+ * Frames stored in memory.
+ */
+class FrameVectorSource : public FrameSource
+{
+private:
+	/// Frames of the time series.
+	const std::vector<Frame> &frames;
+	/// Position of the next frame.
+	int next_frame;
+
+public:
+	/**
+	 * Constructor of the class FrameVectorSource. The frames are not copied, so they must exist while they are read.
+	 * @param frames Vector with the frames of the time series.
+	 */
+	FrameVectorSource(const std::vector<Frame> &);
+	bool readFrame(Frame &);
+};
+
+/**
+ * Simulates a SolarPanel over a time series of frames of irradiance and temperature.
+ *
+ * The topology of the panel (a SolarSolver object for every thread) is built once. For every frame, only the cells
+ * whose conditions change respect the previous frame of the same thread are updated (see SolarSolver::setCellConditions),
+ * and the continuation of the solver starts every frame from the last working point of the previous one.
+ * The frames are read in batches, and every thread solves consecutive frames of the batch.
+ * The results are stored by columns, one for every quantity, and can be written to a binary file (see writeColumns).
+ * A quantity that is not solved in a frame is NAN, and the column "converged" of the frame is 0.
+ */
+class TimeSeriesSimulator
+{
+protected:
+	/// Panel with the topology and the properties of the cells. Its operational data is only the starting point.
+	SolarPanel &panel;
+	/// Quantities calculated for every frame (combination of TimeSeriesQuantity values).
+	int quantities;
+	/// Number of threads used to solve the frames.
+	int number_threads;
+	/// Iterative method used by the solver of every thread.
+	SolveMethodType solve_method;
+	/// Initial estimate used by the solver of every thread.
+	ContinuationType continuation;
+	/// Voltages where the current is calculated (TIMESERIES_IV_CHARACTERISTIC).
+	std::vector<double> characteristic_voltages;
+	/// Name of every column of results.
+	std::vector<std::string> column_names;
+	/// Results, with a column for every quantity and a row for every frame.
+	std::vector<std::vector<double>> columns;
+
+public:
+	/**
+	 * Constructor of the class TimeSeriesSimulator.
+	 * By default the maximum power point is calculated, in the calling thread, with the NESTED_NEWTON_METHOD and
+	 * TANGENT_CONTINUATION.
+	 * @param panel SolarPanel object with the panel to simulate. It must exist while the simulator is in use.
+	 */
+	TimeSeriesSimulator(SolarPanel &);
+	/**
+	 * Sets the quantities calculated for every frame.
+	 * @param quantities Combination (bitwise or) of TimeSeriesQuantity values.
+	 */
+	void setQuantities(int);
+	/**
+	 * Sets the number of threads used to solve the frames. Every thread has its own SolarSolver object.
+	 * @param Integer value with the number of threads.
+	 */
+	void setNumberThreads(int);
+	/**
+	 * Sets the iterative method used to solve the frames (see SolarSolver::setSolveMethod).
+	 * @param SolveMethodType value with the method to use.
+	 */
+	void setSolveMethod(SolveMethodType);
+	/**
+	 * Sets the initial estimate used between the points and the frames (see SolarSolver::setContinuation).
+	 * @param ContinuationType value with the initial estimate to use.
+	 */
+	void setContinuation(ContinuationType);
+	/**
+	 * Sets the voltages of the I-V characteristic of every frame (TIMESERIES_IV_CHARACTERISTIC).
+	 * The same voltages are used in every frame, so every one of them is a column of results.
+	 * @param start_v First voltage value in the characteristic.
+	 * @param end_v Last voltage value in the characteristic.
+	 * @param numb_points Number of points in the characteristic.
+	 */
+	void setCharacteristicRange(double, double, int);
+	/**
+	 * Simulates every frame of the source. The results are added to the ones of previous calls.
+	 * Errors are not caught, so they reach the caller as exceptions. Then the results keep the batches solved before
+	 * the error, and none of the frames of the batch where it happened.
+	 * @param source FrameSource object with the frames to simulate.
+	 */
+	void run(FrameSource &);
+	/**
+	 * Deletes the results.
+	 */
+	void clearResults(void);
+	/**
+	 * Returns the number of frames simulated.
+	 * @returns Integer with the number of rows of results.
+	 */
+	int getNumberFrames(void);
+	/**
+	 * Returns the name of every column of results.
+	 * The columns are time and converged (1 if every quantity of the frame was solved, 0 otherwise), then voltage_mpp,
+	 * current_mpp and power_mpp (TIMESERIES_MAXIMUM_POWER_POINT), then current_short_circuit and voltage_open_circuit
+	 * (TIMESERIES_SHORT_CIRCUIT_OPEN_CIRCUIT), and then current(V) for every voltage of the characteristic
+	 * (TIMESERIES_IV_CHARACTERISTIC).
+	 * @returns A vector with the name of every column.
+	 */
+	const std::vector<std::string>& getColumnNames(void);
+	/**
+	 * Returns a column of results.
+	 * @param k Number of the column (see getColumnNames).
+	 * @returns A vector with the value of every frame.
+	 */
+	const std::vector<double>& getColumn(int);
+	/**
+	 * Writes the results to a binary file, by columns.
+	 *
+	 * The file contains the text "STRTS001", the number of rows (64 bit integer), the number of columns (32 bit integer),
+	 * the name of every column (its length as a 32 bit integer followed by its characters) and then the values of every
+	 * column, one after the other, as 64 bit floating point numbers. Integers and numbers use the byte order of the machine.
+	 * @param output_path Full path of the file where to store the results. If the file exists it will be replaced.
+	 */
+	void writeColumns(std::string);
+
+protected:
+	/**
+	 * Sets the names of the columns of results for the quantities in use.
+	 */
+	void setColumnNames(void);
+	/**
+	 * Solves a batch of frames, in parallel if more than one thread is used, and stores its results.
+	 * Every thread solves consecutive frames of the batch.
+	 * @param batch Frames of the batch.
+	 * @param numb_frames Number of frames read in the batch.
+	 * @param thread_solvers SolarSolver object of every thread.
+	 * @param irradiances Irradiance of every cell in the solver of every thread (see solveFrame).
+	 * @param temperatures Temperature of every cell in the solver of every thread (see solveFrame).
+	 * @param first_row Row of results of the first frame of the batch.
+	 */
+	void solveBatch(const std::vector<Frame> &batch, int numb_frames, std::vector<SolarSolver*> &thread_solvers,
+			std::vector<std::vector<double>> &irradiances, std::vector<std::vector<double>> &temperatures, int first_row);
+	/**
+	 * Solves a frame and stores its results.
+	 * @param solver SolarSolver object of the thread.
+	 * @param frame Frame to solve.
+	 * @param irradiance Irradiance of every cell in the solver, updated with the frame.
+	 * @param temperature Temperature of every cell in the solver, updated with the frame.
+	 * @param row Row of results of the frame.
+	 */
+	void solveFrame(SolarSolver &solver, const Frame &frame, std::vector<double> &irradiance,
+			std::vector<double> &temperature, int row);
+};
+
+}
@@ -0,0 +1,176 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that the Newton-Raphson method does not allocate memory once the workspace of the solver is sized.
+ *
+ * The global operator new is replaced by a counting version. Every working point is solved several times, stopping
+ * the method after a different number of iterations, and the number of allocations must be zero for any number of
+ * iterations.
+ *
+ * Build (from this folder):
+ *   g++ -std=c++11 -O2 -pthread -I../stringarma -I../stringarma/armadillo-9.850.1/include -DARMA_DONT_USE_WRAPPER
+ *       alloc_count.cpp ../stringarma/pv_*.cpp -llapack -lblas -o alloc_count
+ * The program returns 0 if no allocation is found.
+ */
+
+#include <cstdio>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "pv_solver.h"
+
+using namespace std;
+using namespace stringarma;
+
+static size_t allocation_count = 0;
+
+void *operator new(size_t size)
+{
+	allocation_count++;
+	void *p = malloc(size ? size : 1);
+	if (p == NULL){
+		throw bad_alloc();
+	}
+	return(p);
+}
+
+void *operator new[](size_t size)
+{
+	return(operator new(size));
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+/**
+ * Gives access to the Newton-Raphson method and to the workspace of the solver.
+ */
+class CountingSolver : public SolarSolver
+{
+public:
+	CountingSolver(SolarPanel &panel) : SolarSolver(panel) {}
+
+	/**
+	 * Solves the working point for a given voltage with a fixed number of iterations, from the estimate by groups.
+	 * Only the Newton-Raphson method is counted, not the initial estimate.
+	 * @returns The number of allocations made during the solve.
+	 */
+	size_t countAllocations(double Vp, int iterations)
+	{
+		setMaxIterations(iterations);
+		findWorkingZone(Vp);
+		std::fill(workspace.string_voltages.begin(), workspace.string_voltages.end(), 0.0);
+		double Itotal = findTotalCurrent(Vp);
+		assignStringVoltages(Vp, workspace.string_voltages);
+		for (int k=0; k<number_strings; k++)
+		{
+			string_array[k].findInitialState(Itotal, workspace.string_voltages[k]);
+		}
+
+		size_t before = allocation_count;
+		calcNewtonRaphson(string_array, Vp, workspace);
+		return(allocation_count - before);
+	}
+};
+
+/**
+ * Panel of three strings of 24 cells, with some shaded cells and a string without bypass diode.
+ */
+SolarPanel buildPanel(void)
+{
+	vector<pair<bool,vector<pair<double,double>>>> strings(3);
+	for (int i=0; i<3; i++)
+	{
+		strings[i].first = (i != 1);
+		for (int j=0; j<24; j++)
+		{
+			double G = ((i+j) % 7 == 0) ? 400.0 + 100.0*i : 1000.0;
+			double Tc = (j % 5 == 0) ? 35.0 : 25.0;
+			strings[i].second.push_back(make_pair(G, Tc));
+		}
+	}
+	return(SolarPanel(strings));
+}
+
+/**
+ * Counts the allocations of every solve with a certain configuration of the solver.
+ * @returns True if no solve allocates memory.
+ */
+bool checkConfiguration(SolarPanel &panel, const char *name, LinearSolverType linear, SolveMethodType method)
+{
+	CountingSolver solver(panel);
+	solver.setLinearSolver(linear);
+	solver.setSolveMethod(method);
+
+	// Warm-up: the first solve may size any remaining internal buffer
+	solver.countAllocations(20.0, 5);
+
+	bool ok = true;
+	const double voltages[] = {5.0, 20.0, 35.0, 45.0};
+	const int iterations[] = {1, 2, 4, 8, MAX_ITERATIONS_REF};
+	for (double Vp : voltages)
+	{
+		for (int n : iterations)
+		{
+			size_t count = solver.countAllocations(Vp, n);
+			if (count != 0){
+				printf("%s: %zu allocations at %g V with %d iterations\n", name, count, Vp, n);
+				ok = false;
+			}
+		}
+	}
+	printf("%s: %s\n", name, ok ? "no allocations" : "FAILED");
+	return(ok);
+}
+
+int main(void)
+{
+	SolarPanel panel = buildPanel();
+
+	bool ok = true;
+	ok = checkConfiguration(panel, "ARMADILLO_DENSE_SOLVER", ARMADILLO_DENSE_SOLVER, FULL_NEWTON_METHOD) && ok;
+	ok = checkConfiguration(panel, "BORDERED_BLOCK_SOLVER", BORDERED_BLOCK_SOLVER, FULL_NEWTON_METHOD) && ok;
+	ok = checkConfiguration(panel, "NESTED_NEWTON_METHOD", BORDERED_BLOCK_SOLVER, NESTED_NEWTON_METHOD) && ok;
+
+	return(ok ? 0 : 1);
+}
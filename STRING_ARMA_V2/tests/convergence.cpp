@@ -0,0 +1,119 @@
+/*
+ * Published under the General Public License GNU (VERSION 3)
+ *
+ * Copyright (c) 2017 Joan Ferran Salaet Pereira
+ * Copyright (c) 2020 Josep Garreta Betriu
+ * Copyright (c) (2017-2020) Universitat Politecnica de Catalunya (UPC)
+ *
+ * This file is part of Stringarma.
+ *
+ *   Stringarma is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   Stringarma is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with Stringarma.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Checks that a working point that does not converge in the maximum number of iterations is reported.
+ *
+ * The solver is limited to a single iteration with a tolerance that can not be reached. Every working point, from the
+ * estimate by groups or from the previous point (continuation), must then be reported as not solved, with a NAN
+ * current, instead of iterating without end. The maximum power point must be reported as not found as well.
+ * With the default settings the same points must be solved.
+ *
+ * Build (from this folder):
+ *   g++ -std=c++11 -O2 -pthread -I../stringarma -I../stringarma/armadillo-9.850.1/include -DARMA_DONT_USE_WRAPPER
+ *       convergence.cpp ../stringarma/pv_*.cpp -llapack -lblas -o convergence
+ * The program returns 0 if every check passes.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "pv_solver.h"
+
+using namespace std;
+using namespace stringarma;
+
+/**
+ * Panel of three strings of 24 cells, with some shaded cells.
+ */
+SolarPanel buildPanel(void)
+{
+	vector<pair<bool,vector<pair<double,double>>>> strings(3);
+	for (int i=0; i<3; i++)
+	{
+		strings[i].first = true;
+		for (int j=0; j<24; j++)
+		{
+			double G = ((i+j) % 7 == 0) ? 400.0 + 100.0*i : 1000.0;
+			strings[i].second.push_back(make_pair(G, 25.0));
+		}
+	}
+	return(SolarPanel(strings));
+}
+
+/**
+ * Solves some working points and a characteristic, and checks whether they are reported as solved.
+ * @returns True if every point has the expected result.
+ */
+bool checkConfiguration(SolarPanel &panel, const char *name, SolveMethodType method, ContinuationType cont, bool converge)
+{
+	SolarSolver solver(panel);
+	solver.setSolveMethod(method);
+	solver.setContinuation(cont);
+	if (!converge){
+		solver.setMaxIterations(1);
+		solver.setEpsilon(1e-300);
+	}
+
+	bool ok = true;
+	const vector<double> voltages = {5.0, 5.5, 20.0, 35.0};
+	for (double Vp : voltages)
+	{
+		PanelState state = solver.calcState(Vp);
+		if (state.solved != converge || std::isfinite(state.current) != converge){
+			printf("%s: working point at %g V solved %d, current %g\n", name, Vp, state.solved, state.current);
+			ok = false;
+		}
+	}
+	arma::mat curve = solver.calcIVcharacteristic(voltages);
+	for (arma::uword k=0; k<curve.n_rows; k++)
+	{
+		if (std::isfinite(curve(k,1)) != converge){
+			printf("%s: characteristic at %g V has a current %g\n", name, curve(k,0), curve(k,1));
+			ok = false;
+		}
+	}
+	MaximumPowerPoint mpp = solver.findMaximumPowerPoint();
+	if (mpp.solved != converge || std::isfinite(mpp.power) != converge
+			|| mpp.string_voltages.size() != (size_t)(converge ? panel.getPanelSize() : 0)){
+		printf("%s: maximum power point solved %d, power %g\n", name, mpp.solved, mpp.power);
+		ok = false;
+	}
+	printf("%s: %s\n", name, ok ? "ok" : "FAILED");
+	return(ok);
+}
+
+int main(void)
+{
+	SolarPanel panel = buildPanel();
+
+	bool ok = true;
+	ok = checkConfiguration(panel, "FULL_NEWTON_METHOD converged", FULL_NEWTON_METHOD, NO_CONTINUATION, true) && ok;
+	ok = checkConfiguration(panel, "FULL_NEWTON_METHOD", FULL_NEWTON_METHOD, NO_CONTINUATION, false) && ok;
+	ok = checkConfiguration(panel, "FULL_NEWTON_METHOD continuation", FULL_NEWTON_METHOD, PREVIOUS_SOLUTION_CONTINUATION, false) && ok;
+	ok = checkConfiguration(panel, "FULL_NEWTON_METHOD tangent", FULL_NEWTON_METHOD, TANGENT_CONTINUATION, false) && ok;
+	ok = checkConfiguration(panel, "NESTED_NEWTON_METHOD converged", NESTED_NEWTON_METHOD, NO_CONTINUATION, true) && ok;
+	ok = checkConfiguration(panel, "NESTED_NEWTON_METHOD", NESTED_NEWTON_METHOD, NO_CONTINUATION, false) && ok;
+
+	return(ok ? 0 : 1);
+}